@@ -0,0 +1,324 @@
+#ifndef LEMON_ARCHIVE_HPP
+#define LEMON_ARCHIVE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "lemon/entries.hpp"
+#include "lemon/hadoop.hpp"
+#include "lemon/mapped_file.hpp"
+
+namespace lemon {
+
+//! The location of a single MMTF record in a directory of sequence files.
+struct ArchiveRecord {
+    std::string pdbid;    //!< The PDB ID of the record
+    size_t file;          //!< Index of the sequence file in `Archive::files()`
+    uint64_t offset;      //!< Offset of the compressed MMTF data in the file
+    uint64_t length;      //!< Length of the compressed MMTF data
+    uint64_t record_size; //!< Size of the whole record, including its header
+};
+
+//! The `Archive` class provides random access to a directory of sequence files
+//!
+//! Hadoop sequence files can only be read from front to back. This class
+//! scans every sequence file once and stores the location of each MMTF record
+//! in an index file named `_LEMON_INDEX` in the same directory. Later
+//! instances read this index instead of scanning the sequence files again.
+//! If the directory cannot be written to, the index is kept in memory only.
+//! The index is rebuilt if the sequence files change in number, size,
+//! modification time or content of their first and last bytes.
+class Archive {
+  public:
+    //! The name of the index file stored with the sequence files
+    static constexpr const char* INDEX_NAME = "_LEMON_INDEX";
+
+    //! Open the directory of sequence files at `p` and load its index.
+    //!
+    //! \param [in] p A path to the Hadoop sequence file directory.
+    //! \throws std::runtime_error if the directory cannot be read.
+    explicit Archive(const std::string& p) : path_(p) {
+        files_ = read_hadoop_dir(p);
+        std::sort(files_.begin(), files_.end());
+
+        if (!read_index_()) {
+            build_index_();
+            write_index_();
+        }
+
+        for (size_t i = 0; i < records_.size(); ++i) {
+            lookup_.emplace(records_[i].pdbid, i);
+        }
+
+        mapped_.resize(files_.size());
+        mapped_once_.reset(new std::once_flag[files_.size()]);
+    }
+
+    //! The sequence files in the archive.
+    const std::vector<std::string>& files() const { return files_; }
+
+    //! All records in the archive, in the order they appear on disk.
+    const std::vector<ArchiveRecord>& records() const { return records_; }
+
+    //! The number of records in the archive.
+    size_t size() const { return records_.size(); }
+
+    //! Returns true if the archive contains a record for `pdbid`.
+    bool contains(const std::string& pdbid) const {
+        return lookup_.count(pdbid) != 0;
+    }
+
+    //! Select the records for the given entries.
+    //!
+    //! \param [in] entries Which entries to use. All records if blank.
+    //! \param [in] skip_entries Which entries to skip. Not used if blank.
+    //! \return The selected records, in the order they appear on disk.
+    std::vector<const ArchiveRecord*>
+    select(const Entries& entries = Entries(),
+           const Entries& skip_entries = Entries()) const {
+        std::vector<const ArchiveRecord*> selection;
+
+        if (entries.empty()) {
+            selection.reserve(records_.size());
+            for (const auto& record : records_) {
+                selection.push_back(&record);
+            }
+        } else {
+            selection.reserve(entries.size());
+            for (const auto& entry : entries) {
+                auto range = lookup_.equal_range(entry);
+                for (auto it = range.first; it != range.second; ++it) {
+                    selection.push_back(&records_[it->second]);
+                }
+            }
+
+            std::sort(selection.begin(), selection.end());
+        }
+
+        if (!skip_entries.empty()) {
+            selection.erase(
+                std::remove_if(selection.begin(), selection.end(),
+                    [&skip_entries](const ArchiveRecord* record) {
+                        return skip_entries.count(record->pdbid) != 0;
+                    }),
+                selection.end());
+        }
+
+        return selection;
+    }
+
+    //! The compressed MMTF data of a record.
+    //!
+    //! The sequence file containing the record is mapped into memory the
+    //! first time it is accessed. The returned view is valid for the lifetime
+    //! of the `Archive`.
+    chemfiles::span<const char> data(const ArchiveRecord& record) const {
+        const auto& file = map_(record.file);
+
+        if (record.offset + record.length > file.size()) {
+            throw std::runtime_error("Index is out of date for " +
+                                     files_[record.file]);
+        }
+
+        return {file.data() + record.offset,
+                static_cast<size_t>(record.length)};
+    }
+
+    //! The compressed MMTF data for a given PDB ID.
+    //!
+    //! \throws std::out_of_range if the entry is not in the archive.
+    chemfiles::span<const char> data(const std::string& pdbid) const {
+        return data(find_(pdbid));
+    }
+
+    //! Read a record into a `chemfiles::Frame`.
+    chemfiles::Frame read(const ArchiveRecord& record) const {
+        auto value = data(record);
+        auto traj = chemfiles::Trajectory::memory_reader(
+            value.data(), value.size(), "MMTF/GZ");
+        return traj.read();
+    }
+
+    //! Read the entry with the given PDB ID into a `chemfiles::Frame`.
+    //!
+    //! \param [in] pdbid The PDB ID of interest, for example *1AAQ*.
+    //! \return The parsed entry.
+    //! \throws std::out_of_range if the entry is not in the archive.
+    chemfiles::Frame get(const std::string& pdbid) const {
+        return read(find_(pdbid));
+    }
+
+  private:
+    std::string path_;
+    std::vector<std::string> files_;
+    std::vector<ArchiveRecord> records_;
+    std::unordered_multimap<std::string, size_t> lookup_;
+
+    mutable std::vector<MappedFile> mapped_;
+    std::unique_ptr<std::once_flag[]> mapped_once_;
+
+    const ArchiveRecord& find_(const std::string& pdbid) const {
+        auto it = lookup_.find(pdbid);
+        if (it == lookup_.end()) {
+            throw std::out_of_range("Entry " + pdbid + " is not in " + path_);
+        }
+        return records_[it->second];
+    }
+
+    const MappedFile& map_(size_t file) const {
+        std::call_once(mapped_once_[file], [this, file] {
+            mapped_[file] = MappedFile(files_[file]);
+        });
+        return mapped_[file];
+    }
+
+    std::string index_path_() const { return path_ + "/" + INDEX_NAME; }
+
+    static std::string base_name_(const std::string& file) {
+        return file.substr(file.find_last_of("/\\") + 1);
+    }
+
+    // The size, modification time and a hash of the first and last bytes of
+    // a sequence file, which change when the file is rewritten
+    static std::string signature_(const std::string& file) {
+        struct stat info;
+        if (stat(file.c_str(), &info) != 0) {
+            return "";
+        }
+
+        auto size = static_cast<uint64_t>(info.st_size);
+        constexpr uint64_t SAMPLE = 4096;
+        std::vector<char> sample(static_cast<size_t>(std::min(size, SAMPLE)));
+
+        uint64_t hash = 14695981039346656037ULL; // FNV-1a
+        std::ifstream input(file, std::istream::binary);
+        for (auto start : {uint64_t(0), size - sample.size()}) {
+            input.seekg(static_cast<std::streamoff>(start));
+            input.read(sample.data(),
+                       static_cast<std::streamsize>(sample.size()));
+            for (auto c : sample) {
+                hash = (hash ^ static_cast<unsigned char>(c)) *
+                       1099511628211ULL;
+            }
+        }
+
+        return std::to_string(size) + "\t" +
+               std::to_string(static_cast<int64_t>(info.st_mtime)) + "\t" +
+               std::to_string(hash);
+    }
+
+    void build_index_() {
+        records_.clear();
+        for (size_t i = 0; i < files_.size(); ++i) {
+            MappedHadoop sequence(files_[i]);
+            while (sequence.has_next()) {
+                auto start = sequence.position();
+                auto pair = sequence.next();
+                auto offset =
+                    static_cast<uint64_t>(pair.second.data() - sequence.data());
+
+                records_.push_back({pair.first, i, offset, pair.second.size(),
+                                    sequence.position() - start});
+            }
+        }
+    }
+
+    // Returns false if the index is missing or out of date
+    bool read_index_() {
+        std::ifstream input(index_path_());
+        if (!input) {
+            return false;
+        }
+
+        std::string line;
+        std::string tag;
+        size_t version = 0;
+        size_t nfiles = 0;
+        std::getline(input, line);
+        std::istringstream header(line);
+        header >> tag >> version >> nfiles;
+        if (tag != "LEMON_INDEX" || version != 2 || nfiles != files_.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < nfiles; ++i) {
+            std::getline(input, line);
+            auto signature = signature_(files_[i]);
+            if (signature.empty() ||
+                line != base_name_(files_[i]) + "\t" + signature) {
+                return false;
+            }
+        }
+
+        ArchiveRecord record;
+        while (input >> record.pdbid >> record.file >> record.offset >>
+               record.length >> record.record_size) {
+            if (record.file >= nfiles) {
+                records_.clear();
+                return false;
+            }
+            records_.push_back(record);
+        }
+
+        return input.eof();
+    }
+
+    // Failure to write the index is not an error, it is rebuilt next time
+    void write_index_() const {
+        auto stamp =
+            std::chrono::steady_clock::now().time_since_epoch().count();
+        auto temp_path = index_path_() + "." + std::to_string(stamp);
+
+        {
+            std::ofstream output(temp_path);
+            if (!output) {
+                return;
+            }
+
+            output << "LEMON_INDEX\t2\t" << files_.size() << "\n";
+            for (const auto& file : files_) {
+                output << base_name_(file) << "\t" << signature_(file) << "\n";
+            }
+
+            for (const auto& record : records_) {
+                output << record.pdbid << "\t" << record.file << "\t"
+                       << record.offset << "\t" << record.length << "\t"
+                       << record.record_size << "\n";
+            }
+
+            if (!output) {
+                output.close();
+                std::remove(temp_path.c_str());
+                return;
+            }
+        }
+
+        // Atomic on POSIX, so concurrent builders cannot corrupt the index
+        if (std::rename(temp_path.c_str(), index_path_().c_str()) == 0) {
+            return;
+        }
+
+        // Windows does not replace existing files when renaming
+        std::remove(index_path_().c_str());
+        if (std::rename(temp_path.c_str(), index_path_().c_str()) != 0) {
+            std::remove(temp_path.c_str());
+        }
+    }
+};
+
+} // namespace lemon
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef LEMON_ATOM_GRID_HPP
+#define LEMON_ATOM_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "lemon/frame_view.hpp"
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/Frame.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! A uniform grid of atoms to find the atoms near another atom quickly.
+//!
+//! The atoms are sorted into cells of the unit cell of the frame, so that the
+//! atoms closer than a distance `d` to an atom are in the cells within `d` of
+//! its own cell. Periodic boundary conditions are taken into account in the
+//! same way as `chemfiles::Frame::distance`, so checking the candidates
+//! returned by `neighbors` with the distance function of the frame gives the
+//! same pairs as checking all atoms. Frames without a unit cell use the
+//! bounding box of the atoms instead. Building the grid takes a time linear in
+//! the number of atoms, and a query takes a time proportional to the number of
+//! atoms in the visited cells.
+class AtomGrid {
+  public:
+    //! Create an empty grid
+    AtomGrid() = default;
+
+    //! Index all atoms of `frame` in cells of about `cell_size`.
+    AtomGrid(const chemfiles::Frame& frame, double cell_size) {
+        std::vector<size_t> atoms(frame.size());
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            atoms[i] = i;
+        }
+        init_(frame, atoms, cell_size);
+    }
+
+    //! Index the atoms of `frame` listed in `atoms` in cells of about
+    //! `cell_size`.
+    AtomGrid(const chemfiles::Frame& frame, const std::vector<size_t>& atoms,
+             double cell_size) {
+        init_(frame, atoms, cell_size);
+    }
+
+    //! Index the atoms of a `FrameView` listed in `atoms` in cells of about
+    //! `cell_size`.
+    AtomGrid(const FrameView& frame, const std::vector<size_t>& atoms,
+             double cell_size) {
+        const double* m = frame.cell();
+        set_cell_(m);
+        build_(atoms, cell_size, [&frame](size_t atom, double* x) {
+            const auto* p = frame.position(atom);
+            x[0] = static_cast<double>(p[0]);
+            x[1] = static_cast<double>(p[1]);
+            x[2] = static_cast<double>(p[2]);
+        });
+    }
+
+    //! The number of atoms in the grid
+    size_t size() const { return atoms_.size(); }
+
+    //! Call `function` with every atom of the grid which may be closer than
+    //! `distance` to the point `x`.
+    //!
+    //! The atoms are candidates: some of them may be further away than
+    //! `distance`, but no closer atom is left out. Stops early if `function`
+    //! returns true.
+    //! \return True if `function` returned true.
+    template <typename Function>
+    bool neighbors(const double* x, double distance, Function&& function) const {
+        if (atoms_.empty()) {
+            return false;
+        }
+
+        long lo[3], hi[3];
+        double s[3];
+        fractional_(x, s);
+        for (size_t k = 0; k < 3; ++k) {
+            auto n = static_cast<long>(dims_[k]);
+            auto c = static_cast<long>(
+                std::floor(s[k] * static_cast<double>(dims_[k])));
+            auto r = static_cast<long>(std::ceil(distance * scale_[k] + 1e-6));
+            if (periodic_ && 2 * r + 1 >= n) {
+                lo[k] = 0;
+                hi[k] = n - 1;
+            } else if (periodic_) {
+                lo[k] = c - r;
+                hi[k] = c + r;
+            } else {
+                lo[k] = std::max<long>(c - r, 0);
+                hi[k] = std::min<long>(c + r, n - 1);
+            }
+        }
+
+        for (auto i = lo[0]; i <= hi[0]; ++i) {
+            for (auto j = lo[1]; j <= hi[1]; ++j) {
+                for (auto k = lo[2]; k <= hi[2]; ++k) {
+                    auto cell = index_(wrap_(i, 0), wrap_(j, 1), wrap_(k, 2));
+                    for (auto a = starts_[cell]; a < starts_[cell + 1]; ++a) {
+                        if (function(atoms_[a])) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+
+    //! Check if an atom of the grid is closer than `distance` to the atom
+    //! `atom` of `frame`, the frame used to build the grid.
+    bool any_within(const chemfiles::Frame& frame, size_t atom,
+                    double distance) const {
+        const auto& position = frame.positions()[atom];
+        double x[3] = {position[0], position[1], position[2]};
+        return neighbors(x, distance, [&](size_t other) {
+            return frame.distance(other, atom) < distance;
+        });
+    }
+
+    //! Check if an atom of the grid is closer than `distance` to the atom
+    //! `atom` of the `FrameView` used to build the grid.
+    bool any_within(const FrameView& frame, size_t atom,
+                    double distance) const {
+        const auto* position = frame.position(atom);
+        double x[3] = {static_cast<double>(position[0]),
+                       static_cast<double>(position[1]),
+                       static_cast<double>(position[2])};
+        return neighbors(x, distance, [&](size_t other) {
+            return frame.distance(other, atom) < distance;
+        });
+    }
+
+  private:
+    void init_(const chemfiles::Frame& frame, const std::vector<size_t>& atoms,
+               double cell_size) {
+        const auto& cell = frame.cell();
+        if (cell.shape() != chemfiles::UnitCell::INFINITE) {
+            auto matrix = cell.matrix();
+            double m[9];
+            for (size_t i = 0; i < 3; ++i) {
+                for (size_t j = 0; j < 3; ++j) {
+                    m[3 * i + j] = matrix[i][j];
+                }
+            }
+            set_cell_(m);
+        } else {
+            set_cell_(nullptr);
+        }
+
+        const auto& positions = frame.positions();
+        build_(atoms, cell_size, [&positions](size_t atom, double* x) {
+            x[0] = positions[atom][0];
+            x[1] = positions[atom][1];
+            x[2] = positions[atom][2];
+        });
+    }
+
+    // The columns of `m` are the vectors of the unit cell
+    void set_cell_(const double* m) {
+        periodic_ = m != nullptr;
+        if (!periodic_) {
+            return;
+        }
+
+        std::copy(m, m + 9, cell_);
+        auto det = m[0] * (m[4] * m[8] - m[5] * m[7]) -
+                   m[1] * (m[3] * m[8] - m[5] * m[6]) +
+                   m[2] * (m[3] * m[7] - m[4] * m[6]);
+        if (det == 0.0) {
+            periodic_ = false;
+            return;
+        }
+
+        inverse_[0] = (m[4] * m[8] - m[5] * m[7]) / det;
+        inverse_[1] = (m[2] * m[7] - m[1] * m[8]) / det;
+        inverse_[2] = (m[1] * m[5] - m[2] * m[4]) / det;
+        inverse_[3] = (m[5] * m[6] - m[3] * m[8]) / det;
+        inverse_[4] = (m[0] * m[8] - m[2] * m[6]) / det;
+        inverse_[5] = (m[2] * m[3] - m[0] * m[5]) / det;
+        inverse_[6] = (m[3] * m[7] - m[4] * m[6]) / det;
+        inverse_[7] = (m[1] * m[6] - m[0] * m[7]) / det;
+        inverse_[8] = (m[0] * m[4] - m[1] * m[3]) / det;
+    }
+
+    template <typename Position>
+    void build_(const std::vector<size_t>& atoms, double cell_size,
+                Position position) {
+        if (atoms.empty()) {
+            return;
+        }
+
+        std::vector<double> coordinates(3 * atoms.size());
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            position(atoms[i], &coordinates[3 * i]);
+        }
+
+        // The width of the box along each axis, the distance between the
+        // two faces of the box normal to this axis
+        double widths[3];
+        if (periodic_) {
+            const auto* m = cell_;
+            auto volume = std::fabs(
+                m[0] * (m[4] * m[8] - m[5] * m[7]) -
+                m[1] * (m[3] * m[8] - m[5] * m[6]) +
+                m[2] * (m[3] * m[7] - m[4] * m[6]));
+            for (size_t k = 0; k < 3; ++k) {
+                // Cross product of the two other cell vectors (columns)
+                auto u = (k + 1) % 3, v = (k + 2) % 3;
+                double c[3] = {m[3 + u] * m[6 + v] - m[6 + u] * m[3 + v],
+                               m[6 + u] * m[v] - m[u] * m[6 + v],
+                               m[u] * m[3 + v] - m[3 + u] * m[v]};
+                widths[k] = volume / std::sqrt(c[0] * c[0] + c[1] * c[1] +
+                                               c[2] * c[2]);
+            }
+        } else {
+            for (size_t k = 0; k < 3; ++k) {
+                origin_[k] = std::numeric_limits<double>::max();
+                double top = std::numeric_limits<double>::lowest();
+                for (size_t i = 0; i < atoms.size(); ++i) {
+                    origin_[k] = std::min(origin_[k], coordinates[3 * i + k]);
+                    top = std::max(top, coordinates[3 * i + k]);
+                }
+                widths[k] = std::max(top - origin_[k], 1e-3);
+            }
+        }
+
+        // Limit the number of cells to a few per atom, for sparse frames
+        cell_size = std::max(cell_size, 1e-3);
+        const auto max_cells = 4 * atoms.size() + 64;
+        while (true) {
+            size_t total = 1;
+            for (size_t k = 0; k < 3; ++k) {
+                auto n = std::floor(widths[k] / cell_size);
+                dims_[k] = static_cast<size_t>(
+                    std::min(std::max(n, 1.0), static_cast<double>(max_cells)));
+                total *= dims_[k];
+            }
+
+            if (total <= max_cells) {
+                break;
+            }
+            cell_size *= 1.5;
+        }
+
+        for (size_t k = 0; k < 3; ++k) {
+            scale_[k] = static_cast<double>(dims_[k]) / widths[k];
+            if (!periodic_) {
+                width_[k] = widths[k];
+            }
+        }
+
+        // Sort the atoms by cell
+        std::vector<size_t> cells(atoms.size());
+        starts_.assign(dims_[0] * dims_[1] * dims_[2] + 1, 0);
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            double s[3];
+            fractional_(&coordinates[3 * i], s);
+
+            size_t c[3];
+            for (size_t k = 0; k < 3; ++k) {
+                auto index = std::floor(s[k] * static_cast<double>(dims_[k]));
+                index = std::min(std::max(index, 0.0),
+                                 static_cast<double>(dims_[k] - 1));
+                c[k] = static_cast<size_t>(index);
+            }
+
+            cells[i] = index_(c[0], c[1], c[2]);
+            ++starts_[cells[i] + 1];
+        }
+
+        for (size_t cell = 1; cell < starts_.size(); ++cell) {
+            starts_[cell] += starts_[cell - 1];
+        }
+
+        atoms_.resize(atoms.size());
+        auto next = starts_;
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            atoms_[next[cells[i]]++] = atoms[i];
+        }
+    }
+
+    // The position of `x` in the box, in [0, 1) along each axis for the atoms
+    // of the grid
+    void fractional_(const double* x, double* s) const {
+        if (periodic_) {
+            for (size_t k = 0; k < 3; ++k) {
+                s[k] = inverse_[3 * k] * x[0] + inverse_[3 * k + 1] * x[1] +
+                       inverse_[3 * k + 2] * x[2];
+                s[k] -= std::floor(s[k]);
+                if (s[k] >= 1.0) {
+                    s[k] = 0.0;
+                }
+            }
+        } else {
+            for (size_t k = 0; k < 3; ++k) {
+                s[k] = (x[k] - origin_[k]) / width_[k];
+            }
+        }
+    }
+
+    size_t wrap_(long i, size_t axis) const {
+        auto n = static_cast<long>(dims_[axis]);
+        return static_cast<size_t>(((i % n) + n) % n);
+    }
+
+    size_t index_(size_t i, size_t j, size_t k) const {
+        return (i * dims_[1] + j) * dims_[2] + k;
+    }
+
+    bool periodic_ = false;
+    double cell_[9] = {0};
+    double inverse_[9] = {0};
+    double origin_[3] = {0, 0, 0};
+    double width_[3] = {1, 1, 1};
+    size_t dims_[3] = {1, 1, 1};
+    double scale_[3] = {0, 0, 0};
+    std::vector<size_t> starts_;
+    std::vector<size_t> atoms_;
+};
+
+//! Spheres bounding the residues of a frame, to discard distant residues.
+//!
+//! Each sphere is centered on the first atom of the residue and contains all
+//! atoms of the residue. Two residues whose spheres are further apart than a
+//! distance `d` cannot have atoms closer than `d`, which is checked with a
+//! single call to the distance function of the frame. Triclinic unit cells
+//! are not handled, as the periodic distance of chemfiles is not always the
+//! shortest one in such cells: all residues may then be close.
+class ResidueSpheres {
+  public:
+    //! Create no spheres
+    ResidueSpheres() = default;
+
+    //! Compute the spheres bounding the residues of `frame`.
+    explicit ResidueSpheres(const chemfiles::Frame& frame)
+        : exact_(frame.cell().shape() != chemfiles::UnitCell::TRICLINIC) {
+        const auto& residues = frame.topology().residues();
+        anchors_.reserve(residues.size());
+        radii_.reserve(residues.size());
+        for (const auto& residue : residues) {
+            add_(frame, residue.begin(), residue.end());
+        }
+    }
+
+    //! Compute the spheres bounding the residues of a `FrameView`.
+    explicit ResidueSpheres(const FrameView& frame) : exact_(true) {
+        const auto* m = frame.cell();
+        if (m != nullptr) {
+            exact_ = m[1] == 0 && m[2] == 0 && m[3] == 0 && m[5] == 0 &&
+                     m[6] == 0 && m[7] == 0;
+        }
+
+        anchors_.reserve(frame.residue_count());
+        radii_.reserve(frame.residue_count());
+        for (size_t i = 0; i < frame.residue_count(); ++i) {
+            auto residue = frame.residue(i);
+            add_(frame, residue.begin(), residue.end());
+        }
+    }
+
+    //! The number of residues
+    size_t size() const { return radii_.size(); }
+
+    //! The radius of the sphere of `residue`, negative if it has no atoms
+    double radius(size_t residue) const { return radii_[residue]; }
+
+    //! Check if the residues `i` and `j` of `frame`, the frame used to compute
+    //! the spheres, may have atoms closer than `distance`.
+    //!
+    //! \return False if no atom of `i` is closer than `distance` to an atom of
+    //!  `j`. True if some may be.
+    template <typename Frame>
+    bool may_interact(const Frame& frame, size_t i, size_t j,
+                      double distance) const {
+        if (radii_[i] < 0 || radii_[j] < 0) {
+            return false;
+        }
+
+        if (!exact_) {
+            return true;
+        }
+
+        // Leave some room for rounding errors
+        auto reach = radii_[i] + radii_[j] + distance + 1e-6;
+        return frame.distance(anchors_[i], anchors_[j]) < reach;
+    }
+
+  private:
+    template <typename Frame, typename Iterator>
+    void add_(const Frame& frame, Iterator begin, Iterator end) {
+        if (begin == end) {
+            anchors_.push_back(0);
+            radii_.push_back(-1.0);
+            return;
+        }
+
+        auto anchor = static_cast<size_t>(*begin);
+        double radius = 0.0;
+        for (auto it = begin; it != end; ++it) {
+            radius = std::max(radius,
+                              frame.distance(anchor, static_cast<size_t>(*it)));
+        }
+
+        anchors_.push_back(anchor);
+        radii_.push_back(radius);
+    }
+
+    bool exact_ = true;
+    std::vector<size_t> anchors_;
+    std::vector<double> radii_;
+};
+
+} // namespace lemon
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef LEMON_BITS_HPP
+#define LEMON_BITS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lemon {
+
+//! The number of bits set in `x`
+inline size_t popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+//! The index of the lowest bit set in `x`, which must not be zero
+inline size_t trailing_zeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctzll(x));
+#else
+    return popcount((x & (~x + 1)) - 1);
+#endif
+}
+
+} // namespace lemon
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef LEMON_BOUNDED_QUEUE_HPP
+#define LEMON_BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/external/optional.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! A first in, first out queue with a maximum size shared between threads.
+//!
+//! Producers block in `push` while the queue is full and consumers block in
+//! `pop` while it is empty. Once `close` is called, `push` fails and `pop`
+//! returns the remaining items followed by `chemfiles::nullopt`. This makes
+//! the queue suitable to connect the stages of a pipeline while bounding the
+//! memory used by items in flight.
+template <class T> class bounded_queue {
+  public:
+    //! Create a queue which holds at most `capacity` items.
+    explicit bounded_queue(size_t capacity)
+        : capacity_(capacity == 0 ? 1 : capacity) {}
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    //! Add an item to the back of the queue, waiting for space if needed.
+    //!
+    //! \return False if the queue was closed and the item was not added.
+    bool push(T item) {
+        {
+            lock l(m_);
+            not_full_.wait(l, [this] {
+                return closed_ || data_.size() < capacity_;
+            });
+
+            if (closed_) {
+                return false;
+            }
+
+            data_.push_back(std::move(item));
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    //! Remove an item from the front of the queue, waiting for one if needed.
+    //!
+    //! \return The item, or `chemfiles::nullopt` if the queue is closed and
+    //!  empty.
+    chemfiles::optional<T> pop() {
+        chemfiles::optional<T> result;
+        {
+            lock l(m_);
+            not_empty_.wait(l, [this] { return closed_ || !data_.empty(); });
+
+            if (data_.empty()) {
+                return chemfiles::nullopt;
+            }
+
+            result = std::move(data_.front());
+            data_.pop_front();
+        }
+        not_full_.notify_one();
+        return result;
+    }
+
+    //! Stop accepting new items and wake all waiting threads.
+    void close() {
+        {
+            lock l(m_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+  private:
+    using lock = std::unique_lock<std::mutex>;
+
+    std::mutex m_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> data_;
+    size_t capacity_;
+    bool closed_ = false;
+};
+
+} // namespace lemon
+
+#endif
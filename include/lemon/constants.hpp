@@ -28,13 +28,11 @@ namespace lemon {
 //! - *MLY*: N-dimethyl-lysine
 //! - *HYP*: 4-hydroxyproline
 //! - *MSE*: selenomethionine
-const ResidueNameSet common_peptides{
-    {"CSD"}, {"PCA"}, {"DLE"}, {"KCX"}, {"CAS"}, {"CSO"}, {"PTR"},
-    {"CME"}, {"SAH"}, {"TPO"}, {"SEP"}, {"MLY"}, {"HYP"}, {"MSE"},
-    {"CYS"}, {"TRP"}, {"MET"}, {"HIS"}, {"TYR"}, {"GLN"}, {"PHE"},
-    {"ASN"}, {"PRO"}, {"ARG"}, {"THR"}, {"ASP"}, {"ILE"}, {"LYS"},
-    {"SER"}, {"GLU"}, {"VAL"}, {"GLY"}, {"ALA"}, {"LEU"},
-};
+constexpr ResidueNameSet common_peptides(
+    "CSD", "PCA", "DLE", "KCX", "CAS", "CSO", "PTR", "CME", "SAH", "TPO",
+    "SEP", "MLY", "HYP", "MSE", "CYS", "TRP", "MET", "HIS", "TYR", "GLN",
+    "PHE", "ASN", "PRO", "ARG", "THR", "ASP", "ILE", "LYS", "SER", "GLU",
+    "VAL", "GLY", "ALA", "LEU");
 
 //! Common co-factors in the PDB
 //!
@@ -43,30 +41,23 @@ const ResidueNameSet common_peptides{
 //! groups (*FAD*, *FMN*), nicotinamide groups (*NAD*, *NAP*), heme groups (
 //! *HEM*, *HEA*, *HEB*, *HEC*), nucleotides (*ADP*, *ATP*, *GDP*, *GTP*),
 //! citric acid (*CIT*, *FLC*), and S-adenosylmethionine (*SAM*).
-const ResidueNameSet common_cofactors{
-    {"FAD"}, {"FMN"}, {"NAD"}, {"NAP"}, {"CLA"}, {"HEM"}, {"HEA"}, {"HEB"},
-    {"HEC"}, {"ADP"}, {"ATP"}, {"GDP"}, {"GTP"}, {"UNL"}, {"CIT"}, {"FLC"},
-    {"BE7"}, {"MHA"}, {"DHD"}, {"B3P"}, {"BTB"}, {"NHE"}, {"GOL"}, {"DTP"},
-    {"SAM"}, {"SIA"}, {"ICT"}, {"EPE"}, {"MES"},
-};
+constexpr ResidueNameSet common_cofactors(
+    "FAD", "FMN", "NAD", "NAP", "CLA", "HEM", "HEA", "HEB", "HEC", "ADP",
+    "ATP", "GDP", "GTP", "UNL", "CIT", "FLC", "BE7", "MHA", "DHD", "B3P",
+    "BTB", "NHE", "GOL", "DTP", "SAM", "SIA", "ICT", "EPE", "MES");
 
 //! Common fatty-acids in the PDB
 //!
 //! Several protein crystal structures contain fatty acids used to help induce
 //! crystallization.  This list contains fatty acids and other 'linear' small
 //! molecules.
-const ResidueNameSet common_fatty_acids{
-    {"PG6"}, {"PE7"}, {"PG5"}, {"PEU"}, {"PGE"}, {"PIG"}, {"PE8"}, {"PE4"},
-    {"P33"}, {"C8E"}, {"OTE"}, {"XPE"}, {"N8E"}, {"DR6"}, {"PEG"}, {"2PE"},
-    {"P6G"}, {"1PE"}, {"SPM"}, {"SPK"}, {"SPD"}, {"1PG"}, {"PG4"}, {"MYR"},
-    {"OLA"}, {"OLB"}, {"OLC"}, {"PLM"}, {"PEE"}, {"LHG"}, {"MC3"}, {"PAM"},
-};
+constexpr ResidueNameSet common_fatty_acids(
+    "PG6", "PE7", "PG5", "PEU", "PGE", "PIG", "PE8", "PE4", "P33", "C8E",
+    "OTE", "XPE", "N8E", "DR6", "PEG", "2PE", "P6G", "1PE", "SPM", "SPK",
+    "SPD", "1PG", "PG4", "MYR", "OLA", "OLB", "OLC", "PLM", "PEE", "LHG",
+    "MC3", "PAM");
 
-const ResidueNameSet proline_res{
-    {"PRO"},
-    {"HYP"},
-    {"PCA"},
-};
+constexpr ResidueNameSet proline_res("PRO", "HYP", "PCA");
 
 //! Linkage types for small-molecules in the PDB
 //!
@@ -26,19 +26,15 @@ namespace count {
 //! then the count of the residue is increased.
 //! \param [in] frame The frame containing residues of interest
 //! \param [in,out] resn_count A map of residue names to their respective count
+//! \throws std::range_error if a residue name is not made of digits and
+//!  capital letters, as in the Chemical Component Dictionary. Such entries are
+//!  skipped by `run_parallel`.
 inline ResidueNameCount& residues(const chemfiles::Frame& frame,
                                   ResidueNameCount& resn_count) {
     auto& residues = frame.topology().residues();
 
     for (auto& residue : residues) {
-        auto resn_count_iterator = resn_count.find(residue.name());
-
-        if (resn_count_iterator == resn_count.end()) {
-            resn_count[residue.name()] = 1;
-            continue;
-        }
-
-        ++resn_count_iterator->second;
+        ++resn_count[residue.name()];
     }
 
     return resn_count;
@@ -52,21 +48,16 @@ inline ResidueNameCount& residues(const chemfiles::Frame& frame,
 //! \param [in] frame The frame containing residues of interest
 //! \param [in] resids Residue ids to consider
 //! \param [in,out] resn_count A map of residue names to their respective count
+//! \throws std::range_error if a selected residue name is not made of digits
+//!  and capital letters.
 template <typename Container>
 inline ResidueNameCount& residues(const chemfiles::Frame& frame,
                                   const Container& resids,
                                   ResidueNameCount& resn_count) {
     auto& residues = frame.topology().residues();
 
-    for (auto& resid : resids) {
-        auto resn_count_iterator = resn_count.find(residues[resid].name());
-
-        if (resn_count_iterator == resn_count.end()) {
-            resn_count[residues[resid].name()] = 1;
-            continue;
-        }
-
-        ++resn_count_iterator->second;
+    for (auto resid : resids) {
+        ++resn_count[residues[resid].name()];
     }
 
     return resn_count;
@@ -7,6 +7,7 @@
 #include <sstream>
 #include <string>
 #include <cctype>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <algorithm>
@@ -0,0 +1,157 @@
+#ifndef LEMON_FRAME_INDEX_HPP
+#define LEMON_FRAME_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lemon/atom_grid.hpp"
+#include "lemon/frame_tables.hpp"
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/Frame.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! The default cell size of the grid of atoms of a `FrameIndex`
+constexpr auto DEFAULT_GRID_SPACING = 6.0;
+
+//! Values computed once for a frame and shared by the functions using it.
+//!
+//! A workflow often selects, prunes and separates the residues of an entry
+//! with several functions, which all look at the same residue properties and
+//! atom positions. The overloads of these functions taking a `FrameIndex`
+//! compute such values the first time they are needed and keep them for the
+//! following calls: the properties of the residues and atoms in a
+//! `FrameTables`, the bonds of each atom, the spheres bounding the residues
+//! and a grid of all atoms. Create one `FrameIndex` per entry in the worker,
+//! after the frame was read and before using it. The frame must outlive the
+//! index and must not be modified while the index is used. A `FrameIndex` must
+//! not be used by several threads at once.
+class FrameIndex : public ResidueKinds {
+  public:
+    //! Create an index of `frame`. Nothing is computed yet.
+    explicit FrameIndex(const chemfiles::Frame& frame) : frame_(frame) {}
+
+    FrameIndex(const FrameIndex&) = delete;
+    FrameIndex& operator=(const FrameIndex&) = delete;
+
+    //! The indexed frame
+    const chemfiles::Frame& frame() const { return frame_; }
+
+    //! The number of residues of the frame
+    size_t residue_count() const {
+        return frame_.topology().residues().size();
+    }
+
+    //! The properties of the residues and atoms of the frame
+    const FrameTables& tables() const {
+        if (!tables_) {
+            tables_.reset(new FrameTables(frame_));
+        }
+        return *tables_;
+    }
+
+    //! The name of `residue`
+    const std::string& name(size_t residue) const {
+        const auto& t = tables();
+        return t.string(t.names()[residue]);
+    }
+
+    //! The composition type of `residue`, empty if unknown
+    const std::string& composition_type(size_t residue) const {
+        const auto& t = tables();
+        return t.string(t.composition_types()[residue]);
+    }
+
+    //! The kind of `residue`
+    Kind kind(size_t residue) const { return tables().kinds()[residue]; }
+
+    //! The number of atoms of `residue` which are not hydrogens
+    size_t heavy_atoms(size_t residue) const {
+        return tables().heavy_atoms()[residue];
+    }
+
+    //! The chain ID of `residue`, empty if unknown
+    const std::string& chain(size_t residue) const {
+        const auto& t = tables();
+        return t.string(t.chain_ids()[residue]);
+    }
+
+    //! The assembly of `residue`, empty if unknown
+    const std::string& assembly(size_t residue) const {
+        const auto& t = tables();
+        return t.string(t.assemblies()[residue]);
+    }
+
+    //! The residue containing `atom`, `residue_count()` if none
+    size_t residue_of(size_t atom) const {
+        return tables().residue_of()[atom];
+    }
+
+    //! The bonds of the frame by atom: the indexes in
+    //! `frame().topology().bonds()` of the bonds of an atom
+    const std::unordered_multimap<size_t, size_t>& bond_map() const {
+        if (!bond_map_) {
+            const auto& bonds = frame_.topology().bonds();
+            bond_map_.reset(new std::unordered_multimap<size_t, size_t>());
+            for (size_t i = 0; i < bonds.size(); ++i) {
+                bond_map_->insert({bonds[i][0], i});
+                bond_map_->insert({bonds[i][1], i});
+            }
+        }
+        return *bond_map_;
+    }
+
+    //! The spheres bounding the residues of the frame
+    const ResidueSpheres& spheres() const {
+        if (!spheres_) {
+            spheres_.reset(new ResidueSpheres(frame_));
+        }
+        return *spheres_;
+    }
+
+    //! A grid of all atoms of the frame.
+    //!
+    //! The grid is built by the first call, with cells of `cell_size`, and is
+    //! reused by the following calls whatever their `cell_size`: any grid
+    //! finds the atoms within any distance, only the number of atoms checked
+    //! changes.
+    const AtomGrid& grid(double cell_size = DEFAULT_GRID_SPACING) const {
+        if (!grid_) {
+            grid_.reset(new AtomGrid(frame_, cell_size));
+        }
+        return *grid_;
+    }
+
+    //! Call `function` with every atom of the frame which may be closer than
+    //! `distance` to `atom`, using `grid`. Stops early if `function` returns
+    //! true.
+    //! \return True if `function` returned true.
+    template <typename Function>
+    bool neighbors(size_t atom, double distance, Function&& function) const {
+        const auto& position = frame_.positions()[atom];
+        double x[3] = {position[0], position[1], position[2]};
+        return grid(distance).neighbors(x, distance,
+                                        std::forward<Function>(function));
+    }
+
+  private:
+    const chemfiles::Frame& frame_;
+
+    mutable std::unique_ptr<FrameTables> tables_;
+    mutable std::unique_ptr<std::unordered_multimap<size_t, size_t>> bond_map_;
+    mutable std::unique_ptr<ResidueSpheres> spheres_;
+    mutable std::unique_ptr<AtomGrid> grid_;
+};
+
+} // namespace lemon
+
+#endif
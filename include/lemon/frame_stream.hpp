@@ -0,0 +1,121 @@
+#ifndef LEMON_FRAME_STREAM_HPP
+#define LEMON_FRAME_STREAM_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "lemon/bounded_queue.hpp"
+#include "lemon/entries.hpp"
+#include "lemon/parallel.hpp"
+
+namespace lemon {
+
+//! Read the entries of the PDB one by one, parsed ahead by other threads.
+//!
+//! Unlike `run_parallel`, where **Lemon** calls the workflow for each entry,
+//! a `FrameStream` is read by the caller with `next`. Background threads read
+//! and parse the records as the stages of `run_pipeline` do, and keep at most
+//! `queue_size` parsed entries waiting for the caller. Use this class to walk
+//! the PDB from code which cannot be called by **Lemon**, such as an
+//! interactive Python session.
+class FrameStream {
+  public:
+    //! Start reading the entries stored in `p`.
+    //!
+    //! \param [in] p A path to the Hadoop sequence file directory, or to a
+    //!  directory of pack files created by `lm_pack`.
+    //! \param [in] threads The number of threads parsing the entries.
+    //! \param [in] entries Which entries to use. Not used if blank.
+    //! \param [in] skip_entries Which entries to skip. Not used if blank.
+    //! \param [in] queue_size Maximum number of parsed entries waiting to be
+    //!  read. Zero uses twice the number of threads.
+    explicit FrameStream(const std::string& p, size_t threads = 1,
+                         const Entries& entries = Entries(),
+                         const Entries& skip_entries = Entries(),
+                         size_t queue_size = 0)
+        : frames_(queue_size != 0 ? queue_size
+                                  : 2 * std::max<size_t>(threads, 1)) {
+        reader_ = std::thread([this, p, threads, entries, skip_entries] {
+            read_(p, threads, entries, skip_entries);
+        });
+    }
+
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+
+    //! Stop the background threads, even if not all entries were read.
+    ~FrameStream() {
+        close();
+        reader_.join();
+    }
+
+    //! Take the next entry, waiting for it to be parsed if needed.
+    //!
+    //! The entries are returned in the order they are parsed, which differs
+    //! between runs.
+    //! \return The PDB ID and the parsed entry, or `chemfiles::nullopt` once
+    //!  all entries were read or the stream was closed.
+    //! \throws std::runtime_error if the entries could not be read, for
+    //!  example if `p` is not a valid directory.
+    chemfiles::optional<pipeline_frame> next() {
+        auto item = frames_.pop();
+        if (!item && error_) {
+            auto error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+        return item;
+    }
+
+    //! Stop reading entries. Entries which were already parsed can still be
+    //! taken with `next`.
+    void close() { frames_.close(); }
+
+  private:
+    // Thrown by the collector to stop the stages once the stream is closed
+    struct closed {};
+
+    void read_(const std::string& p, size_t threads, const Entries& entries,
+               const Entries& skip_entries) {
+        PipelineThreads stages;
+        stages.decode = threads;
+        stages.worker = 1;
+
+        auto stage = [](bounded_queue<pipeline_frame>& frames,
+                        bounded_queue<pipeline_frame>& results) {
+            while (auto item = frames.pop()) {
+                if (!results.push(std::move(*item))) {
+                    return;
+                }
+            }
+        };
+
+        auto collector = [this](pipeline_frame& item) {
+            if (!frames_.push(std::move(item))) {
+                throw closed();
+            }
+        };
+
+        try {
+            run_stages<pipeline_frame>(stage, p, collector, stages, 0,
+                                       entries, skip_entries);
+        } catch (const closed&) {
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+
+        frames_.close();
+    }
+
+    bounded_queue<pipeline_frame> frames_;
+    std::exception_ptr error_;
+    std::thread reader_;
+};
+
+} // namespace lemon
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef LEMON_FRAME_TABLES_HPP
+#define LEMON_FRAME_TABLES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "lemon/residue_name.hpp"
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/Frame.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! The kinds of residues, shared by `FrameTables` and `FrameIndex`
+struct ResidueKinds {
+    //! The kind of a residue, given by its chemical composition type
+    enum Kind : uint8_t {
+        OTHER = 0,        //!< Any other composition type
+        PEPTIDE = 1,      //!< Contains *PEPTIDE*, but is not *PEPTIDE-LIKE*
+        NUCLEIC_ACID = 2, //!< Contains *DNA* or *RNA*
+    };
+};
+
+//! The residue and atom properties of a frame, in flat columns
+//!
+//! The properties of a `chemfiles::Frame` are stored in a map per residue and
+//! per atom, so reading them looks up and copies a string every time. A
+//! `FrameTables` reads them once, in a single pass over the frame, and stores
+//! them in columns of small integers like the columns written by
+//! `write_frame_view`. Strings are stored once in a string table and the
+//! columns refer to them by index, so two residues have the same chain or
+//! assembly if their indexes are equal. Missing string properties are stored
+//! as empty strings.
+class FrameTables : public ResidueKinds {
+  public:
+    //! Create empty tables
+    FrameTables() = default;
+
+    //! Read the properties of all residues and atoms of `frame`.
+    explicit FrameTables(const chemfiles::Frame& frame) {
+        using chemfiles::Property;
+        const auto& residues = frame.topology().residues();
+
+        names_.reserve(residues.size());
+        composition_types_.reserve(residues.size());
+        kinds_.reserve(residues.size());
+        chain_ids_.reserve(residues.size());
+        chain_names_.reserve(residues.size());
+        assemblies_.reserve(residues.size());
+        atom_counts_.reserve(residues.size());
+        heavy_atoms_.reserve(residues.size());
+
+        auto no_residue = static_cast<uint32_t>(residues.size());
+        residue_of_.assign(frame.size(), no_residue);
+        atomic_numbers_.resize(frame.size());
+        altlocs_.resize(frame.size());
+
+        for (size_t atom = 0; atom < frame.size(); ++atom) {
+            auto number = frame[atom].atomic_number().value_or(0);
+            atomic_numbers_[atom] =
+                number > 0 && number < 256 ? static_cast<uint8_t>(number) : 0;
+        }
+
+        // The kind of each composition type is found once
+        std::vector<Kind> kinds;
+        auto string_property = [this](const chemfiles::Residue& residue,
+                                      const std::string& name) {
+            auto property = residue.get(name);
+            if (!property || property->kind() != Property::STRING) {
+                return intern_(std::string());
+            }
+            return intern_(property->as_string());
+        };
+
+        for (size_t i = 0; i < residues.size(); ++i) {
+            const auto& residue = residues[i];
+
+            names_.push_back(intern_(residue.name()));
+            auto type = string_property(residue, "composition_type");
+            while (kinds.size() < strings_.size()) {
+                kinds.push_back(kind_(strings_[kinds.size()]));
+            }
+            composition_types_.push_back(type);
+            kinds_.push_back(kinds[type]);
+
+            chain_ids_.push_back(string_property(residue, "chainid"));
+            chain_names_.push_back(string_property(residue, "chainname"));
+            assemblies_.push_back(string_property(residue, "assembly"));
+
+            uint32_t heavy = 0;
+            for (auto atom : residue) {
+                residue_of_[atom] = static_cast<uint32_t>(i);
+                if (atomic_numbers_[atom] != 1) {
+                    ++heavy;
+                }
+            }
+            atom_counts_.push_back(static_cast<uint32_t>(residue.size()));
+            heavy_atoms_.push_back(heavy);
+        }
+
+        for (size_t atom = 0; atom < frame.size(); ++atom) {
+            auto altloc = frame[atom].get("altloc");
+            if (altloc && altloc->kind() == Property::STRING &&
+                !altloc->as_string().empty()) {
+                altlocs_[atom] = altloc->as_string()[0];
+            } else {
+                altlocs_[atom] = ' ';
+            }
+        }
+    }
+
+    //! The number of residues
+    size_t residue_count() const { return kinds_.size(); }
+
+    //! The number of atoms
+    size_t size() const { return residue_of_.size(); }
+
+    //! The string at `index` in the string table
+    const std::string& string(uint32_t index) const { return strings_[index]; }
+
+    //! The strings of the table, by index
+    const std::vector<std::string>& strings() const { return strings_; }
+
+    //! For each string of the table, 1 if it is in `values` and 0 otherwise.
+    //!
+    //! Use this function to check a column against a set of strings with one
+    //! lookup per residue in a small array.
+    std::vector<char> matching(
+        const std::unordered_set<std::string>& values) const {
+        std::vector<char> result(strings_.size(), 0);
+        for (size_t i = 0; i < strings_.size(); ++i) {
+            result[i] = values.count(strings_[i]) != 0;
+        }
+        return result;
+    }
+
+    //! For each string of the table, 1 if it is a residue name in `names` and 0
+    //! otherwise.
+    std::vector<char> matching_names(const ResidueNameSet& names) const {
+        std::vector<char> result(strings_.size(), 0);
+        for (size_t i = 0; i < strings_.size(); ++i) {
+            result[i] = valid_name_(strings_[i]) && names.contains(strings_[i]);
+        }
+        return result;
+    }
+
+    //! The name of each residue, as a string index
+    const std::vector<uint32_t>& names() const { return names_; }
+
+    //! The composition type of each residue, as a string index
+    const std::vector<uint32_t>& composition_types() const {
+        return composition_types_;
+    }
+
+    //! The kind of each residue
+    const std::vector<Kind>& kinds() const { return kinds_; }
+
+    //! The chain ID of each residue, as a string index
+    const std::vector<uint32_t>& chain_ids() const { return chain_ids_; }
+
+    //! The chain name of each residue, as a string index
+    const std::vector<uint32_t>& chain_names() const { return chain_names_; }
+
+    //! The assembly of each residue, as a string index
+    const std::vector<uint32_t>& assemblies() const { return assemblies_; }
+
+    //! The number of atoms of each residue
+    const std::vector<uint32_t>& atom_counts() const { return atom_counts_; }
+
+    //! The number of atoms of each residue which are not hydrogens
+    const std::vector<uint32_t>& heavy_atoms() const { return heavy_atoms_; }
+
+    //! The residue of each atom, `residue_count()` if none
+    const std::vector<uint32_t>& residue_of() const { return residue_of_; }
+
+    //! The atomic number of each atom, zero if unknown
+    const std::vector<uint8_t>& atomic_numbers() const {
+        return atomic_numbers_;
+    }
+
+    //! The alternative location of each atom, a space if none
+    const std::vector<char>& altlocs() const { return altlocs_; }
+
+  private:
+    uint32_t intern_(const std::string& value) {
+        auto found = indexes_.find(value);
+        if (found != indexes_.end()) {
+            return found->second;
+        }
+
+        auto index = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(value);
+        indexes_.emplace(value, index);
+        return index;
+    }
+
+    // Names which can be stored in a `ResidueName`, others are in no set
+    static bool valid_name_(const std::string& name) {
+        if (name.empty() || name.size() > 3) {
+            return false;
+        }
+        for (auto c : name) {
+            if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static Kind kind_(const std::string& type) {
+        if (type.find("DNA") != std::string::npos ||
+            type.find("RNA") != std::string::npos) {
+            return NUCLEIC_ACID;
+        }
+        if (type.find("PEPTIDE") != std::string::npos &&
+            type != "PEPTIDE-LIKE") {
+            return PEPTIDE;
+        }
+        return OTHER;
+    }
+
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> indexes_;
+
+    std::vector<uint32_t> names_;
+    std::vector<uint32_t> composition_types_;
+    std::vector<Kind> kinds_;
+    std::vector<uint32_t> chain_ids_;
+    std::vector<uint32_t> chain_names_;
+    std::vector<uint32_t> assemblies_;
+    std::vector<uint32_t> atom_counts_;
+    std::vector<uint32_t> heavy_atoms_;
+
+    std::vector<uint32_t> residue_of_;
+    std::vector<uint8_t> atomic_numbers_;
+    std::vector<char> altlocs_;
+};
+
+} // namespace lemon
+
+#endif
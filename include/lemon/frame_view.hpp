@@ -0,0 +1,584 @@
+#ifndef LEMON_FRAME_VIEW_HPP
+#define LEMON_FRAME_VIEW_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/Frame.hpp>
+#include <chemfiles/Topology.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! The layout of a structure stored in columns by `write_frame_view`.
+//!
+//! A stored structure starts with a header containing the size of every
+//! column, followed by the columns themselves, each starting on a multiple of
+//! eight bytes. Strings are stored once per structure in a string table and
+//! columns refer to them by index. Values are stored in the byte order of the
+//! machine which wrote them.
+struct FrameViewLayout {
+    //! Bumped when the layout changes
+    static constexpr uint64_t VERSION = 1;
+
+    //! Index of a missing string
+    static constexpr uint32_t NO_STRING = 0xFFFFFFFF;
+
+    //! Residue ID of a residue without ID
+    static constexpr uint64_t NO_ID = 0xFFFFFFFFFFFFFFFF;
+
+    //! The columns of a stored structure
+    enum Column {
+        POSITIONS,        //!< float[3 * atoms]
+        ATOMIC_NUMBER,    //!< uint8_t[atoms], zero if unknown
+        CHARGE,           //!< float[atoms]
+        ALTLOC,           //!< char[atoms], a space if none
+        ATOM_NAME,        //!< uint32_t[atoms], string index
+        ATOM_TYPE,        //!< uint32_t[atoms], string index
+        RESIDUE_OFFSETS,  //!< uint32_t[residues + 1], into RESIDUE_ATOMS
+        RESIDUE_ATOMS,    //!< uint32_t[residue_atoms]
+        RESIDUE_NAME,     //!< uint32_t[residues], string index
+        RESIDUE_ID,       //!< uint64_t[residues]
+        COMPOSITION_TYPE, //!< uint32_t[residues], string index
+        CHAINNAME,        //!< uint32_t[residues], string index
+        CHAINID,          //!< uint32_t[residues], string index
+        ASSEMBLY,         //!< uint32_t[residues], string index
+        BOND_OFFSETS,     //!< uint32_t[atoms + 1], into BOND_NEIGHBORS
+        BOND_NEIGHBORS,   //!< uint32_t[2 * bonds]
+        BOND_ORDERS,      //!< uint8_t[2 * bonds]
+        STRING_OFFSETS,   //!< uint32_t[strings + 1], into STRING_DATA
+        STRING_DATA,      //!< char[characters]
+        COLUMNS
+    };
+
+    //! The header of a stored structure
+    struct Header {
+        uint64_t version;
+        uint64_t atoms;
+        uint64_t residues;
+        uint64_t residue_atoms;
+        uint64_t bonds;
+        uint64_t strings;
+        uint64_t characters;
+        uint64_t periodic;
+        double cell[9];
+        double inverse[9];
+        uint64_t offsets[COLUMNS];
+        uint64_t sizes[COLUMNS];
+    };
+};
+
+class FrameView;
+
+//! A residue of a `FrameView`
+//!
+//! Like `chemfiles::Residue`, iterating over a `ResidueView` gives the indexes
+//! of the atoms of the residue.
+class ResidueView {
+  public:
+    ResidueView(const FrameView& frame, size_t index)
+        : frame_(&frame), index_(index) {}
+
+    //! The index of the residue in the frame
+    size_t index() const { return index_; }
+
+    //! The number of atoms in the residue
+    size_t size() const { return static_cast<size_t>(end() - begin()); }
+
+    //! The first atom index of the residue
+    inline const uint32_t* begin() const;
+
+    //! One past the last atom index of the residue
+    inline const uint32_t* end() const;
+
+    //! The name of the residue
+    inline std::string name() const;
+
+    //! The ID of the residue, if any
+    inline chemfiles::optional<uint64_t> id() const;
+
+    //! The chemical composition type of the residue, empty if unknown
+    inline std::string composition_type() const;
+
+    //! The name of the chain of the residue, empty if unknown
+    inline std::string chainname() const;
+
+    //! The ID of the chain of the residue, empty if unknown
+    inline std::string chainid() const;
+
+    //! The biological assembly of the residue, empty if unknown
+    inline std::string assembly() const;
+
+  private:
+    const FrameView* frame_;
+    size_t index_;
+};
+
+//! A read-only view of a structure stored in columns
+//!
+//! Building a `chemfiles::Frame` from a MMTF record allocates a string
+//! for every name and a property map for every atom and residue. A `FrameView`
+//! instead reads the structure from flat columns written once by
+//! `write_frame_view`, usually in a memory mapped `StructureCache`. Creating a
+//! view does not copy or allocate anything. The functions in the `select`,
+//! `prune` and `separate` namespaces accept a `FrameView` in place of a
+//! `chemfiles::Frame`.
+//!
+//! Coordinates are stored as single precision numbers, so distances can
+//! differ from the ones computed with a `chemfiles::Frame` by about 1e-5 Å.
+class FrameView {
+  public:
+    using Layout = FrameViewLayout;
+
+    //! Create a view of the structure stored in `size` bytes at `data`.
+    //!
+    //! The data must be aligned on eight bytes and outlive the view.
+    //! \throws std::runtime_error if the data is not a valid structure.
+    FrameView(const char* data, size_t size) : data_(data) {
+        if (size < sizeof(Layout::Header) ||
+            reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+            throw std::runtime_error("Invalid structure in cache");
+        }
+
+        header_ = reinterpret_cast<const Layout::Header*>(data);
+        if (header_->version != Layout::VERSION) {
+            throw std::runtime_error("Unsupported structure cache version");
+        }
+
+        const auto& h = *header_;
+
+        // Larger counts cannot fit in the data, and would overflow below
+        if (h.atoms > size || h.residues > size || h.residue_atoms > size ||
+            h.bonds > size || h.strings > size || h.characters > size) {
+            throw std::runtime_error("Invalid structure in cache");
+        }
+
+        const uint64_t expected[Layout::COLUMNS] = {
+            12 * h.atoms,         // POSITIONS
+            h.atoms,              // ATOMIC_NUMBER
+            4 * h.atoms,          // CHARGE
+            h.atoms,              // ALTLOC
+            4 * h.atoms,          // ATOM_NAME
+            4 * h.atoms,          // ATOM_TYPE
+            4 * (h.residues + 1), // RESIDUE_OFFSETS
+            4 * h.residue_atoms,  // RESIDUE_ATOMS
+            4 * h.residues,       // RESIDUE_NAME
+            8 * h.residues,       // RESIDUE_ID
+            4 * h.residues,       // COMPOSITION_TYPE
+            4 * h.residues,       // CHAINNAME
+            4 * h.residues,       // CHAINID
+            4 * h.residues,       // ASSEMBLY
+            4 * (h.atoms + 1),    // BOND_OFFSETS
+            8 * h.bonds,          // BOND_NEIGHBORS
+            2 * h.bonds,          // BOND_ORDERS
+            4 * (h.strings + 1),  // STRING_OFFSETS
+            h.characters          // STRING_DATA
+        };
+
+        for (size_t i = 0; i < Layout::COLUMNS; ++i) {
+            if (h.offsets[i] % 8 != 0 || h.offsets[i] > size ||
+                h.sizes[i] > size - h.offsets[i] ||
+                h.sizes[i] != expected[i]) {
+                throw std::runtime_error("Invalid structure in cache");
+            }
+        }
+
+        // The values read as offsets or indexes must stay in their columns
+        check_offsets_(Layout::RESIDUE_OFFSETS, h.residues, h.residue_atoms);
+        check_offsets_(Layout::BOND_OFFSETS, h.atoms, 2 * h.bonds);
+        check_offsets_(Layout::STRING_OFFSETS, h.strings, h.characters);
+
+        check_indexes_(Layout::RESIDUE_ATOMS, h.residue_atoms, h.atoms, false);
+        check_indexes_(Layout::BOND_NEIGHBORS, 2 * h.bonds, h.atoms, false);
+        check_indexes_(Layout::ATOM_NAME, h.atoms, h.strings, true);
+        check_indexes_(Layout::ATOM_TYPE, h.atoms, h.strings, true);
+        for (auto column : {Layout::RESIDUE_NAME, Layout::COMPOSITION_TYPE,
+                            Layout::CHAINNAME, Layout::CHAINID,
+                            Layout::ASSEMBLY}) {
+            check_indexes_(column, h.residues, h.strings, true);
+        }
+    }
+
+    //! The number of atoms in the structure
+    size_t size() const { return static_cast<size_t>(header_->atoms); }
+
+    //! The number of residues in the structure
+    size_t residue_count() const {
+        return static_cast<size_t>(header_->residues);
+    }
+
+    //! The number of bonds in the structure
+    size_t bond_count() const { return static_cast<size_t>(header_->bonds); }
+
+    //! The residue at `index`
+    ResidueView residue(size_t index) const { return {*this, index}; }
+
+    //! The coordinates of `atom`, as three consecutive numbers
+    const float* position(size_t atom) const {
+        return column<float>(Layout::POSITIONS) + 3 * atom;
+    }
+
+    //! The atomic number of `atom`, zero if unknown
+    uint8_t atomic_number(size_t atom) const {
+        return column<uint8_t>(Layout::ATOMIC_NUMBER)[atom];
+    }
+
+    //! The charge of `atom`
+    float charge(size_t atom) const {
+        return column<float>(Layout::CHARGE)[atom];
+    }
+
+    //! The alternative location of `atom`, a space if none
+    char altloc(size_t atom) const {
+        return column<char>(Layout::ALTLOC)[atom];
+    }
+
+    //! The name of `atom`
+    std::string atom_name(size_t atom) const {
+        return string(column<uint32_t>(Layout::ATOM_NAME)[atom]);
+    }
+
+    //! The type (element) of `atom`
+    std::string atom_type(size_t atom) const {
+        return string(column<uint32_t>(Layout::ATOM_TYPE)[atom]);
+    }
+
+    //! The first atom bonded to `atom`
+    const uint32_t* bonded_begin(size_t atom) const {
+        return column<uint32_t>(Layout::BOND_NEIGHBORS) +
+               column<uint32_t>(Layout::BOND_OFFSETS)[atom];
+    }
+
+    //! One past the last atom bonded to `atom`
+    const uint32_t* bonded_end(size_t atom) const {
+        return column<uint32_t>(Layout::BOND_NEIGHBORS) +
+               column<uint32_t>(Layout::BOND_OFFSETS)[atom + 1];
+    }
+
+    //! The order of the bond between `atom` and `*(bonded_begin(atom) + i)`
+    chemfiles::Bond::BondOrder bond_order(size_t atom, size_t i) const {
+        auto offset = column<uint32_t>(Layout::BOND_OFFSETS)[atom] + i;
+        return static_cast<chemfiles::Bond::BondOrder>(
+            column<uint8_t>(Layout::BOND_ORDERS)[offset]);
+    }
+
+    //! The matrix of the unit cell, with the cell vectors as columns, stored
+    //! by row. `nullptr` if the structure has no unit cell.
+    const double* cell() const {
+        return header_->periodic != 0 ? header_->cell : nullptr;
+    }
+
+    //! The distance between two atoms, using the periodic boundary conditions
+    //! of the unit cell like `chemfiles::Frame::distance`
+    double distance(size_t i, size_t j) const {
+        const auto* a = position(i);
+        const auto* b = position(j);
+        double v[3] = {static_cast<double>(a[0]) - static_cast<double>(b[0]),
+                       static_cast<double>(a[1]) - static_cast<double>(b[1]),
+                       static_cast<double>(a[2]) - static_cast<double>(b[2])};
+
+        if (header_->periodic != 0) {
+            const auto* m = header_->cell;
+            const auto* inv = header_->inverse;
+            double f[3];
+            for (size_t k = 0; k < 3; ++k) {
+                f[k] = inv[3 * k] * v[0] + inv[3 * k + 1] * v[1] +
+                       inv[3 * k + 2] * v[2];
+                f[k] -= std::round(f[k]);
+            }
+            for (size_t k = 0; k < 3; ++k) {
+                v[k] = m[3 * k] * f[0] + m[3 * k + 1] * f[1] +
+                       m[3 * k + 2] * f[2];
+            }
+        }
+
+        return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+
+    //! The string at `index` in the string table, empty for `NO_STRING`
+    std::string string(uint32_t index) const {
+        if (index == Layout::NO_STRING) {
+            return std::string();
+        }
+        const auto* offsets = column<uint32_t>(Layout::STRING_OFFSETS);
+        return std::string(column<char>(Layout::STRING_DATA) + offsets[index],
+                           offsets[index + 1] - offsets[index]);
+    }
+
+    //! The raw column `column` of the structure
+    template <typename T> const T* column(Layout::Column column) const {
+        return reinterpret_cast<const T*>(data_ + header_->offsets[column]);
+    }
+
+  private:
+    // Offsets must start at zero, never decrease and end before `bound`
+    void check_offsets_(Layout::Column column, uint64_t count,
+                        uint64_t bound) const {
+        const auto* offsets = this->column<uint32_t>(column);
+        if (offsets[0] != 0 || offsets[count] > bound) {
+            throw std::runtime_error("Invalid structure in cache");
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i + 1]) {
+                throw std::runtime_error("Invalid structure in cache");
+            }
+        }
+    }
+
+    // Indexes must be below `bound`, or be `NO_STRING` if `optional`
+    void check_indexes_(Layout::Column column, uint64_t count, uint64_t bound,
+                        bool optional) const {
+        const auto* indexes = this->column<uint32_t>(column);
+        for (size_t i = 0; i < count; ++i) {
+            if (indexes[i] >= bound &&
+                !(optional && indexes[i] == Layout::NO_STRING)) {
+                throw std::runtime_error("Invalid structure in cache");
+            }
+        }
+    }
+
+    const char* data_;
+    const Layout::Header* header_;
+};
+
+inline const uint32_t* ResidueView::begin() const {
+    return frame_->column<uint32_t>(FrameViewLayout::RESIDUE_ATOMS) +
+           frame_->column<uint32_t>(FrameViewLayout::RESIDUE_OFFSETS)[index_];
+}
+
+inline const uint32_t* ResidueView::end() const {
+    return frame_->column<uint32_t>(FrameViewLayout::RESIDUE_ATOMS) +
+           frame_->column<uint32_t>(
+               FrameViewLayout::RESIDUE_OFFSETS)[index_ + 1];
+}
+
+inline std::string ResidueView::name() const {
+    return frame_->string(
+        frame_->column<uint32_t>(FrameViewLayout::RESIDUE_NAME)[index_]);
+}
+
+inline chemfiles::optional<uint64_t> ResidueView::id() const {
+    auto id = frame_->column<uint64_t>(FrameViewLayout::RESIDUE_ID)[index_];
+    if (id == FrameViewLayout::NO_ID) {
+        return chemfiles::nullopt;
+    }
+    return id;
+}
+
+inline std::string ResidueView::composition_type() const {
+    return frame_->string(
+        frame_->column<uint32_t>(FrameViewLayout::COMPOSITION_TYPE)[index_]);
+}
+
+inline std::string ResidueView::chainname() const {
+    return frame_->string(
+        frame_->column<uint32_t>(FrameViewLayout::CHAINNAME)[index_]);
+}
+
+inline std::string ResidueView::chainid() const {
+    return frame_->string(
+        frame_->column<uint32_t>(FrameViewLayout::CHAINID)[index_]);
+}
+
+inline std::string ResidueView::assembly() const {
+    return frame_->string(
+        frame_->column<uint32_t>(FrameViewLayout::ASSEMBLY)[index_]);
+}
+
+//! Store a `chemfiles::Frame` in columns readable by a `FrameView`
+//!
+//! Only the data used by **Lemon** is stored: positions, atom names, types,
+//! atomic numbers, charges and alternative locations, residue names, IDs,
+//! composition types, chain names, chain IDs and assemblies, bonds and their
+//! orders, and the unit cell.
+//! \param [in] frame The frame to store.
+//! \param [out] output The buffer to store the frame in. It is cleared first.
+inline void write_frame_view(const chemfiles::Frame& frame,
+                             std::vector<char>& output) {
+    using Layout = FrameViewLayout;
+    using chemfiles::Property;
+
+    const auto& topology = frame.topology();
+    const auto& positions = frame.positions();
+    const auto& residues = topology.residues();
+    const auto& bonds = topology.bonds();
+    const auto& bond_orders = topology.bond_orders();
+    auto natoms = frame.size();
+
+    std::unordered_map<std::string, uint32_t> interned;
+    std::vector<uint32_t> string_offsets(1, 0);
+    std::string string_data;
+    auto intern = [&](const std::string& value) {
+        auto it = interned.find(value);
+        if (it != interned.end()) {
+            return it->second;
+        }
+        auto index = static_cast<uint32_t>(interned.size());
+        interned.emplace(value, index);
+        string_data += value;
+        string_offsets.push_back(static_cast<uint32_t>(string_data.size()));
+        return index;
+    };
+    auto intern_property = [&](const chemfiles::Residue& residue,
+                               const std::string& name) {
+        auto value = residue.get<Property::STRING>(name);
+        if (!value) {
+            return static_cast<uint32_t>(Layout::NO_STRING);
+        }
+        return intern(*value);
+    };
+
+    std::vector<float> atom_positions(3 * natoms);
+    std::vector<uint8_t> atomic_numbers(natoms);
+    std::vector<float> charges(natoms);
+    std::vector<char> altlocs(natoms);
+    std::vector<uint32_t> atom_names(natoms);
+    std::vector<uint32_t> atom_types(natoms);
+    for (size_t i = 0; i < natoms; ++i) {
+        const auto& atom = frame[i];
+        for (size_t k = 0; k < 3; ++k) {
+            atom_positions[3 * i + k] = static_cast<float>(positions[i][k]);
+        }
+        auto atomic_number = atom.atomic_number();
+        atomic_numbers[i] =
+            atomic_number ? static_cast<uint8_t>(*atomic_number) : 0;
+        charges[i] = static_cast<float>(atom.charge());
+        auto altloc = atom.get<Property::STRING>("altloc");
+        altlocs[i] = altloc && !altloc->empty() ? (*altloc)[0] : ' ';
+        atom_names[i] = intern(atom.name());
+        atom_types[i] = intern(atom.type());
+    }
+
+    std::vector<uint32_t> residue_offsets(1, 0);
+    std::vector<uint32_t> residue_atoms;
+    std::vector<uint32_t> residue_names;
+    std::vector<uint64_t> residue_ids;
+    std::vector<uint32_t> composition_types;
+    std::vector<uint32_t> chainnames;
+    std::vector<uint32_t> chainids;
+    std::vector<uint32_t> assemblies;
+    for (const auto& residue : residues) {
+        for (auto atom : residue) {
+            residue_atoms.push_back(static_cast<uint32_t>(atom));
+        }
+        residue_offsets.push_back(static_cast<uint32_t>(residue_atoms.size()));
+        residue_names.push_back(intern(residue.name()));
+        auto id = residue.id();
+        if (id) {
+            residue_ids.push_back(static_cast<uint64_t>(*id));
+        } else {
+            residue_ids.push_back(static_cast<uint64_t>(Layout::NO_ID));
+        }
+        composition_types.push_back(
+            intern_property(residue, "composition_type"));
+        chainnames.push_back(intern_property(residue, "chainname"));
+        chainids.push_back(intern_property(residue, "chainid"));
+        assemblies.push_back(intern_property(residue, "assembly"));
+    }
+
+    // Bonds are stored in both directions, in compressed sparse rows
+    std::vector<uint32_t> bond_offsets(natoms + 1, 0);
+    for (const auto& bond : bonds) {
+        ++bond_offsets[bond[0] + 1];
+        ++bond_offsets[bond[1] + 1];
+    }
+    for (size_t i = 0; i < natoms; ++i) {
+        bond_offsets[i + 1] += bond_offsets[i];
+    }
+    std::vector<uint32_t> bond_neighbors(2 * bonds.size());
+    std::vector<uint8_t> bond_order_column(2 * bonds.size());
+    std::vector<uint32_t> fill(bond_offsets.begin(), bond_offsets.end() - 1);
+    for (size_t i = 0; i < bonds.size(); ++i) {
+        auto order = static_cast<uint8_t>(
+            i < bond_orders.size() ? bond_orders[i] : chemfiles::Bond::UNKNOWN);
+        for (size_t side = 0; side < 2; ++side) {
+            auto atom = bonds[i][side];
+            auto slot = fill[atom]++;
+            bond_neighbors[slot] = static_cast<uint32_t>(bonds[i][1 - side]);
+            bond_order_column[slot] = order;
+        }
+    }
+
+    Layout::Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.version = Layout::VERSION;
+    header.atoms = natoms;
+    header.residues = residues.size();
+    header.residue_atoms = residue_atoms.size();
+    header.bonds = bonds.size();
+    header.strings = interned.size();
+    header.characters = string_data.size();
+
+    const auto& cell = frame.cell();
+    if (cell.shape() != chemfiles::UnitCell::INFINITE) {
+        auto m = cell.matrix();
+        auto det = m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2]) -
+                   m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                   m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        if (det != 0.0) {
+            header.periodic = 1;
+            for (size_t i = 0; i < 3; ++i) {
+                for (size_t j = 0; j < 3; ++j) {
+                    header.cell[3 * i + j] = m[i][j];
+                    // Inverse from the transposed matrix of cofactors
+                    auto r1 = (j + 1) % 3, r2 = (j + 2) % 3;
+                    auto c1 = (i + 1) % 3, c2 = (i + 2) % 3;
+                    header.inverse[3 * i + j] =
+                        (m[r1][c1] * m[r2][c2] - m[r1][c2] * m[r2][c1]) / det;
+                }
+            }
+        }
+    }
+
+    output.clear();
+    output.resize(sizeof(header));
+
+    auto append = [&](Layout::Column column, const void* data, size_t size) {
+        output.resize((output.size() + 7) / 8 * 8);
+        header.offsets[column] = output.size();
+        header.sizes[column] = size;
+        output.insert(output.end(), static_cast<const char*>(data),
+                      static_cast<const char*>(data) + size);
+    };
+
+    append(Layout::POSITIONS, atom_positions.data(), 4 * atom_positions.size());
+    append(Layout::ATOMIC_NUMBER, atomic_numbers.data(), atomic_numbers.size());
+    append(Layout::CHARGE, charges.data(), 4 * charges.size());
+    append(Layout::ALTLOC, altlocs.data(), altlocs.size());
+    append(Layout::ATOM_NAME, atom_names.data(), 4 * atom_names.size());
+    append(Layout::ATOM_TYPE, atom_types.data(), 4 * atom_types.size());
+    append(Layout::RESIDUE_OFFSETS, residue_offsets.data(),
+           4 * residue_offsets.size());
+    append(Layout::RESIDUE_ATOMS, residue_atoms.data(),
+           4 * residue_atoms.size());
+    append(Layout::RESIDUE_NAME, residue_names.data(),
+           4 * residue_names.size());
+    append(Layout::RESIDUE_ID, residue_ids.data(), 8 * residue_ids.size());
+    append(Layout::COMPOSITION_TYPE, composition_types.data(),
+           4 * composition_types.size());
+    append(Layout::CHAINNAME, chainnames.data(), 4 * chainnames.size());
+    append(Layout::CHAINID, chainids.data(), 4 * chainids.size());
+    append(Layout::ASSEMBLY, assemblies.data(), 4 * assemblies.size());
+    append(Layout::BOND_OFFSETS, bond_offsets.data(), 4 * bond_offsets.size());
+    append(Layout::BOND_NEIGHBORS, bond_neighbors.data(),
+           4 * bond_neighbors.size());
+    append(Layout::BOND_ORDERS, bond_order_column.data(),
+           bond_order_column.size());
+    append(Layout::STRING_OFFSETS, string_offsets.data(),
+           4 * string_offsets.size());
+    append(Layout::STRING_DATA, string_data.data(), string_data.size());
+
+    std::memcpy(output.data(), &header, sizeof(header));
+}
+
+} // namespace lemon
+
+#endif
@@ -18,13 +18,14 @@ LEMON_EXTERNAL_FILE_PUSH
 #endif
 LEMON_EXTERNAL_FILE_POP
 
-#include <cassert>
 #include <cstdint>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <array>
 
+#include "lemon/mapped_file.hpp"
+
 namespace lemon {
 
 //! The `Hadoop` class is used to read input sequence files.
@@ -44,9 +45,13 @@ class Hadoop {
     //! Returns if a sequence file has remaining MMTF records in it.
     //!
     //! Use this function to check if the sequence file has any remaining MMTF
-    //! records stored in it.
+    //! records stored in it. The value of a record returned by `next_key()`
+    //! which has not been read yet is skipped.
     //! \return True if another MMTF record is present. False otherwise.
-    bool has_next() { return stream_.peek() != std::char_traits<char>::eof(); }
+    bool has_next() {
+        skip_value();
+        return stream_.peek() != std::char_traits<char>::eof();
+    }
 
     //! Returns the next MMTF file.
     //!
@@ -57,12 +62,81 @@ class Hadoop {
     //! PDB ID and the second contains the GZ compressed MMTF file.
     std::pair<std::string, std::vector<char>> next() { return read(); }
 
+    //! Returns the PDB ID of the next MMTF record without reading its value.
+    //!
+    //! Use this function with `value()` or `skip_value()` to avoid reading
+    //! records which are not of interest. The value of a previous record which
+    //! was neither read nor skipped is skipped automatically.
+    //! \return The PDB ID of the next record.
+    //! \throws std::runtime_error if the key of the record is invalid.
+    std::string next_key() {
+        skip_value();
+
+        auto sync_check = read_int();
+        auto constexpr MARKER_SIZE = 16;
+
+        while (sync_check == -1) {
+            std::array<char, MARKER_SIZE> marker;
+            stream_.read(marker.data(), MARKER_SIZE);
+            // Only valid if using the full version
+            // assert(std::string(marker.data(), 16) == marker_);
+            sync_check = read_int();
+        }
+
+        auto key_length = read_int();
+
+        // The key is a length byte followed by the four characters of the ID
+        if (key_length < 5 || sync_check < key_length + 4) {
+            throw std::runtime_error("Invalid record in sequence file");
+        }
+
+        key_.resize(static_cast<size_t>(key_length));
+        stream_.read(key_.data(), key_length);
+
+        // Remove junk characters added by Java Serialization
+        std::array<char, 4> junk;
+        stream_.read(junk.data(), 4);
+
+        value_length_ = static_cast<size_t>(sync_check - key_length - 4);
+
+        return std::string(key_.data() + 1, 4);
+    }
+
+    //! Returns the value of the record whose key was returned by `next_key()`.
+    //!
+    //! \return The GZ compressed MMTF file.
+    std::vector<char> value() {
+        std::vector<char> value(value_length_);
+        stream_.read(value.data(), static_cast<std::streamsize>(value_length_));
+        value_length_ = 0;
+        return value;
+    }
+
+    //! Skip the value of the record whose key was returned by `next_key()`.
+    //!
+    //! The stream is moved past the value without reading it if it supports
+    //! seeking.
+    void skip_value() {
+        if (value_length_ == 0) {
+            return;
+        }
+
+        auto length = static_cast<std::streamoff>(value_length_);
+        value_length_ = 0;
+
+        if (stream_.rdbuf()->pubseekoff(length, std::ios::cur, std::ios::in) ==
+            std::streampos(std::streamoff(-1))) {
+            stream_.ignore(length);
+        }
+    }
+
     //! The size of the starting header
     static auto constexpr HADOOP_HEADER_SIZE = 90;
   private:
     std::istream& stream_;
     std::string marker_ = "";
     std::vector<char> key_;
+    size_t value_length_ = 0;
 
     // Initialize the sequence file.
     void initialize_() {
@@ -80,37 +154,137 @@ class Hadoop {
     }
 
     std::pair<std::string, std::vector<char>> read() {
-        auto sync_check = read_int();
-        auto constexpr MARKER_SIZE = 16;
+        auto entry = next_key();
+        return {entry, value()};
+    }
+};
 
-        if (sync_check == -1) {
-            std::vector<char> marker(MARKER_SIZE);
-            stream_.read(marker.data(), MARKER_SIZE);
-            // Only valid if using the full version
-            // assert(std::string(marker.data(), 16) == marker_);
-            return this->read();
+//! The `MappedHadoop` class reads memory mapped input sequence files.
+//!
+//! This class provides the same iteration as `Hadoop`, but the sequence file is
+//! mapped into memory instead of being read through a stream. Records are
+//! returned as views into the mapping, so no copy of the GZ compressed MMTF
+//! data is made. The views remain valid for the lifetime of the
+//! `MappedHadoop` object.
+class MappedHadoop {
+  public:
+    //! A view of a single MMTF record: the PDB ID and the compressed data.
+    using record = std::pair<std::string, chemfiles::span<const char>>;
+
+    //! Create a `MappedHadoop` class by mapping the sequence file at `path`.
+    //!
+    //! \param [in] path The location of a sequence file obtained from RCSB.
+    //! \throws std::runtime_error if the file cannot be mapped or is too small
+    //!  to be a sequence file.
+    explicit MappedHadoop(const std::string& path) : file_(path) {
+        // Completly skip the header as it is the same in all RCSB Hadoop files
+        pos_ = static_cast<size_t>(Hadoop::HADOOP_HEADER_SIZE - 3);
+
+        if (file_.size() < pos_) {
+            throw std::runtime_error("Invalid sequence file: " + path);
         }
+    }
 
-        auto key_length = read_int();
+    //! Returns if a sequence file has remaining MMTF records in it.
+    //!
+    //! \return True if another MMTF record is present. False otherwise.
+    bool has_next() const { return pos_ + value_length_ < file_.size(); }
+
+    //! Returns the next MMTF record.
+    //!
+    //! This function should only be used if has_next() has returned `true`.
+    //! \return A pair containing the PDB ID and a view of the GZ compressed MMTF
+    //!  file.
+    //! \throws std::runtime_error if the record extends past the end of the
+    //!  file.
+    record next() {
+        auto entry = next_key();
+        return {entry, value()};
+    }
+
+    //! Returns the PDB ID of the next MMTF record without viewing its value.
+    //!
+    //! Use this function with `value()` or `skip_value()` to avoid touching
+    //! the pages of records which are not of interest. The value of a previous
+    //! record which was not viewed is skipped automatically.
+    //! \return The PDB ID of the next record.
+    //! \throws std::runtime_error if the key of the record is invalid or if the
+    //!  record extends past the end of the file.
+    std::string next_key() {
+        skip_value();
+
+        auto sync_check = read_int_();
+        auto constexpr MARKER_SIZE = 16;
+
+        while (sync_check == -1) {
+            advance_(MARKER_SIZE);
+            sync_check = read_int_();
+        }
 
-        // Do not check this during runtime as it should all be the same
-        assert(key_length >= 4);
+        auto key_length = read_int_();
 
-        std::vector<char> key(static_cast<size_t>(key_length));
-        stream_.read(key.data(), key_length);
-        const auto entry = std::string(key.data() + 1, 4);
+        // The key is a length byte followed by the four characters of the ID
+        if (key_length < 5 || sync_check < key_length + 4) {
+            throw std::runtime_error("Invalid record in sequence file");
+        }
 
-        assert(sync_check >= 8);
+        auto key = advance_(static_cast<size_t>(key_length));
 
         // Remove junk characters added by Java Serialization
-        std::array<char, 4> junk;
-        stream_.read(junk.data(), 4);
+        advance_(4);
+
+        value_length_ = static_cast<size_t>(sync_check - key_length - 4);
+        if (value_length_ > file_.size() - pos_) {
+            throw std::runtime_error("Truncated record in sequence file");
+        }
+
+        return std::string(key + 1, 4);
+    }
+
+    //! Returns a view of the value whose key was returned by `next_key()`.
+    //!
+    //! \return A view of the GZ compressed MMTF file.
+    chemfiles::span<const char> value() {
+        auto length = value_length_;
+        value_length_ = 0;
+        return {advance_(length), length};
+    }
+
+    //! Skip the value of the record whose key was returned by `next_key()`.
+    void skip_value() {
+        advance_(value_length_);
+        value_length_ = 0;
+    }
+
+    //! The current offset, in bytes, from the start of the file.
+    size_t position() const { return pos_; }
+
+    //! The first byte of the mapped sequence file.
+    const char* data() const { return file_.data(); }
 
-        int value_length = sync_check - key_length;
-        std::vector<char> value(static_cast<size_t>(value_length - 4));
-        stream_.read(value.data(), value_length - 4);
+  private:
+    MappedFile file_;
+    size_t pos_ = 0;
+    size_t value_length_ = 0;
+
+    // Return the current location and move `count` bytes forward
+    const char* advance_(size_t count) {
+        if (count > file_.size() - pos_) {
+            throw std::runtime_error("Truncated record in sequence file");
+        }
+
+        auto current = file_.data() + pos_;
+        pos_ += count;
+        return current;
+    }
 
-        return {entry, value};
+    // Read four big endian bytes and return as an 4 byte integer
+    int read_int_() {
+        auto bytes = reinterpret_cast<const unsigned char*>(advance_(4));
+        return static_cast<int>(static_cast<uint32_t>(bytes[0]) << 24 |
+                                static_cast<uint32_t>(bytes[1]) << 16 |
+                                static_cast<uint32_t>(bytes[2]) << 8 |
+                                static_cast<uint32_t>(bytes[3]));
     }
 };
 
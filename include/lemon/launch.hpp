@@ -7,6 +7,8 @@
 
 #include <iostream>
 #include <ostream>
+#include <string>
+#include <vector>
 
 namespace lemon {
 
@@ -27,6 +29,23 @@ class LemonPythonBase {
     }
 };
 
+class LemonPythonBatchBase {
+  public:
+    virtual ~LemonPythonBatchBase() = default;
+
+    LemonPythonBatchBase() = default;
+    LemonPythonBatchBase(const LemonPythonBatchBase& other) = delete;
+    LemonPythonBatchBase(LemonPythonBatchBase&& other) noexcept = delete;
+
+    LemonPythonBatchBase& operator=(const LemonPythonBatchBase& other) = delete;
+    LemonPythonBatchBase& operator=(LemonPythonBatchBase&& other) noexcept = delete;
+
+    virtual std::string worker_batch(const std::vector<const chemfiles::Frame*>&,
+                                     const std::vector<std::string>&) = 0;
+    virtual void finalize() { /*Do nothing*/
+    }
+};
+
 //! Functor to combine the results of a workflow into a map
 //!
 //! This is a template functor which opens combines the results of a workflow
@@ -52,6 +71,21 @@ template <typename Map1> struct map_combine {
     Map1& internal_map_;
 };
 
+//! Functor to merge the accumulators of `launch_reduce` for maps
+//!
+//! This is the default way to merge accumulators when the workflow counts
+//! items in a map object or other type of associative array. The values of
+//! the second map are added to the values of the first map.
+template <typename Map> struct map_merge {
+
+    //! Add the content of `map2` to `map1`.
+    void operator()(Map& map1, const Map& map2) const {
+        for (const auto& sc : map2) {
+            map1[sc.first] += sc.second;
+        }
+    }
+};
+
 //! Functor to stream workflow results to an ostream object
 //!
 //! This is a template functor which streams workflow results to a `collector`.
@@ -66,8 +100,8 @@ struct print_combine {
     //! results to `collector`. This argument must derive from the
     //! `std::ostream` class and therefore provide an overload to the `<<`
     //! operator. Common examples of `collector` are `std::cout` and friends.
-    //! All workflow results are streamed to the `collect` after all entries
-    //! have been evaluated. \param collector An object for each workflow
+    //! Workflow results are streamed to the `collector` as soon as each entry
+    //! has been evaluated. \param collector An object for each workflow
     //! objects will be streamed to
     print_combine(std::ostream& collector) : internal_stream_(collector) {}
 
@@ -82,8 +116,10 @@ struct print_combine {
 //! Launch a **Lemon** workflow.
 //!
 //! This function reads **Lemon** options and passes them to the appropriate
-//! `run_parallel` function. This is the main entry point of a C++ **Lemon**
-//! program.
+//! `run_parallel` function, to `run_ordered` if the results were requested in
+//! PDB ID order with `--ordered`, or to `run_pipeline` if parsing threads were
+//! requested with `--decode_threads`. The two options cannot be combined.
+//! This is the main entry point of a C++ **Lemon** program.
 //! \param [in] o An instance of the `Options` used to pass arguments to Lemon
 //! \param worker Function object representing the body of the workflow.
 //! \param collect Function object for collect the results of `worker`.
@@ -95,8 +131,60 @@ int launch(const Options& o, Function&& worker, Collector& collect) {
     const auto& entries = read_entry_file(o.entries());
     const auto& skip_entries = read_entry_file(o.skip_entries());
 
+    if (o.ordered() && o.decode_threads() != 0) {
+        std::cerr << "--ordered cannot be combined with --decode_threads\n";
+        return 1;
+    }
+
+    try {
+        if (o.ordered()) {
+            lemon::run_ordered(worker, p, collect, threads, entries,
+                               skip_entries);
+        } else if (o.decode_threads() != 0) {
+            PipelineThreads stages;
+            stages.io = o.io_threads();
+            stages.decode = o.decode_threads();
+            stages.worker = threads;
+            lemon::run_pipeline(worker, p, collect, stages, entries,
+                                skip_entries);
+        } else {
+            lemon::run_parallel(worker, p, collect, threads, entries,
+                                skip_entries);
+        }
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+//! Launch a **Lemon** workflow which accumulates its results.
+//!
+//! This function reads **Lemon** options and passes them to `run_reduce`.
+//! Use it instead of `launch` and `map_combine` when the workflow adds the
+//! results of each entry to a total, such as a count or a histogram. The
+//! `worker` adds its results directly to the accumulator of its thread.
+//! \param [in] o An instance of the `Options` used to pass arguments to Lemon
+//! \param worker Function object representing the body of the workflow. It
+//!  accepts a `chemfiles::Frame`, the PDB ID and a reference to an
+//!  accumulator.
+//! \param total The accumulator receiving the results of all entries.
+//! \param merge Function object adding the content of an accumulator to
+//!  another one.
+//! \return 0 on success or a non-zero integer on error.
+template <typename Function, typename Accumulator,
+          typename Merge = map_merge<Accumulator>>
+int launch_reduce(const Options& o, Function&& worker, Accumulator& total,
+                  Merge&& merge = Merge()) {
+    const auto& p = o.work_dir();
+    auto threads = o.ncpu();
+    const auto& entries = read_entry_file(o.entries());
+    const auto& skip_entries = read_entry_file(o.skip_entries());
+
     try {
-        lemon::run_parallel(worker, p, collect, threads, entries, skip_entries);
+        lemon::run_reduce(worker, p, total, merge, threads, entries,
+                          skip_entries);
     } catch (std::runtime_error& e) {
         std::cerr << e.what() << "\n";
         return 1;
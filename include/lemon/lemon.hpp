@@ -1,15 +1,26 @@
 #ifndef LEMON_LEMON_HPP
 #define LEMON_LEMON_HPP
 
+#include "lemon/archive.hpp"
+#include "lemon/atom_grid.hpp"
 #include "lemon/constants.hpp"
 #include "lemon/count.hpp"
 #include "lemon/entries.hpp"
+#include "lemon/frame_index.hpp"
+#include "lemon/frame_stream.hpp"
+#include "lemon/frame_tables.hpp"
+#include "lemon/frame_view.hpp"
 #include "lemon/hadoop.hpp"
 #include "lemon/matrix.hpp"
+#include "lemon/pack.hpp"
 #include "lemon/parallel.hpp"
 #include "lemon/prune.hpp"
+#include "lemon/query.hpp"
+#include "lemon/query_plan.hpp"
 #include "lemon/residue_name.hpp"
 #include "lemon/select.hpp"
+#include "lemon/selection.hpp"
 #include "lemon/separate.hpp"
+#include "lemon/structure_cache.hpp"
 
 #endif
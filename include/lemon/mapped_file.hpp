@@ -0,0 +1,178 @@
+#ifndef LEMON_MAPPED_FILE_HPP
+#define LEMON_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#ifndef _MSVC_LANG
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <WinSock2.h>
+#include <Windows.h>
+#endif
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! The `MappedFile` class maps a file read-only into memory.
+//!
+//! The contents of the file are available through `data()` for the lifetime of
+//! the object. Pages are loaded by the operating system on first access, so
+//! mapping a large file is cheap and only the parts which are read cost I/O.
+//! If the file is already in the page cache (or on a `tmpfs` such as
+//! `/dev/shm`), no copy of the data is made.
+class MappedFile {
+  public:
+    //! Create an empty mapping
+    MappedFile() = default;
+
+    //! Map the file at `path` into memory.
+    //!
+    //! \param [in] path The file to map.
+    //! \throws std::runtime_error if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string& path) { open_(path); }
+
+    ~MappedFile() { close_(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept { swap_(other); }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close_();
+            swap_(other);
+        }
+        return *this;
+    }
+
+    //! The first byte of the mapped file
+    const char* data() const { return data_; }
+
+    //! The size of the mapped file in bytes
+    size_t size() const { return size_; }
+
+    //! Returns true if nothing is mapped (or the file is empty)
+    bool empty() const { return size_ == 0; }
+
+  private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+#ifndef _MSVC_LANG
+    void open_(const std::string& path) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path);
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Could not stat " + path);
+        }
+
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            return;
+        }
+
+        auto addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps its own reference to the file
+
+        if (addr == MAP_FAILED) {
+            size_ = 0;
+            throw std::runtime_error("Could not map " + path);
+        }
+
+        data_ = static_cast<const char*>(addr);
+    }
+
+    void close_() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    void swap_(MappedFile& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+#else
+    HANDLE mapping_ = nullptr;
+
+    void open_(const std::string& path) {
+        auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                                nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Could not open " + path);
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            throw std::runtime_error("Could not stat " + path);
+        }
+
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        if (size_ == 0) {
+            CloseHandle(file);
+            return;
+        }
+
+        mapping_ =
+            CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file); // The mapping keeps its own reference to the file
+
+        if (mapping_ == nullptr) {
+            size_ = 0;
+            throw std::runtime_error("Could not map " + path);
+        }
+
+        data_ = static_cast<const char*>(
+            MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+        if (data_ == nullptr) {
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+            size_ = 0;
+            throw std::runtime_error("Could not map " + path);
+        }
+    }
+
+    void close_() {
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        data_ = nullptr;
+        mapping_ = nullptr;
+        size_ = 0;
+    }
+
+    void swap_(MappedFile& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(mapping_, other.mapping_);
+    }
+#endif
+};
+
+} // namespace lemon
+
+#endif
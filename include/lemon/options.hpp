@@ -47,6 +47,21 @@ class Options : public CLI::App {
             ->ignore_case()
             ->ignore_underscore()
             ->check(CLI::ExistingFile);
+
+        add_option("--decode_threads,-d", decode_threads_,
+                   "Threads used to parse entries ahead of the workers (0 to "
+                   "parse entries in the worker threads)")
+            ->ignore_case()
+            ->ignore_underscore();
+
+        add_option("--io_threads", io_threads_,
+                   "Threads used to read entries when --decode_threads is set")
+            ->ignore_case()
+            ->ignore_underscore();
+
+        add_flag("--ordered", ordered_,
+                 "Collect the results in PDB ID order")
+            ->ignore_case();
     }
 
     //! Constructor for an `Options` class which does not use custom options
@@ -107,11 +122,24 @@ class Options : public CLI::App {
     //! Index to skip entries.
     const std::string& skip_entries() const { return skip_entries_; }
 
+    //! Number of threads parsing entries for the workers. Zero if the workers
+    //! parse the entries themselves.
+    size_t decode_threads() const { return decode_threads_; }
+
+    //! Number of threads reading entries from disk for the parsing threads
+    size_t io_threads() const { return io_threads_; }
+
+    //! Are the results collected in PDB ID order?
+    bool ordered() const { return ordered_; }
+
   private:
     std::string work_dir_;
     size_t ncpu_ = 1;
     std::string entries_;
     std::string skip_entries_;
+    size_t decode_threads_ = 0;
+    size_t io_threads_ = 1;
+    bool ordered_ = false;
 };
 } // namespace lemon
 
@@ -0,0 +1,403 @@
+#ifndef LEMON_PACK_HPP
+#define LEMON_PACK_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lemon/archive.hpp"
+#include "lemon/entries.hpp"
+#include "lemon/hadoop.hpp"
+#include "lemon/mapped_file.hpp"
+
+namespace lemon {
+
+//! Constants describing the layout of a **Lemon** pack file.
+//!
+//! A pack file starts with a header of `HEADER_SIZE` bytes containing the
+//! `MAGIC` string, the format version, the number of records and the offset
+//! of the index. The uncompressed MMTF records follow, each starting on a
+//! multiple of `ALIGNMENT` bytes. The index is stored after the records and
+//! contains, for each record, its PDB ID padded with zeros to `KEY_SIZE`
+//! bytes followed by its offset and length. Index entries are sorted by PDB
+//! ID. All integers are stored as little endian 64 bit values.
+struct PackFormat {
+    static constexpr const char* MAGIC = "LEMONPAK";
+    static constexpr const char* EXTENSION = ".lemon";
+    static constexpr uint64_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 64;
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t KEY_SIZE = 16;
+    static constexpr size_t ENTRY_SIZE = KEY_SIZE + 16;
+
+    static void write_u64(char* output, uint64_t value) {
+        for (size_t i = 0; i < 8; ++i) {
+            output[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    static uint64_t read_u64(const char* input) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(input[i]))
+                     << (8 * i);
+        }
+        return value;
+    }
+};
+
+//! The `PackWriter` class creates a **Lemon** pack file.
+//!
+//! Records are appended with `add` and the index is written by `finish`. The
+//! MMTF data given to `add` should not be compressed, as the point of a pack
+//! file is to avoid decompressing records every time the PDB is read.
+class PackWriter {
+  public:
+    //! Create the pack file at `path`, replacing any existing file.
+    //!
+    //! \throws std::runtime_error if the file cannot be created.
+    explicit PackWriter(const std::string& path)
+        : path_(path), output_(path, std::ofstream::binary) {
+        if (!output_) {
+            throw std::runtime_error("Could not create " + path);
+        }
+
+        std::string header(PackFormat::HEADER_SIZE, '\0');
+        output_.write(header.data(), static_cast<std::streamsize>(header.size()));
+        position_ = PackFormat::HEADER_SIZE;
+    }
+
+    ~PackWriter() {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+    PackWriter(const PackWriter&) = delete;
+    PackWriter& operator=(const PackWriter&) = delete;
+
+    //! Append an uncompressed MMTF record to the pack file.
+    //!
+    //! \param [in] pdbid The PDB ID of the record.
+    //! \param [in] data The MMTF data of the record.
+    //! \param [in] size The size of the MMTF data in bytes.
+    //! \throws std::runtime_error if the PDB ID is too long or the record
+    //!  cannot be written.
+    void add(const std::string& pdbid, const char* data, size_t size) {
+        if (finished_) {
+            throw std::runtime_error("Pack file " + path_ + " is finished");
+        }
+
+        if (pdbid.empty() || pdbid.size() > PackFormat::KEY_SIZE) {
+            throw std::runtime_error("Invalid PDB ID for pack file: " + pdbid);
+        }
+
+        pad_();
+        entries_.push_back({pdbid, 0, position_, size, size});
+        output_.write(data, static_cast<std::streamsize>(size));
+        position_ += size;
+
+        if (!output_) {
+            throw std::runtime_error("Could not write to " + path_);
+        }
+    }
+
+    //! The number of records added so far.
+    size_t size() const { return entries_.size(); }
+
+    //! Write the index and the header. No records can be added afterwards.
+    //!
+    //! \throws std::runtime_error if the file cannot be written.
+    void finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        std::stable_sort(entries_.begin(), entries_.end(),
+                         [](const ArchiveRecord& a, const ArchiveRecord& b) {
+                             return a.pdbid < b.pdbid;
+                         });
+
+        pad_();
+        auto index_offset = position_;
+
+        std::vector<char> entry(PackFormat::ENTRY_SIZE);
+        for (const auto& record : entries_) {
+            std::fill(entry.begin(), entry.end(), '\0');
+            std::memcpy(entry.data(), record.pdbid.data(), record.pdbid.size());
+            PackFormat::write_u64(entry.data() + PackFormat::KEY_SIZE,
+                                  record.offset);
+            PackFormat::write_u64(entry.data() + PackFormat::KEY_SIZE + 8,
+                                  record.length);
+            output_.write(entry.data(),
+                          static_cast<std::streamsize>(entry.size()));
+        }
+
+        std::vector<char> header(PackFormat::HEADER_SIZE, '\0');
+        std::memcpy(header.data(), PackFormat::MAGIC, 8);
+        PackFormat::write_u64(header.data() + 8, PackFormat::VERSION);
+        PackFormat::write_u64(header.data() + 16, entries_.size());
+        PackFormat::write_u64(header.data() + 24, index_offset);
+
+        output_.seekp(0);
+        output_.write(header.data(), static_cast<std::streamsize>(header.size()));
+        output_.close();
+
+        if (!output_) {
+            throw std::runtime_error("Could not write to " + path_);
+        }
+    }
+
+  private:
+    std::string path_;
+    std::ofstream output_;
+    std::vector<ArchiveRecord> entries_;
+    uint64_t position_ = 0;
+    bool finished_ = false;
+
+    void pad_() {
+        auto padding = (PackFormat::ALIGNMENT -
+                        position_ % PackFormat::ALIGNMENT) %
+                       PackFormat::ALIGNMENT;
+        static const char zeros[PackFormat::ALIGNMENT] = {};
+        output_.write(zeros, static_cast<std::streamsize>(padding));
+        position_ += padding;
+    }
+};
+
+//! Read the names of all pack files in a directory.
+//!
+//! \param [in] p The directory containing the pack files.
+//! \param [in] extension The extension of the pack files.
+//! \return The full paths of the pack files, sorted by name. Empty if `p` is
+//!  not a directory or does not contain pack files.
+inline std::vector<std::string>
+read_pack_dir(const std::string& p,
+              const std::string& extension = PackFormat::EXTENSION) {
+    std::vector<std::string> pathvec;
+
+    auto dp = opendir(p.c_str());
+    if (dp == nullptr) {
+        return pathvec;
+    }
+
+    for (auto entry = readdir(dp); entry != nullptr; entry = readdir(dp)) {
+        std::string s = entry->d_name;
+        if (s[0] == '.' || s.size() <= extension.size() ||
+            s.compare(s.size() - extension.size(), extension.size(),
+                      extension) != 0) {
+            continue;
+        }
+        pathvec.emplace_back(p + "/" + s);
+    }
+
+    closedir(dp);
+    std::sort(pathvec.begin(), pathvec.end());
+    return pathvec;
+}
+
+//! Returns true if the directory at `p` contains **Lemon** pack files.
+inline bool is_pack_dir(const std::string& p) {
+    return !read_pack_dir(p).empty();
+}
+
+//! The `Pack` class reads a directory of **Lemon** pack files.
+//!
+//! Pack files are created from the RCSB Hadoop sequence files by the `lm_pack`
+//! program. They contain the same MMTF records, but without compression, so
+//! reading a pack only costs parsing. Each pack file contains an index of its
+//! records, so entries can be found without reading the records. The records
+//! are aligned in the file, which is mapped into memory.
+class Pack {
+  public:
+    //! The format to use with `chemfiles::Trajectory::memory_reader`
+    static constexpr const char* FORMAT = "MMTF";
+
+    //! Open the directory of pack files at `p`.
+    //!
+    //! \param [in] p A path to the directory containing the pack files.
+    //! \param [in] extension The extension of the pack files.
+    //! \throws std::runtime_error if there are no pack files in `p` or one of
+    //!  them is invalid.
+    explicit Pack(const std::string& p,
+                  const std::string& extension = PackFormat::EXTENSION)
+        : path_(p) {
+        files_ = read_pack_dir(p, extension);
+        if (files_.empty()) {
+            throw std::runtime_error("No " + extension + " files found in " +
+                                     p);
+        }
+
+        for (size_t i = 0; i < files_.size(); ++i) {
+            mapped_.emplace_back(files_[i]);
+            read_index_(i);
+        }
+
+        for (size_t i = 0; i < records_.size(); ++i) {
+            lookup_.emplace(records_[i].pdbid, i);
+        }
+    }
+
+    //! The pack files in the directory.
+    const std::vector<std::string>& files() const { return files_; }
+
+    //! All records in the pack, in the order they appear on disk.
+    const std::vector<ArchiveRecord>& records() const { return records_; }
+
+    //! The number of records in the pack.
+    size_t size() const { return records_.size(); }
+
+    //! Returns true if the pack contains a record for `pdbid`.
+    bool contains(const std::string& pdbid) const {
+        return lookup_.count(pdbid) != 0;
+    }
+
+    //! Select the records for the given entries.
+    //!
+    //! \param [in] entries Which entries to use. All records if blank.
+    //! \param [in] skip_entries Which entries to skip. Not used if blank.
+    //! \return The selected records, in the order they appear on disk.
+    std::vector<const ArchiveRecord*>
+    select(const Entries& entries = Entries(),
+           const Entries& skip_entries = Entries()) const {
+        std::vector<const ArchiveRecord*> selection;
+
+        if (entries.empty()) {
+            selection.reserve(records_.size());
+            for (const auto& record : records_) {
+                selection.push_back(&record);
+            }
+        } else {
+            selection.reserve(entries.size());
+            for (const auto& entry : entries) {
+                auto range = lookup_.equal_range(entry);
+                for (auto it = range.first; it != range.second; ++it) {
+                    selection.push_back(&records_[it->second]);
+                }
+            }
+
+            std::sort(selection.begin(), selection.end(),
+                      [](const ArchiveRecord* a, const ArchiveRecord* b) {
+                          return a->file != b->file ? a->file < b->file
+                                                    : a->offset < b->offset;
+                      });
+        }
+
+        if (!skip_entries.empty()) {
+            selection.erase(
+                std::remove_if(selection.begin(), selection.end(),
+                    [&skip_entries](const ArchiveRecord* record) {
+                        return skip_entries.count(record->pdbid) != 0;
+                    }),
+                selection.end());
+        }
+
+        return selection;
+    }
+
+    //! The uncompressed MMTF data of a record.
+    //!
+    //! The returned view is valid for the lifetime of the `Pack`.
+    chemfiles::span<const char> data(const ArchiveRecord& record) const {
+        return {mapped_[record.file].data() + record.offset,
+                static_cast<size_t>(record.length)};
+    }
+
+    //! The uncompressed MMTF data for a given PDB ID.
+    //!
+    //! \throws std::out_of_range if the entry is not in the pack.
+    chemfiles::span<const char> data(const std::string& pdbid) const {
+        return data(find_(pdbid));
+    }
+
+    //! Read a record into a `chemfiles::Frame`.
+    chemfiles::Frame read(const ArchiveRecord& record) const {
+        auto value = data(record);
+        auto traj = chemfiles::Trajectory::memory_reader(
+            value.data(), value.size(), FORMAT);
+        return traj.read();
+    }
+
+    //! Read the entry with the given PDB ID into a `chemfiles::Frame`.
+    //!
+    //! \param [in] pdbid The PDB ID of interest, for example *1AAQ*.
+    //! \return The parsed entry.
+    //! \throws std::out_of_range if the entry is not in the pack.
+    chemfiles::Frame get(const std::string& pdbid) const {
+        return read(find_(pdbid));
+    }
+
+  private:
+    std::string path_;
+    std::vector<std::string> files_;
+    std::vector<MappedFile> mapped_;
+    std::vector<ArchiveRecord> records_;
+    std::unordered_multimap<std::string, size_t> lookup_;
+
+    const ArchiveRecord& find_(const std::string& pdbid) const {
+        auto it = lookup_.find(pdbid);
+        if (it == lookup_.end()) {
+            throw std::out_of_range("Entry " + pdbid + " is not in " + path_);
+        }
+        return records_[it->second];
+    }
+
+    void read_index_(size_t file) {
+        const auto& mapped = mapped_[file];
+        const auto* data = mapped.data();
+        auto invalid = [&] {
+            return std::runtime_error("Invalid pack file " + files_[file]);
+        };
+
+        if (mapped.size() < PackFormat::HEADER_SIZE ||
+            std::memcmp(data, PackFormat::MAGIC, 8) != 0) {
+            throw invalid();
+        }
+
+        if (PackFormat::read_u64(data + 8) != PackFormat::VERSION) {
+            throw std::runtime_error("Unsupported pack file version in " +
+                                     files_[file]);
+        }
+
+        auto count = PackFormat::read_u64(data + 16);
+        auto index_offset = PackFormat::read_u64(data + 24);
+        if (index_offset > mapped.size() ||
+            count > (mapped.size() - index_offset) / PackFormat::ENTRY_SIZE) {
+            throw invalid();
+        }
+
+        auto first = records_.size();
+        records_.reserve(first + count);
+        for (uint64_t i = 0; i < count; ++i) {
+            const auto* entry = data + index_offset + i * PackFormat::ENTRY_SIZE;
+            auto key_end = std::find(entry, entry + PackFormat::KEY_SIZE, '\0');
+            auto offset = PackFormat::read_u64(entry + PackFormat::KEY_SIZE);
+            auto length = PackFormat::read_u64(entry + PackFormat::KEY_SIZE + 8);
+
+            if (offset > index_offset || length > index_offset - offset) {
+                throw invalid();
+            }
+
+            records_.push_back(
+                {std::string(entry, key_end), file, offset, length, length});
+        }
+
+        std::sort(records_.begin() + static_cast<std::ptrdiff_t>(first),
+                  records_.end(),
+                  [](const ArchiveRecord& a, const ArchiveRecord& b) {
+                      return a.offset < b.offset;
+                  });
+    }
+};
+
+} // namespace lemon
+
+#endif
@@ -1,25 +1,192 @@
 #ifndef LEMON_PARALLEL_HPP
 #define LEMON_PARALLEL_HPP
 
-#include <list>
+#include <cstddef>
 
+#include "lemon/archive.hpp"
+#include "lemon/bounded_queue.hpp"
 #include "lemon/hadoop.hpp"
 #include "lemon/entries.hpp"
-
-#include <chrono>
-
-#ifdef LEMON_USE_ASYNC
+#include "lemon/pack.hpp"
+#include "lemon/reorder_buffer.hpp"
 #include "lemon/thread_pool.hpp"
-#else
-#include <thread>
-#endif
+#include "lemon/work_stealing.hpp"
 
-#ifdef LEMON_BENCHMARK
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
-#endif
+#include <memory>
+#include <thread>
 
 namespace lemon {
 
+//! Print the error which stopped reading `source` to `std::cerr`.
+//!
+//! Call this function from a `catch` block. The records read before the error
+//! are still processed, and the other files are read as usual.
+inline void report_read_error(const std::string& source) {
+    try {
+        throw;
+    } catch (const std::exception& e) {
+        std::cerr << "Could not read " + source + ": " + e.what() + "\n";
+    } catch (...) {
+        std::cerr << "Could not read " + source + "\n";
+    }
+}
+
+//! The records of a workflow, shared between threads with work stealing.
+//!
+//! A job is either a single record or a sequence file which still has to be
+//! scanned for its records. The cost of a record depends on the size of the
+//! entry, so records are balanced between threads by work stealing instead of
+//! giving each thread the same number of files or records. Each thread starts
+//! with a contiguous block of records or files. The records of a sequence file
+//! are put in front of the deque of the thread which scanned it, so that other
+//! threads can steal them from the back.
+class record_scheduler {
+  public:
+    //! Select the records in `p` for `ncpu` threads.
+    //!
+    //! \param [in] p A path to the Hadoop sequence file directory, or to a
+    //!  directory of pack files created by `lm_pack`.
+    //! \param [in] ncpu The number of threads taking records.
+    //! \param [in] entries Which entries to use. Not used if blank. Otherwise,
+    //!  the `Archive` index is used so that only these entries are read.
+    //! \param [in] skip_entries Which entries to skip. Not used if blank.
+    //! \param [in] part Only take the records, or sequence files, whose index
+    //!  modulo `parts` is `part`. Used to split the work between processes.
+    //! \param [in] parts The number of parts the work is split into.
+    record_scheduler(const std::string& p, size_t ncpu, const Entries& entries,
+                     const Entries& skip_entries, size_t part = 0,
+                     size_t parts = 1)
+        : skip_entries_(skip_entries), jobs_(ncpu), unscanned_(0) {
+        parts = std::max<size_t>(parts, 1);
+        if (is_pack_dir(p)) {
+            pack_.reset(new Pack(p));
+        } else if (!entries.empty()) {
+            // Use the index to only touch the records which were requested
+            archive_.reset(new Archive(p));
+        }
+
+        ncpu = jobs_.workers();
+        if (pack_ || archive_) {
+            auto selected = pack_ ? pack_->select(entries, skip_entries)
+                                  : archive_->select(entries, skip_entries);
+            if (pack_) {
+                format_ = Pack::FORMAT;
+            }
+
+            std::vector<const ArchiveRecord*> records;
+            for (size_t i = part; i < selected.size(); i += parts) {
+                records.push_back(selected[i]);
+            }
+
+            for (size_t i = 0; i < records.size(); ++i) {
+                const auto& record = *records[i];
+                auto value =
+                    pack_ ? pack_->data(record) : archive_->data(record);
+                jobs_.push(i * ncpu / records.size(),
+                           {record.pdbid, value, record.file, false});
+            }
+        } else {
+            pathvec_ = read_hadoop_dir(p);
+            sequences_.resize(pathvec_.size());
+
+            std::vector<size_t> files;
+            for (size_t i = part; i < pathvec_.size(); i += parts) {
+                files.push_back(i);
+            }
+            unscanned_ = files.size();
+
+            for (size_t i = 0; i < files.size(); ++i) {
+                jobs_.push(i * ncpu / files.size(),
+                           {std::string(), chemfiles::span<const char>(),
+                            files[i], true});
+            }
+        }
+    }
+
+    //! Process records on the thread `index` until there are none left.
+    //!
+    //! \param [in] index The index of the calling thread, less than `ncpu`.
+    //! \param function Called with the compressed data, the PDB ID, the file
+    //!  containing the record and the format of the data for each record. The
+    //!  thread stops taking records when it returns false.
+    template <typename Function>
+    void process(size_t index, Function&& function) {
+        while (true) {
+            // A file being scanned by another thread may still add jobs
+            auto pending = unscanned_.load();
+            auto next = jobs_.pop(index);
+            if (!next) {
+                if (pending == 0) {
+                    return;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (next->scan) {
+                scan_file_(index, next->file);
+            } else if (!function(next->value, next->pdbid,
+                                 files_()[next->file], format_)) {
+                return;
+            }
+        }
+    }
+
+  private:
+    struct job {
+        std::string pdbid;
+        chemfiles::span<const char> value;
+        size_t file;
+        bool scan;
+    };
+
+    const std::vector<std::string>& files_() const {
+        if (pack_) {
+            return pack_->files();
+        }
+        if (archive_) {
+            return archive_->files();
+        }
+        return pathvec_;
+    }
+
+    void scan_file_(size_t index, size_t file) {
+        std::vector<job> found;
+        try {
+            // Kept alive until the end, as the records are views into it
+            sequences_[file].reset(new MappedHadoop(pathvec_[file]));
+            auto& sequence = *sequences_[file];
+            while (sequence.has_next()) {
+                auto pdbid = sequence.next_key();
+                if (skip_entries_.size() && skip_entries_.count(pdbid) != 0) {
+                    sequence.skip_value();
+                    continue;
+                }
+                found.push_back({std::move(pdbid), sequence.value(), file,
+                                 false});
+            }
+        } catch (...) {
+            report_read_error(pathvec_[file]);
+        }
+        jobs_.push_front(index, std::move(found));
+        --unscanned_;
+    }
+
+    const Entries& skip_entries_;
+    std::unique_ptr<Pack> pack_;
+    std::unique_ptr<Archive> archive_;
+    std::vector<std::string> pathvec_;
+    std::vector<std::unique_ptr<MappedHadoop>> sequences_;
+    const char* format_ = "MMTF/GZ";
+    work_stealing_queue<job> jobs_;
+    std::atomic<size_t> unscanned_;
+};
+
 #ifndef LEMON_USE_ASYNC
 
 //! The `run_parallel` function launches jobs which do return data.
@@ -28,82 +195,87 @@ namespace lemon {
 //! `worker` should accept two arguments, a `chemfiles::Frame` and a
 //! `std::string`. It must return a value as this value will be appended, using
 //! the `combine` function object, the the `collector`. See the `Lemon Workflow`
-//! documention for more details. \param worker A function object (C++11 lambda,
-//! struct the with operator()
+//! documention for more details. The `collector` is called on the calling
+//! thread as soon as results are available, so it does not need to be thread
+//! safe and its output appears while the workflow is running.
+//! \param worker A function object (C++11 lambda, struct the with operator()
 //!  overloaded, or std::function object) that the user wishes to apply.
-//! \param [in] p A path to the Hadoop sequence file directory.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
 //!  by the worker object which are appended with `combine`.
 //! \param collector A function object that handles the output of `worker`.
 //! \param [in] ncpu The number of threads to use.
-//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] entries Which entries to use. Not used if blank. Otherwise,
+//!  the `Archive` index is used so that only these entries are read.
 //! \param [in] skip_entries Which entries to skip. Not used if blank.
 template <typename Function, typename Collector>
 inline void run_parallel(Function&& worker, const std::string& p,
                          Collector& collector, size_t ncpu = 1,
                          const Entries& entries = Entries(),
                          const Entries& skip_entries = Entries()) {
-    auto pathvec = read_hadoop_dir(p);
-    std::vector<std::thread> threads(ncpu);
+    ncpu = std::max<size_t>(ncpu, 1);
     using ret = typename std::result_of<Function&(chemfiles::Frame,
                                                   const std::string&)>::type;
 
-    // Total number of jobs for each thread
-    const int grainsize = static_cast<int>(pathvec.size() / ncpu);
-    auto work_iter = pathvec.begin();
-    using iter = std::vector<std::string>::iterator;
-    std::unordered_map<std::thread::id, std::list<ret>> results;
-
-    auto call_function = [&worker, &results, &entries,
-                          &skip_entries](iter first, iter last) {
-        auto th = std::this_thread::get_id();
-        for (auto it = first; it != last; ++it) {
-            std::ifstream data(*it, std::istream::binary);
-            Hadoop sequence(data);
+    // Results are handed to the collector on the calling thread while the
+    // workers run. Only a few results per thread wait in the queue, so memory
+    // use does not grow with the number of entries.
+    bounded_queue<ret> results(4 * ncpu);
+    std::atomic<size_t> running(ncpu);
 
-            while (sequence.has_next()) {
-                auto pair = sequence.next();
-                if (entries.size() && entries.count(pair.first) == 0) {
-                    continue;
-                }
-                if (skip_entries.size() &&
-                    skip_entries.count(pair.first) != 0) {
-                    continue;
-                }
-                try {
+    // Returns false once the results are no longer collected
+    auto call_worker = [&worker, &results](chemfiles::span<const char> value,
+                                           const std::string& pdbid,
+                                           const std::string& source,
+                                           const char* format) {
+        (void)source; // Only used for benchmarking
+        try {
 #ifdef LEMON_BENCHMARK
-                    auto start = std::chrono::high_resolution_clock::now();
+            auto start = std::chrono::high_resolution_clock::now();
 #endif
-                    auto traj = chemfiles::Trajectory::memory_reader(pair.second.data(), pair.second.size(), "MMTF/GZ");
-                    auto entry = traj.read();
-                    results[th].emplace_back(
-                        worker(std::move(entry), pair.first));
+            auto traj = chemfiles::Trajectory::memory_reader(
+                value.data(), value.size(), format);
+            auto entry = traj.read();
+            auto result = worker(std::move(entry), pdbid);
 #ifdef LEMON_BENCHMARK
-                    auto stop = std::chrono::high_resolution_clock::now();
-                    auto duration =
-                        std::chrono::duration_cast<std::chrono::microseconds>(
-                            stop - start);
-                    std::cerr << it->string() + "\t" + pair.first + "\t" +
-                                     std::to_string(duration.count()) + "\n";
+            auto stop = std::chrono::high_resolution_clock::now();
+            auto duration =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    stop - start);
+            std::cerr << source + "\t" + pdbid + "\t" +
+                             std::to_string(duration.count()) + "\n";
 #endif
-                } catch (...) {
-                }
-            }
+            return results.push(std::move(result));
+        } catch (...) {
         }
+        return true;
     };
 
-    for (auto it = std::begin(threads); it != std::end(threads) - 1; ++it) {
-        *it = std::thread(call_function, work_iter, work_iter + grainsize);
-        work_iter += grainsize;
-    }
-    threads.back() = std::thread(call_function, work_iter, pathvec.end());
+    record_scheduler records(p, ncpu, entries, skip_entries);
 
-    for (auto&& i : threads) {
-        i.join();
+    auto call_function = [&](size_t index) {
+        records.process(index, call_worker);
+
+        if (--running == 0) {
+            results.close();
+        }
+    };
+
+    // The workers run as tasks of a pool, so that they can use parallel_for.
+    // The pool is destroyed first, once all tasks are complete.
+    thread_pool pool(ncpu);
+    for (size_t i = 0; i < ncpu; ++i) {
+        pool.queue_task([&call_function, i] { call_function(i); });
     }
-    for (const auto& thread_result : results) {
-        for (const auto& sub_result : thread_result.second) {
-            collector(sub_result);
+
+    try {
+        while (auto result = results.pop()) {
+            collector(*result);
         }
+    } catch (...) {
+        // Stop the workers before passing on the error of the collector
+        results.close();
+        throw;
     }
 }
 
@@ -114,63 +286,626 @@ inline void run_parallel(Function&& worker, const std::string& p,
                          Collector& collector, size_t ncpu = 1,
                          const Entries& entries = Entries(),
                          const Entries& skip_entries = Entries()) {
+    ncpu = std::max<size_t>(ncpu, 1);
     using ret = typename std::result_of<Function&(chemfiles::Frame,
                                                   const std::string&)>::type;
-    auto pathvec = read_hadoop_dir(p);
-    thread_pool threads(ncpu);
-    threaded_queue<std::list<ret>> results;
+
+    bounded_queue<ret> results(4 * ncpu);
+
+    // Returns false once the results are no longer collected
+    auto call_worker = [&worker, &results](chemfiles::span<const char> value,
+                                           const std::string& pdbid,
+                                           const std::string& source,
+                                           const char* format) {
+        (void)source; // Only used for benchmarking
+        try {
+#ifdef LEMON_BENCHMARK
+            auto start = std::chrono::high_resolution_clock::now();
+#endif
+            auto traj = chemfiles::Trajectory::memory_reader(
+                value.data(), value.size(), format);
+            auto entry = traj.read();
+            auto result = worker(std::move(entry), pdbid);
+#ifdef LEMON_BENCHMARK
+            auto stop = std::chrono::high_resolution_clock::now();
+            auto duration =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    stop - start);
+            std::cerr << source + "\t" + pdbid + "\t" +
+                             std::to_string(duration.count()) + "\n";
+#endif
+            return results.push(std::move(result));
+        } catch (...) {
+        }
+        return true;
+    };
+
+    std::unique_ptr<Pack> pack;
+    std::unique_ptr<Archive> archive;
+    if (is_pack_dir(p)) {
+        pack.reset(new Pack(p));
+    } else if (!entries.empty()) {
+        // Use the index to only touch the records which were requested
+        archive.reset(new Archive(p));
+    }
+
+    // One task per record, or per sequence file, started in order
+    std::vector<const ArchiveRecord*> records;
+    std::vector<std::string> pathvec;
+    if (pack || archive) {
+        records = pack ? pack->select(entries, skip_entries)
+                       : archive->select(entries, skip_entries);
+    } else {
+        pathvec = read_hadoop_dir(p);
+    }
+
+    std::atomic<size_t> remaining(records.size() + pathvec.size());
+    if (remaining == 0) {
+        return;
+    }
+
+    auto finish_task = [&remaining, &results] {
+        if (--remaining == 0) {
+            results.close();
+        }
+    };
+
+    thread_pool pool(ncpu);
+    for (auto record : records) {
+        pool.queue_task([record, &pack, &archive, &call_worker, &finish_task] {
+            if (pack) {
+                call_worker(pack->data(*record), record->pdbid,
+                            pack->files()[record->file], Pack::FORMAT);
+            } else {
+                call_worker(archive->data(*record), record->pdbid,
+                            archive->files()[record->file], "MMTF/GZ");
+            }
+            finish_task();
+        });
+    }
 
     for (const auto& path : pathvec) {
-        threads.queue_task([path, &results, &worker, &entries, &skip_entries] {
-            std::ifstream data(path, std::istream::binary);
-            Hadoop sequence(data);
-            std::list<ret> mini_collector;
+        pool.queue_task([&path, &skip_entries, &call_worker, &finish_task] {
+            try {
+                MappedHadoop sequence(path);
+                while (sequence.has_next()) {
+                    auto pdbid = sequence.next_key();
+                    if (skip_entries.size() &&
+                        skip_entries.count(pdbid) != 0) {
+                        sequence.skip_value();
+                        continue;
+                    }
+                    if (!call_worker(sequence.value(), pdbid, path,
+                                     "MMTF/GZ")) {
+                        break;
+                    }
+                }
+            } catch (...) {
+            }
+            finish_task();
+        });
+    }
 
-            while (sequence.has_next()) {
-                auto pair = sequence.next();
-                if (entries.size() && entries.count(pair.first) == 0) {
+    try {
+        while (auto result = results.pop()) {
+            collector(*result);
+        }
+    } catch (...) {
+        // Stop the workers before passing on the error of the collector
+        results.close();
+        throw;
+    }
+}
+
+#endif // LEMON_USE_ASYNC
+
+//! The `run_ordered` function runs a workflow and collects results in order.
+//!
+//! The results of `run_parallel` reach the `collector` in the order the
+//! threads finish them, which changes from one run to the next. This function
+//! hands the results to the `collector` sorted by PDB ID instead, so that the
+//! output of two runs, for example on two snapshots of the PDB, can be
+//! compared directly. Entries are given to the threads in PDB ID order and a
+//! `reorder_buffer` holds the results which finish early, so only a few
+//! results per thread are kept in memory. The `Archive` index is used to sort
+//! the entries of a directory of sequence files. Pack files created by
+//! `lm_pack` are already sorted by PDB ID and are read sequentially.
+//! \param worker A function object (C++11 lambda, struct the with operator()
+//!  overloaded, or std::function object) that the user wishes to apply.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
+//! \param collector A function object that handles the output of `worker`.
+//! \param [in] ncpu The number of threads to use.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+template <typename Function, typename Collector>
+inline void run_ordered(Function&& worker, const std::string& p,
+                        Collector& collector, size_t ncpu = 1,
+                        const Entries& entries = Entries(),
+                        const Entries& skip_entries = Entries()) {
+    using ret = typename std::result_of<Function&(chemfiles::Frame,
+                                                  const std::string&)>::type;
+
+    std::unique_ptr<Pack> pack;
+    std::unique_ptr<Archive> archive;
+    std::vector<const ArchiveRecord*> records;
+    const char* format = "MMTF/GZ";
+    if (is_pack_dir(p)) {
+        pack.reset(new Pack(p));
+        records = pack->select(entries, skip_entries);
+        format = Pack::FORMAT;
+    } else {
+        archive.reset(new Archive(p));
+        records = archive->select(entries, skip_entries);
+    }
+
+    // Records with the same PDB ID keep the order they have on disk
+    std::stable_sort(records.begin(), records.end(),
+                     [](const ArchiveRecord* a, const ArchiveRecord* b) {
+                         return a->pdbid < b->pdbid;
+                     });
+
+    ncpu = std::max<size_t>(ncpu, 1);
+    reorder_buffer<ret> results(4 * ncpu);
+    std::atomic<size_t> next_job(0);
+    std::atomic<size_t> running(ncpu);
+
+    auto call_function = [&] {
+        for (auto i = next_job++; i < records.size(); i = next_job++) {
+            const auto& record = *records[i];
+
+            // Entries which fail are still pushed, so later results can pass
+            chemfiles::optional<ret> result;
+            try {
+                auto value = pack ? pack->data(record) : archive->data(record);
+                auto traj = chemfiles::Trajectory::memory_reader(
+                    value.data(), value.size(), format);
+                auto entry = traj.read();
+                result = worker(std::move(entry), record.pdbid);
+            } catch (...) {
+            }
+
+            if (!results.push(i, std::move(result))) {
+                break;
+            }
+        }
+
+        if (--running == 0) {
+            results.close();
+        }
+    };
+
+    thread_pool pool(ncpu);
+    for (size_t i = 0; i < ncpu; ++i) {
+        pool.queue_task(call_function);
+    }
+
+    try {
+        while (auto result = results.pop()) {
+            collector(*result);
+        }
+    } catch (...) {
+        // Stop the workers before passing on the error of the collector
+        results.close();
+        throw;
+    }
+}
+
+//! The `run_reduce` function runs a workflow which accumulates its results.
+//!
+//! Workflows which count or bin properties of every entry, such as the
+//! geometry programs, would otherwise return a new map for each entry which is
+//! then added to the total by the collector. Here, each thread owns an
+//! accumulator and the `worker` adds the results of an entry directly to the
+//! accumulator of the thread running it. Once all entries are processed, the
+//! accumulators are merged in pairs on several threads, and the remaining one
+//! is merged into `total`.
+//! \param worker A function object which accepts a `chemfiles::Frame`, a
+//!  `std::string` with the PDB ID and a reference to the accumulator of the
+//!  thread. An exception thrown by `worker` skips the rest of the entry, but
+//!  keeps what was already added to the accumulator.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
+//! \param total The accumulator receiving the results of all threads.
+//! \param merge A function object accepting two accumulators which adds the
+//!  content of the second one to the first one.
+//! \param [in] ncpu The number of threads to use.
+//! \param [in] entries Which entries to use. Not used if blank. Otherwise,
+//!  the `Archive` index is used so that only these entries are read.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+template <typename Function, typename Accumulator, typename Merge>
+inline void run_reduce(Function&& worker, const std::string& p,
+                       Accumulator& total, Merge&& merge, size_t ncpu = 1,
+                       const Entries& entries = Entries(),
+                       const Entries& skip_entries = Entries()) {
+    ncpu = std::max<size_t>(ncpu, 1);
+    std::vector<Accumulator> accumulators(ncpu);
+    record_scheduler records(p, ncpu, entries, skip_entries);
+
+    auto call_function = [&](size_t index) {
+        records.process(index, [&](chemfiles::span<const char> value,
+                                   const std::string& pdbid,
+                                   const std::string& /*unused*/,
+                                   const char* format) {
+            try {
+                auto traj = chemfiles::Trajectory::memory_reader(
+                    value.data(), value.size(), format);
+                auto entry = traj.read();
+                worker(std::move(entry), pdbid, accumulators[index]);
+            } catch (...) {
+            }
+            return true;
+        });
+    };
+
+    thread_pool pool(ncpu);
+    std::vector<std::future<void>> tasks;
+    for (size_t i = 0; i < ncpu; ++i) {
+        tasks.push_back(pool.queue_task([&call_function, i] {
+            call_function(i);
+        }));
+    }
+
+    for (auto& task : tasks) {
+        task.get();
+    }
+
+    // Merge the accumulators in pairs, halving their number at each step
+    for (size_t step = 1; step < ncpu; step *= 2) {
+        tasks.clear();
+        for (size_t i = 0; i + step < ncpu; i += 2 * step) {
+            tasks.push_back(pool.queue_task([&accumulators, &merge, i, step] {
+                merge(accumulators[i], accumulators[i + step]);
+                accumulators[i + step] = Accumulator();
+            }));
+        }
+
+        for (auto& task : tasks) {
+            task.get();
+        }
+    }
+
+    merge(total, accumulators.front());
+}
+
+//! The number of threads used by each stage of `run_pipeline`.
+struct PipelineThreads {
+    //! Threads walking the sequence files and loading records into memory
+    size_t io = 1;
+
+    //! Threads decompressing and parsing MMTF records into frames
+    size_t decode = 1;
+
+    //! Threads running the workflow
+    size_t worker = 1;
+
+    //! Maximum number of records waiting between two stages. Zero uses twice
+    //! the number of threads of the following stage, and four results per
+    //! worker thread for the results waiting for the collector.
+    size_t queue_size = 0;
+};
+
+//! A parsed entry passed from the decode stage to the worker stage.
+using pipeline_frame = std::pair<std::string, chemfiles::Frame>;
+
+//! The `run_stages` function runs the stages of `run_pipeline`.
+//!
+//! The records are read and parsed into `pipeline_frame`s by the first two
+//! stages, which push them to the `frames` queue. Each thread of the worker
+//! stage calls `stage(frames, results)`, which must pop frames until the queue
+//! is closed and push the results of the workflow to `results`. The
+//! `collector` is called on the calling thread for every result. Records which
+//! cannot be read or parsed are reported with `report_read_error` and skipped.
+//! \param stage A function object running the worker stage of one thread.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
+//! \param collector A function object that handles the results.
+//! \param [in] threads The number of threads used by each stage.
+//! \param [in] frames_size Maximum number of frames waiting for the worker
+//!  stage. Zero uses `threads.queue_size`, or twice the number of worker
+//!  threads.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+template <typename Result, typename Stage, typename Collector>
+inline void run_stages(Stage&& stage, const std::string& p,
+                       Collector& collector, PipelineThreads threads,
+                       size_t frames_size = 0,
+                       const Entries& entries = Entries(),
+                       const Entries& skip_entries = Entries()) {
+    using record = std::pair<std::string, chemfiles::span<const char>>;
+
+    threads.io = std::max<size_t>(threads.io, 1);
+    threads.decode = std::max<size_t>(threads.decode, 1);
+    threads.worker = std::max<size_t>(threads.worker, 1);
+
+    if (frames_size == 0) {
+        frames_size = threads.queue_size != 0 ? threads.queue_size
+                                              : 2 * threads.worker;
+    }
+
+    bounded_queue<record> records(threads.queue_size != 0 ?
+                                  threads.queue_size : 2 * threads.decode);
+    bounded_queue<pipeline_frame> frames(frames_size);
+
+    // The last thread of a stage to finish closes the queue it feeds
+    std::atomic<size_t> io_running(threads.io);
+    std::atomic<size_t> decode_running(threads.decode);
+
+    // Records are loaded into memory by the I/O stage so that the decode
+    // stage does not wait on the disk.
+    auto touch = [](chemfiles::span<const char> value) {
+        const size_t page = 4096;
+        volatile char sink = 0;
+        for (size_t i = 0; i < value.size(); i += page) {
+            sink = static_cast<char>(sink ^ value[i]);
+        }
+    };
+
+    std::unique_ptr<Pack> pack;
+    std::unique_ptr<Archive> archive;
+    std::vector<const ArchiveRecord*> selected;
+    std::vector<std::string> pathvec;
+    std::vector<std::unique_ptr<MappedHadoop>> sequences;
+    std::atomic<size_t> next_job(0);
+
+    const char* format = "MMTF/GZ";
+    if (is_pack_dir(p)) {
+        pack.reset(new Pack(p));
+        selected = pack->select(entries, skip_entries);
+        format = Pack::FORMAT;
+    } else if (!entries.empty()) {
+        // Use the index to only touch the records which were requested
+        archive.reset(new Archive(p));
+        selected = archive->select(entries, skip_entries);
+    }
+
+    std::function<void()> io_stage;
+    if (pack || archive) {
+        io_stage = [&] {
+            for (auto i = next_job++; i < selected.size(); i = next_job++) {
+                chemfiles::span<const char> value;
+                try {
+                    value = pack ? pack->data(*selected[i])
+                                 : archive->data(*selected[i]);
+                } catch (...) {
+                    report_read_error(selected[i]->pdbid);
                     continue;
                 }
-                if (skip_entries.size() &&
-                    skip_entries.count(pair.first) != 0) {
-                    continue;
+
+                touch(value);
+                if (!records.push({selected[i]->pdbid, value})) {
+                    return;
                 }
+            }
+        };
+    } else {
+        pathvec = read_hadoop_dir(p);
+        sequences.resize(pathvec.size());
+
+        io_stage = [&] {
+            for (auto i = next_job++; i < pathvec.size(); i = next_job++) {
                 try {
-#ifdef LEMON_BENCHMARK
-                    auto start = std::chrono::high_resolution_clock::now();
-#endif
-                    auto traj = chemfiles::Trajectory::memory_reader(pair.second.data(), pair.second.size(), "MMTF/GZ");
-                    auto entry = traj.read();
-                    mini_collector.emplace_back(
-                        worker(std::move(entry), pair.first));
-#ifdef LEMON_BENCHMARK
-                    auto stop = std::chrono::high_resolution_clock::now();
-                    auto duration =
-                        std::chrono::duration_cast<std::chrono::microseconds>(
-                            stop - start);
-                    std::cerr << path.string() + "\t" + pair.first + "\t" +
-                                     std::to_string(duration.count()) + "\n";
-#endif
+                    // Kept alive until the end, as the records are views
+                    sequences[i].reset(new MappedHadoop(pathvec[i]));
+                    auto& sequence = *sequences[i];
+
+                    while (sequence.has_next()) {
+                        auto pdbid = sequence.next_key();
+                        if (skip_entries.size() &&
+                            skip_entries.count(pdbid) != 0) {
+                            sequence.skip_value();
+                            continue;
+                        }
+
+                        auto value = sequence.value();
+                        touch(value);
+                        if (!records.push({std::move(pdbid), value})) {
+                            return;
+                        }
+                    }
                 } catch (...) {
+                    report_read_error(pathvec[i]);
                 }
             }
+        };
+    }
+
+    auto decode_stage = [&] {
+        while (auto item = records.pop()) {
+            chemfiles::Frame frame;
+            try {
+                auto traj = chemfiles::Trajectory::memory_reader(
+                    item->second.data(), item->second.size(), format);
+                frame = traj.read();
+            } catch (...) {
+                report_read_error(item->first);
+                continue;
+            }
 
-            results.push_back(std::move(mini_collector));
+            // The frames are no longer used by the workers
+            if (!frames.push({std::move(item->first), std::move(frame)})) {
+                records.close();
+                break;
+            }
+        }
+
+        if (--decode_running == 0) {
+            frames.close();
+        }
+    };
+
+    // Results are handed to the collector on the calling thread while the
+    // stages run
+    bounded_queue<Result> results(threads.queue_size != 0 ?
+                                  threads.queue_size : 4 * threads.worker);
+    std::atomic<size_t> worker_running(threads.worker);
+
+    auto worker_stage = [&] {
+        try {
+            stage(frames, results);
+        } catch (...) {
+        }
+
+        if (--worker_running == 0) {
+            results.close();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads.io; ++i) {
+        pool.emplace_back([&] {
+            try {
+                io_stage();
+            } catch (...) {
+                report_read_error(p);
+            }
+
+            if (--io_running == 0) {
+                records.close();
+            }
         });
     }
 
-    std::size_t tasks_complete = 0;
-    while (auto result = results.pop_front()) {
-        for (auto sub_result : *result)
-            collector(sub_result);
-        ++tasks_complete;
-        if (tasks_complete == pathvec.size()) {
-            break;
+    for (size_t i = 0; i < threads.decode; ++i) {
+        pool.emplace_back(decode_stage);
+    }
+
+    for (size_t i = 0; i < threads.worker; ++i) {
+        pool.emplace_back(worker_stage);
+    }
+
+    try {
+        while (auto result = results.pop()) {
+            collector(*result);
+        }
+    } catch (...) {
+        // Stop all stages before passing on the error of the collector
+        records.close();
+        frames.close();
+        results.close();
+        for (auto&& i : pool) {
+            i.join();
         }
+        throw;
+    }
+
+    for (auto&& i : pool) {
+        i.join();
     }
 }
 
-#endif // LEMON_USE_ASYNC
+
+//! The `run_pipeline` function runs a workflow as a pipeline of stages.
+//!
+//! Unlike `run_parallel`, where each thread reads, parses and runs the
+//! `worker` on a record before moving to the next one, this function splits
+//! the work into three stages connected by bounded queues. The first stage
+//! reads records from the sequence files, the second decompresses and parses
+//! them into `chemfiles::Frame`s and the third runs the `worker`. Each stage
+//! has its own number of threads, so that workflows dominated by parsing and
+//! workflows dominated by the `worker` can both use all cores. The bounded
+//! queues keep the number of parsed frames in memory small. As with
+//! `run_parallel`, the `collector` is called on the calling thread while the
+//! stages run.
+//! \param worker A function object (C++11 lambda, struct the with operator()
+//!  overloaded, or std::function object) that the user wishes to apply.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
+//! \param collector A function object that handles the output of `worker`.
+//! \param [in] threads The number of threads used by each stage.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+template <typename Function, typename Collector>
+inline void run_pipeline(Function&& worker, const std::string& p,
+                         Collector& collector, PipelineThreads threads,
+                         const Entries& entries = Entries(),
+                         const Entries& skip_entries = Entries()) {
+    using ret = typename std::result_of<Function&(chemfiles::Frame,
+                                                  const std::string&)>::type;
+
+    auto stage = [&worker](bounded_queue<pipeline_frame>& frames,
+                           bounded_queue<ret>& results) {
+        while (auto item = frames.pop()) {
+            try {
+                auto result = worker(std::move(item->second), item->first);
+                if (!results.push(std::move(result))) {
+                    return;
+                }
+            } catch (...) {
+            }
+        }
+    };
+
+    run_stages<ret>(stage, p, collector, threads, 0, entries, skip_entries);
+}
+
+//! The `run_batches` function runs a workflow on batches of entries.
+//!
+//! This function works as `run_pipeline`, but the `worker` is called with up
+//! to `batch` parsed entries at once. While a worker thread runs `worker` on a
+//! batch, the decode stage parses the entries of the next batches. Use this
+//! function when each call of the `worker` has a large fixed cost, such as a
+//! call into Python. Only the last batch of a worker thread may have fewer than
+//! `batch` entries.
+//! \param worker A function object accepting a `std::vector` of
+//!  `chemfiles::Frame`s and a `std::vector` of the matching PDB IDs.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
+//! \param collector A function object that handles the output of `worker`,
+//!  called once per batch.
+//! \param [in] threads The number of threads used by each stage.
+//! \param [in] batch The maximum number of entries passed to `worker`.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+template <typename Function, typename Collector>
+inline void run_batches(Function&& worker, const std::string& p,
+                        Collector& collector, PipelineThreads threads,
+                        size_t batch, const Entries& entries = Entries(),
+                        const Entries& skip_entries = Entries()) {
+    using ret = typename std::result_of<Function&(
+        std::vector<chemfiles::Frame>, const std::vector<std::string>&)>::type;
+
+    batch = std::max<size_t>(batch, 1);
+    threads.worker = std::max<size_t>(threads.worker, 1);
+
+    auto stage = [&worker, batch](bounded_queue<pipeline_frame>& frames,
+                                  bounded_queue<ret>& results) {
+        auto open = true;
+        while (open) {
+            std::vector<chemfiles::Frame> parsed;
+            std::vector<std::string> pdbids;
+            while (parsed.size() < batch) {
+                auto item = frames.pop();
+                if (!item) {
+                    open = false;
+                    break;
+                }
+                parsed.push_back(std::move(item->second));
+                pdbids.push_back(std::move(item->first));
+            }
+
+            if (parsed.empty()) {
+                return;
+            }
+
+            try {
+                auto result = worker(std::move(parsed), pdbids);
+                if (!results.push(std::move(result))) {
+                    return;
+                }
+            } catch (...) {
+            }
+        }
+    };
+
+    // Enough parsed frames for the next batch of every worker thread
+    auto frames_size = threads.queue_size != 0
+                           ? std::max(threads.queue_size, batch)
+                           : 2 * batch * threads.worker;
+
+    run_stages<ret>(stage, p, collector, threads, frames_size, entries,
+                    skip_entries);
+}
 
 } // namespace lemon
 #endif
@@ -0,0 +1,302 @@
+#ifndef LEMON_PROCESSES_HPP
+#define LEMON_PROCESSES_HPP
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lemon/archive.hpp"
+#include "lemon/entries.hpp"
+#include "lemon/pack.hpp"
+#include "lemon/parallel.hpp"
+
+namespace lemon {
+
+//! Functions called around the worker processes of `run_processes`.
+//!
+//! Libraries keeping a global state, such as the Python interpreter, must
+//! prepare for `fork` and repair their state in the new process.
+struct ProcessHooks {
+    //! Called in the parent process before each `fork`
+    std::function<void()> before_fork;
+
+    //! Called in the parent process after each `fork`
+    std::function<void()> after_fork_parent;
+
+    //! Called in the worker process after the `fork`
+    std::function<void()> after_fork_child;
+
+    //! Called in the worker process once all its entries are processed
+    std::function<void()> finish;
+};
+
+namespace processes {
+
+//! Write all of `size` bytes to the file descriptor `fd`.
+inline bool write_all(int fd, const char* data, size_t size) {
+    while (size != 0) {
+        auto written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+//! Write a result as its size followed by its content.
+inline bool write_message(int fd, const std::string& message) {
+    auto size = static_cast<uint64_t>(message.size());
+    return write_all(fd, reinterpret_cast<const char*>(&size), sizeof(size)) &&
+           write_all(fd, message.data(), message.size());
+}
+
+//! Pass the complete messages at the start of `buffer` to `collector`.
+template <typename Collector>
+inline void read_messages(std::string& buffer, Collector& collector) {
+    size_t position = 0;
+    while (buffer.size() - position >= sizeof(uint64_t)) {
+        uint64_t size;
+        std::memcpy(&size, buffer.data() + position, sizeof(size));
+        if (buffer.size() - position - sizeof(size) < size) {
+            break;
+        }
+
+        position += sizeof(size);
+        collector(buffer.substr(position, static_cast<size_t>(size)));
+        position += static_cast<size_t>(size);
+    }
+    buffer.erase(0, position);
+}
+
+} // namespace processes
+
+//! The `run_processes` function runs a workflow in several processes.
+//!
+//! Use this function instead of `run_parallel` when the `worker` cannot run on
+//! several threads at once, for example because it is written in Python and
+//! holds the global interpreter lock. The calling process forks `nprocs`
+//! worker processes. Each of them runs `worker` on its share of the sequence
+//! files, or of the records of the pack files, and sends the results back to
+//! the calling process through a pipe, where `collector` receives them as they
+//! arrive. The `worker` must therefore return a `std::string`. Each worker
+//! process has its own copy of the state of the calling process: changes made
+//! by `worker` to this state are not seen by the calling process. This
+//! function is not available on Windows.
+//! \param worker A function object (C++11 lambda, struct the with operator()
+//!  overloaded, or std::function object) that the user wishes to apply.
+//! \param [in] p A path to the Hadoop sequence file directory, or to a
+//!  directory of pack files created by `lm_pack`.
+//! \param collector A function object that handles the output of `worker`.
+//! \param [in] nprocs The number of worker processes.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+//! \param [in] hooks Functions called around the `fork` of each process.
+//! \throws std::runtime_error if a worker process cannot be started or fails.
+template <typename Function, typename Collector>
+inline void run_processes(Function&& worker, const std::string& p,
+                          Collector& collector, size_t nprocs = 1,
+                          const Entries& entries = Entries(),
+                          const Entries& skip_entries = Entries(),
+                          const ProcessHooks& hooks = ProcessHooks()) {
+    using ret = typename std::result_of<Function&(chemfiles::Frame,
+                                                  const std::string&)>::type;
+    static_assert(std::is_same<typename std::decay<ret>::type,
+                               std::string>::value,
+                  "The worker of run_processes must return a std::string");
+
+    nprocs = std::max<size_t>(nprocs, 1);
+
+    // Create the index once, instead of in every process
+    if (!entries.empty() && !is_pack_dir(p)) {
+        Archive archive(p);
+    }
+
+    std::vector<pid_t> children;
+    std::vector<int> readers;
+
+    auto stop_children = [&children, &readers] {
+        for (auto pid : children) {
+            ::kill(pid, SIGTERM);
+        }
+        for (auto fd : readers) {
+            if (fd != -1) {
+                ::close(fd);
+            }
+        }
+        for (auto pid : children) {
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+        }
+    };
+
+    for (size_t part = 0; part < nprocs; ++part) {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            stop_children();
+            throw std::runtime_error("Could not create a pipe: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        // Otherwise, the buffered output would be written by every process
+        std::cout.flush();
+        if (hooks.before_fork) {
+            hooks.before_fork();
+        }
+
+        auto pid = ::fork();
+        if (pid == 0) {
+            ::close(fds[0]);
+            for (auto fd : readers) {
+                ::close(fd);
+            }
+
+            int status = 0;
+            try {
+                if (hooks.after_fork_child) {
+                    hooks.after_fork_child();
+                }
+
+                record_scheduler records(p, 1, entries, skip_entries, part,
+                                         nprocs);
+                records.process(0, [&](chemfiles::span<const char> value,
+                                       const std::string& pdbid,
+                                       const std::string& /*unused*/,
+                                       const char* format) {
+                    std::string result;
+                    try {
+                        auto traj = chemfiles::Trajectory::memory_reader(
+                            value.data(), value.size(), format);
+                        auto entry = traj.read();
+                        result = worker(std::move(entry), pdbid);
+                    } catch (...) {
+                        return true;
+                    }
+                    return processes::write_message(fds[1], result);
+                });
+
+                if (hooks.finish) {
+                    hooks.finish();
+                }
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+                status = 1;
+            } catch (...) {
+                status = 1;
+            }
+
+            ::close(fds[1]);
+            std::cout.flush();
+            std::cerr.flush();
+
+            // Skip the destructors and exit handlers of the parent
+            ::_exit(status);
+        }
+
+        if (hooks.after_fork_parent) {
+            hooks.after_fork_parent();
+        }
+
+        ::close(fds[1]);
+        if (pid < 0) {
+            ::close(fds[0]);
+            stop_children();
+            throw std::runtime_error("Could not start a worker process: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        children.push_back(pid);
+        readers.push_back(fds[0]);
+    }
+
+    try {
+        std::vector<std::string> buffers(readers.size());
+        std::vector<char> chunk(1 << 16);
+        auto open = readers.size();
+
+        while (open != 0) {
+            std::vector<pollfd> polled;
+            std::vector<size_t> owners;
+            for (size_t i = 0; i < readers.size(); ++i) {
+                if (readers[i] != -1) {
+                    polled.push_back({readers[i], POLLIN, 0});
+                    owners.push_back(i);
+                }
+            }
+
+            if (::poll(polled.data(), polled.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Could not read from the workers: " +
+                                         std::string(std::strerror(errno)));
+            }
+
+            for (size_t j = 0; j < polled.size(); ++j) {
+                if (polled[j].revents == 0) {
+                    continue;
+                }
+
+                auto i = owners[j];
+                auto count = ::read(readers[i], chunk.data(), chunk.size());
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+
+                if (count <= 0) {
+                    ::close(readers[i]);
+                    readers[i] = -1;
+                    --open;
+                    continue;
+                }
+
+                buffers[i].append(chunk.data(), static_cast<size_t>(count));
+                processes::read_messages(buffers[i], collector);
+            }
+        }
+    } catch (...) {
+        stop_children();
+        throw;
+    }
+
+    bool failed = false;
+    for (auto pid : children) {
+        int status = 0;
+        auto waited = ::waitpid(pid, &status, 0);
+        while (waited < 0 && errno == EINTR) {
+            waited = ::waitpid(pid, &status, 0);
+        }
+        if (waited < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = true;
+        }
+    }
+
+    if (failed) {
+        throw std::runtime_error("A worker process failed");
+    }
+}
+
+} // namespace lemon
+
+#endif // _WIN32
+
+#endif
@@ -3,8 +3,13 @@
 
 #include <algorithm>
 #include <list>
+#include <vector>
 
+#include "lemon/atom_grid.hpp"
+#include "lemon/frame_index.hpp"
+#include "lemon/frame_view.hpp"
 #include "lemon/residue_name.hpp"
+#include "lemon/selection.hpp"
 
 #include "lemon/external/gaurd.hpp"
 
@@ -42,16 +47,51 @@ inline Container identical_residues(const chemfiles::Frame& frame,
 
     auto assembly = residues[*residue_ids.begin()].get("assembly");
 
-    residue_ids.erase(
-        std::remove_if(residue_ids.begin(), residue_ids.end(),
-            [&residues, assembly](size_t current_id) {
-                auto& residue = residues[current_id];
-                auto prop = residue.get("assembly");
+    remove_residues_if(residue_ids,
+        [&residues, assembly](size_t current_id) {
+            auto& residue = residues[current_id];
+            auto prop = residue.get("assembly");
 
-                return prop != assembly;
-            }
-        ),
-    residue_ids.end());
+            return prop != assembly;
+        });
+
+    return residue_ids;
+}
+
+//! Remove residues which are biologic copies of one another in a `FrameView`
+template <typename Container>
+inline Container identical_residues(const FrameView& frame,
+                                    Container& residue_ids) {
+    if (residue_ids.empty()) {
+        return residue_ids;
+    }
+
+    auto assembly = frame.residue(*residue_ids.begin()).assembly();
+
+    remove_residues_if(residue_ids,
+        [&frame, &assembly](size_t current_id) {
+            return frame.residue(current_id).assembly() != assembly;
+        });
+
+    return residue_ids;
+}
+
+//! Remove residues which are biologic copies of one another, using the
+//! assemblies stored in a `FrameIndex`
+template <typename Container>
+inline Container identical_residues(const FrameIndex& index,
+                                    Container& residue_ids) {
+    if (residue_ids.empty()) {
+        return residue_ids;
+    }
+
+    const auto& assemblies = index.tables().assemblies();
+    auto assembly = assemblies[*residue_ids.begin()];
+
+    remove_residues_if(residue_ids,
+        [&assemblies, assembly](size_t current_id) {
+            return assemblies[current_id] != assembly;
+        });
 
     return residue_ids;
 }
@@ -71,14 +111,22 @@ inline Container cofactors(const chemfiles::Frame& frame, Container& residue_ids
                            const ResidueNameSet& rns) {
     auto& residues = frame.topology().residues();
 
-    // In C++-17 there's a better version called std::erase_if
-    residue_ids.erase(
-        std::remove_if(residue_ids.begin(), residue_ids.end(),
-                       [&residues, &rns](size_t current) {
-                           return rns.count(residues[current].name()) != 0;
-                       }),
-        residue_ids.end()
-    );
+    remove_residues_if(residue_ids,
+        [&residues, &rns](size_t current) {
+            return rns.count(residues[current].name()) != 0;
+        });
+
+    return residue_ids;
+}
+
+//! Remove residues which are common cofactors from a `FrameView`
+template <typename Container>
+inline Container cofactors(const FrameView& frame, Container& residue_ids,
+                           const ResidueNameSet& rns) {
+    remove_residues_if(residue_ids,
+        [&frame, &rns](size_t current) {
+            return rns.count(frame.residue(current).name()) != 0;
+        });
 
     return residue_ids;
 }
@@ -89,31 +137,117 @@ inline Container1 interactions(const chemfiles::Frame& frame,
                               const Container2& interaction_ids,
                               double distance_cutoff = DEFAULT_DISTANCE,
                               bool keep = true) {
+    // The atoms of the interaction residues, in a grid so that only the atoms
+    // near a residue are checked
+    std::vector<size_t> atoms;
+    for (auto residue_to_check : interaction_ids) {
+        const auto& residue = frame.topology().residues()[residue_to_check];
+        atoms.insert(atoms.end(), residue.begin(), residue.end());
+    }
+
+    AtomGrid grid;
+    if (distance_cutoff > 0 && !atoms.empty()) {
+        grid = AtomGrid(frame, atoms, distance_cutoff);
+    }
+
+    remove_residues_if(residue_ids,
+        [&](size_t current) {
+            for (auto lig_atom : frame.topology().residues()[current]) {
+                if (atoms.empty()) {
+                    break;
+                }
+
+                if (distance_cutoff <= 0 ||
+                    grid.any_within(frame, lig_atom, distance_cutoff)) {
+                    return !keep;
+                }
+            }
+
+            return keep;
+        });
+
+    return residue_ids;
+}
+
+template <typename Container1, typename Container2 = Container1>
+inline Container1 interactions(const FrameView& frame,
+                              Container1& residue_ids,
+                              const Container2& interaction_ids,
+                              double distance_cutoff = DEFAULT_DISTANCE,
+                              bool keep = true) {
+    // The atoms of the interaction residues, in a grid so that only the atoms
+    // near a residue are checked
+    std::vector<size_t> atoms;
+    for (auto residue_to_check : interaction_ids) {
+        auto residue = frame.residue(residue_to_check);
+        atoms.insert(atoms.end(), residue.begin(), residue.end());
+    }
+
+    AtomGrid grid;
+    if (distance_cutoff > 0 && !atoms.empty()) {
+        grid = AtomGrid(frame, atoms, distance_cutoff);
+    }
+
+    remove_residues_if(residue_ids,
+        [&](size_t current) {
+            for (auto lig_atom : frame.residue(current)) {
+                if (atoms.empty()) {
+                    break;
+                }
+
+                if (distance_cutoff <= 0 ||
+                    grid.any_within(frame, lig_atom, distance_cutoff)) {
+                    return !keep;
+                }
+            }
+
+            return keep;
+        });
+
+    return residue_ids;
+}
+
+template <typename Container1, typename Container2 = Container1>
+inline Container1 interactions(const FrameIndex& index,
+                              Container1& residue_ids,
+                              const Container2& interaction_ids,
+                              double distance_cutoff = DEFAULT_DISTANCE,
+                              bool keep = true) {
+    const auto& frame = index.frame();
     const auto& residues = frame.topology().residues();
 
-    residue_ids.erase(
-        std::remove_if(residue_ids.begin(), residue_ids.end(),
-            [&](size_t current) {
-                const auto& ligand_residue = residues[current];
-            
-                for (auto residue_to_check : interaction_ids) {
-                    const auto& residue = residues[residue_to_check];
-            
-                    for (auto prot_atom : residue) {
-                        for (auto lig_atom : ligand_residue) {
-                            if (distance_cutoff <= 0 || 
-                                frame.distance(prot_atom, lig_atom) <
-                                distance_cutoff) {
-                                return !keep;
-                            }
-                        }
-                    }
+    // The grid of the index contains all atoms, only the atoms of the
+    // interaction residues are checked
+    std::vector<char> targets(index.residue_count() + 1, 0);
+    bool any_atom = false;
+    for (auto residue_to_check : interaction_ids) {
+        targets[residue_to_check] = 1;
+        any_atom = any_atom || residues[residue_to_check].size() != 0;
+    }
+
+    const auto& residue_of = index.tables().residue_of();
+    auto near = [&](size_t lig_atom) {
+        return index.neighbors(lig_atom, distance_cutoff,
+            [&](size_t prot_atom) {
+                return targets[residue_of[prot_atom]] != 0 &&
+                       frame.distance(prot_atom, lig_atom) < distance_cutoff;
+            });
+    };
+
+    remove_residues_if(residue_ids,
+        [&](size_t current) {
+            for (auto lig_atom : residues[current]) {
+                if (!any_atom) {
+                    break;
+                }
+
+                if (distance_cutoff <= 0 || near(lig_atom)) {
+                    return !keep;
                 }
-            
-                return keep;
-            }),
-        residue_ids.end()
-    );
+            }
+
+            return keep;
+        });
 
     return residue_ids;
 }
@@ -138,6 +272,26 @@ inline Container1 keep_interactions(const chemfiles::Frame& frame,
     return interactions(frame, residue_ids, interaction_ids, distance_cutoff, true);
 }
 
+//! Remove residues which do **not** interact with other residues of a
+//! `FrameView`
+template <typename Container1, typename Container2 = Container1>
+inline Container1 keep_interactions(const FrameView& frame,
+                                    Container1& residue_ids,
+                                    const Container2& interaction_ids,
+                                    double distance_cutoff = DEFAULT_DISTANCE) {
+    return interactions(frame, residue_ids, interaction_ids, distance_cutoff, true);
+}
+
+//! Remove residues which do **not** interact with other residues, using the
+//! grid of atoms stored in a `FrameIndex`
+template <typename Container1, typename Container2 = Container1>
+inline Container1 keep_interactions(const FrameIndex& index,
+                                    Container1& residue_ids,
+                                    const Container2& interaction_ids,
+                                    double distance_cutoff = DEFAULT_DISTANCE) {
+    return interactions(index, residue_ids, interaction_ids, distance_cutoff, true);
+}
+
 //! Remove residues which **do interact** with a given set of other residues
 //!
 //! This function is designed to remove residues which have a undesirable
@@ -158,6 +312,25 @@ inline Container1 remove_interactions(const chemfiles::Frame& frame,
     return interactions(frame, residue_ids, interaction_ids, distance_cutoff, false);
 }
 
+//! Remove residues which **do interact** with other residues of a `FrameView`
+template <typename Container1, typename Container2 = Container1>
+inline Container1 remove_interactions(const FrameView& frame,
+                                      Container1& residue_ids,
+                                      const Container2& interaction_ids,
+                                      double distance_cutoff = DEFAULT_DISTANCE) {
+    return interactions(frame, residue_ids, interaction_ids, distance_cutoff, false);
+}
+
+//! Remove residues which **do interact** with other residues, using the grid
+//! of atoms stored in a `FrameIndex`
+template <typename Container1, typename Container2 = Container1>
+inline Container1 remove_interactions(const FrameIndex& index,
+                                      Container1& residue_ids,
+                                      const Container2& interaction_ids,
+                                      double distance_cutoff = DEFAULT_DISTANCE) {
+    return interactions(index, residue_ids, interaction_ids, distance_cutoff, false);
+}
+
 //! Turns `residue_ids` in to intersection between it and `intersection_ids`
 //!
 //! This function is designed to keep residues which have a desirable
@@ -168,20 +341,44 @@ inline Container1 remove_interactions(const chemfiles::Frame& frame,
 template <typename Container1, typename Container2 = Container1>
 inline Container1 intersection(Container1& residue_ids,
                                const Container2& intersection_ids) {
+    // Only the indexes up to the largest one of `residue_ids` are looked up
+    size_t largest = 0;
+    for (auto current : residue_ids) {
+        largest = std::max(largest, static_cast<size_t>(current));
+    }
 
-    // ugly O(n*m), but gets the job done. Ideally one should use sets though.
-    residue_ids.erase(
-        std::remove_if(residue_ids.begin(), residue_ids.end(),
-            [&intersection_ids](size_t current){
-                for (auto& i : intersection_ids){
-                    if (i == current) {
-                        return false;
-                    }
-                }
-                return true;
-        }), residue_ids.end()
-    );
+    // A bitset unless the indexes are much larger than the containers
+    if (largest / 64 <= residue_ids.size() + intersection_ids.size()) {
+        Selection kept(largest + 1);
+        for (auto index : intersection_ids) {
+            if (static_cast<size_t>(index) <= largest) {
+                kept.insert(static_cast<size_t>(index));
+            }
+        }
+        remove_residues_if(residue_ids, [&kept](size_t current) {
+            return !kept.contains(current);
+        });
+        return residue_ids;
+    }
+
+    std::vector<size_t> kept;
+    kept.reserve(intersection_ids.size());
+    for (auto index : intersection_ids) {
+        kept.push_back(static_cast<size_t>(index));
+    }
+    std::sort(kept.begin(), kept.end());
+    remove_residues_if(residue_ids, [&kept](size_t current) {
+        return !std::binary_search(kept.begin(), kept.end(), current);
+    });
+
+    return residue_ids;
+}
 
+//! Turns `residue_ids` in to its intersection with `intersection_ids`, one
+//! word of 64 residues at a time
+inline Selection intersection(Selection& residue_ids,
+                              const Selection& intersection_ids) {
+    residue_ids &= intersection_ids;
     return residue_ids;
 }
 
@@ -198,18 +395,16 @@ inline Container has_property(const chemfiles::Frame& frame,
                                const std::string& property_name,
                                const chemfiles::Property& property) {
 
-    residue_ids.erase(
-        std::remove_if(residue_ids.begin(), residue_ids.end(),
-            [&frame, &property_name, &property](size_t current){
-                auto& residue = frame.topology().residues()[current];
-                auto prop = residue.get(property_name);
-                if (!prop) {
-                    return true;
-                }
+    remove_residues_if(residue_ids,
+        [&frame, &property_name, &property](size_t current){
+            auto& residue = frame.topology().residues()[current];
+            auto prop = residue.get(property_name);
+            if (!prop) {
+                return true;
+            }
 
-                return *prop != property;
-        }), residue_ids.end()
-    );
+            return *prop != property;
+        });
 
     return residue_ids;
 }
@@ -0,0 +1,444 @@
+#ifndef LEMON_QUERY_HPP
+#define LEMON_QUERY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "lemon/constants.hpp"
+#include "lemon/frame_index.hpp"
+#include "lemon/prune.hpp"
+#include "lemon/residue_name.hpp"
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/Frame.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! Residue filters combined by a `Query`
+//!
+//! A filter is called once per residue, in increasing order, with the frame
+//! or index and the residue, and returns true to keep the residue. Its
+//! `prepare` function is called before the first residue, so that it can read
+//! what it needs from the frame once. Filters refer to their sets of names and
+//! types, which are not copied.
+namespace filter {
+
+//! Keep all residues
+struct All {
+    template <typename Source> void prepare(const Source& /*unused*/) {}
+
+    template <typename Source>
+    bool operator()(const Source& /*unused*/, size_t /*unused*/) {
+        return true;
+    }
+};
+
+//! Keep the residues kept by both filters. `second` is only called with the
+//! residues kept by `first`.
+template <typename First, typename Second> class Both {
+  public:
+    Both(First first, Second second)
+        : first_(std::move(first)), second_(std::move(second)) {}
+
+    template <typename Source> void prepare(const Source& source) {
+        first_.prepare(source);
+        second_.prepare(source);
+    }
+
+    template <typename Source>
+    bool operator()(const Source& source, size_t residue) {
+        return first_(source, residue) && second_(source, residue);
+    }
+
+  private:
+    First first_;
+    Second second_;
+};
+
+//! Keep small molecules, as `select::small_molecules`
+class SmallMolecules {
+  public:
+    SmallMolecules(const std::unordered_set<std::string>& types,
+                   size_t min_heavy_atoms)
+        : types_(&types), min_heavy_atoms_(min_heavy_atoms) {}
+
+    void prepare(const chemfiles::Frame& /*unused*/) {}
+
+    void prepare(const FrameIndex& index) {
+        accepted_ = index.tables().matching(*types_);
+    }
+
+    bool operator()(const chemfiles::Frame& frame, size_t residue_id) {
+        using chemfiles::Property;
+        const auto& residue = frame.topology().residues()[residue_id];
+
+        // Quick check, filters out many ions and small molecules before more
+        // expensive checks.
+        if (residue.size() < min_heavy_atoms_) {
+            return false;
+        }
+
+        auto composition_type =
+            residue.get<Property::STRING>("composition_type").value_or("");
+
+        if (!types_->count(composition_type)) {
+            return false;
+        }
+
+        size_t num_heavy_atoms = 0;
+        for (auto index : residue) {
+            num_heavy_atoms += *(frame[index].atomic_number()) != 1;
+        }
+
+        return num_heavy_atoms >= min_heavy_atoms_;
+    }
+
+    bool operator()(const FrameIndex& index, size_t residue) {
+        const auto& tables = index.tables();
+        return tables.atom_counts()[residue] >= min_heavy_atoms_ &&
+               tables.heavy_atoms()[residue] >= min_heavy_atoms_ &&
+               accepted_[tables.composition_types()[residue]] != 0;
+    }
+
+  private:
+    const std::unordered_set<std::string>* types_;
+    size_t min_heavy_atoms_;
+    std::vector<char> accepted_;
+};
+
+//! Keep peptide residues, as `select::peptides`
+struct Peptides {
+    template <typename Source> void prepare(const Source& /*unused*/) {}
+
+    bool operator()(const chemfiles::Frame& frame, size_t residue) {
+        using chemfiles::Property;
+        auto comp_type = frame.topology()
+                             .residues()[residue]
+                             .get<Property::STRING>("composition_type")
+                             .value_or("");
+
+        return comp_type.find("PEPTIDE") != std::string::npos &&
+               comp_type != "PEPTIDE-LIKE";
+    }
+
+    bool operator()(const FrameIndex& index, size_t residue) {
+        return index.kind(residue) == FrameTables::PEPTIDE;
+    }
+};
+
+//! Keep nucleic acid residues, as `select::nucleic_acids`
+struct NucleicAcids {
+    template <typename Source> void prepare(const Source& /*unused*/) {}
+
+    bool operator()(const chemfiles::Frame& frame, size_t residue) {
+        using chemfiles::Property;
+        auto comp_type = frame.topology()
+                             .residues()[residue]
+                             .get<Property::STRING>("composition_type")
+                             .value_or("");
+
+        return comp_type.find("DNA") != std::string::npos ||
+               comp_type.find("RNA") != std::string::npos;
+    }
+
+    bool operator()(const FrameIndex& index, size_t residue) {
+        return index.kind(residue) == FrameTables::NUCLEIC_ACID;
+    }
+};
+
+//! Keep the residues whose name is in a set, or the residues whose name is
+//! not in the set if `keep` is false
+class Names {
+  public:
+    Names(const ResidueNameSet& names, bool keep)
+        : names_(&names), keep_(keep) {}
+
+    void prepare(const chemfiles::Frame& /*unused*/) {}
+
+    void prepare(const FrameIndex& index) {
+        matching_ = index.tables().matching_names(*names_);
+    }
+
+    bool operator()(const chemfiles::Frame& frame, size_t residue) {
+        return names_->contains(
+                   frame.topology().residues()[residue].name()) == keep_;
+    }
+
+    bool operator()(const FrameIndex& index, size_t residue) {
+        return (matching_[index.tables().names()[residue]] != 0) == keep_;
+    }
+
+  private:
+    const ResidueNameSet* names_;
+    bool keep_;
+    std::vector<char> matching_;
+};
+
+//! Keep the residues in the same assembly as the first residue reaching this
+//! filter, as `prune::identical_residues`
+class SameAssembly {
+  public:
+    void prepare(const chemfiles::Frame& /*unused*/) { first_ = NONE; }
+
+    void prepare(const FrameIndex& /*unused*/) { first_ = NONE; }
+
+    bool operator()(const chemfiles::Frame& frame, size_t residue) {
+        if (first_ == NONE) {
+            first_ = residue;
+            return true;
+        }
+
+        const auto& residues = frame.topology().residues();
+        return residues[residue].get("assembly") ==
+               residues[first_].get("assembly");
+    }
+
+    bool operator()(const FrameIndex& index, size_t residue) {
+        if (first_ == NONE) {
+            first_ = residue;
+            return true;
+        }
+
+        const auto& assemblies = index.tables().assemblies();
+        return assemblies[residue] == assemblies[first_];
+    }
+
+  private:
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+    size_t first_ = NONE;
+};
+
+//! Keep the residues for which a function of the residue index returns true
+template <typename Function> class Where {
+  public:
+    explicit Where(Function function) : function_(std::move(function)) {}
+
+    template <typename Source> void prepare(const Source& /*unused*/) {}
+
+    template <typename Source>
+    bool operator()(const Source& /*unused*/, size_t residue) {
+        return function_(residue);
+    }
+
+  private:
+    Function function_;
+};
+
+//! Keep or remove the residues near other residues, as
+//! `prune::keep_interactions` and `prune::remove_interactions`. This filter is
+//! run by a `Query` after all others, on the remaining residues.
+struct Proximity {
+    //! Check the residues named in `partners`, found in the pass over all
+    //! residues
+    Proximity(const ResidueNameSet& partners, double cutoff, bool near)
+        : names(&partners), distance(cutoff), keep(near) {}
+
+    //! Check the residues of `partners`
+    template <typename Container>
+    Proximity(const Container& partners, double cutoff, bool near)
+        : names(nullptr),
+          residue_ids(std::begin(partners), std::end(partners)),
+          distance(cutoff), keep(near) {}
+
+    const ResidueNameSet* names;       //!< The partner names, if any
+    std::vector<uint64_t> residue_ids; //!< The partners, if not named
+    double distance;
+    bool keep;
+};
+
+} // namespace filter
+
+//! A selection of residues built from filters, run in a single pass
+//!
+//! A workflow usually selects residues and then prunes them with several
+//! functions, each one going over the residues and rewriting their container.
+//! A `Query` combines the same criteria into a single function, built at
+//! compile time, and calls it once per residue, so that each residue is
+//! checked by the filters in the order they were added until one rejects it.
+//! The residue names needed by `near` and `not_near` are found in the same
+//! pass. The spatial filters are then applied to the remaining residues only,
+//! after all other filters, whatever their position in the query.
+//!
+//! Create a query with `lemon::query`, from a `chemfiles::Frame` or from a
+//! `FrameIndex`, which is faster when several functions use the same entry.
+//! Each function adding a filter returns a new query, and the residues are
+//! only checked by `select`. The frame and the sets of names and types given
+//! to the query are not copied, and must outlive it.
+template <typename Source, typename Filter = filter::All> class Query {
+  public:
+    //! Create a query keeping the residues of `source` kept by `filter`
+    explicit Query(const Source& source, Filter filter = Filter())
+        : source_(&source), filter_(std::move(filter)) {}
+
+    //! Keep the small molecules, as `select::small_molecules`
+    Query<Source, filter::Both<Filter, filter::SmallMolecules>> small_molecules(
+        const std::unordered_set<std::string>& types = small_molecule_types,
+        size_t min_heavy_atoms = 10) const {
+        return then_(filter::SmallMolecules(types, min_heavy_atoms));
+    }
+
+    //! Keep the peptide residues, as `select::peptides`
+    Query<Source, filter::Both<Filter, filter::Peptides>> peptides() const {
+        return then_(filter::Peptides());
+    }
+
+    //! Keep the nucleic acid residues, as `select::nucleic_acids`
+    Query<Source, filter::Both<Filter, filter::NucleicAcids>>
+    nucleic_acids() const {
+        return then_(filter::NucleicAcids());
+    }
+
+    //! Keep the residues named in `names`, as `select::specific_residues`
+    Query<Source, filter::Both<Filter, filter::Names>>
+    in(const ResidueNameSet& names) const {
+        return then_(filter::Names(names, true));
+    }
+
+    //! Remove the residues named in `names`, as `prune::cofactors`
+    Query<Source, filter::Both<Filter, filter::Names>>
+    not_in(const ResidueNameSet& names) const {
+        return then_(filter::Names(names, false));
+    }
+
+    //! Keep the residues in the same assembly as the first residue kept by
+    //! the previous filters, as `prune::identical_residues`
+    Query<Source, filter::Both<Filter, filter::SameAssembly>>
+    same_assembly() const {
+        return then_(filter::SameAssembly());
+    }
+
+    //! Keep the residues for which `function`, called with the residue index,
+    //! returns true
+    template <typename Function>
+    Query<Source, filter::Both<Filter, filter::Where<Function>>>
+    where(Function function) const {
+        return then_(filter::Where<Function>(std::move(function)));
+    }
+
+    //! Keep the residues within `distance` of a residue named in `names`, as
+    //! `prune::keep_interactions`
+    Query near(const ResidueNameSet& names, double distance) const {
+        return with_(filter::Proximity(names, distance, true));
+    }
+
+    //! Keep the residues within `distance` of a residue of `residue_ids`, as
+    //! `prune::keep_interactions`
+    template <typename Container>
+    Query near(const Container& residue_ids, double distance) const {
+        return with_(filter::Proximity(residue_ids, distance, true));
+    }
+
+    //! Remove the residues within `distance` of a residue named in `names`,
+    //! as `prune::remove_interactions`
+    Query not_near(const ResidueNameSet& names, double distance) const {
+        return with_(filter::Proximity(names, distance, false));
+    }
+
+    //! Remove the residues within `distance` of a residue of `residue_ids`,
+    //! as `prune::remove_interactions`
+    template <typename Container>
+    Query not_near(const Container& residue_ids, double distance) const {
+        return with_(filter::Proximity(residue_ids, distance, false));
+    }
+
+    //! Run the query
+    //! \return The indexes of the residues kept by all filters, in increasing
+    //!  order.
+    template <typename Container = std::vector<uint64_t>>
+    Container select() const {
+        const auto& source = *source_;
+
+        // Only the state of this run is copied: the tables of the filters
+        // and the residues named by the spatial filters
+        auto filter = filter_;
+        filter.prepare(source);
+
+        std::vector<std::pair<filter::Names, std::vector<uint64_t>>> named;
+        for (const auto& proximity : proximities_) {
+            if (proximity.names != nullptr) {
+                named.emplace_back(filter::Names(*proximity.names, true),
+                                   std::vector<uint64_t>());
+                named.back().first.prepare(source);
+            }
+        }
+
+        Container selection;
+        auto count = residue_count_(source);
+        for (size_t residue = 0; residue < count; ++residue) {
+            for (auto& names : named) {
+                if (names.first(source, residue)) {
+                    names.second.push_back(residue);
+                }
+            }
+
+            if (filter(source, residue)) {
+                selection.insert(selection.end(), residue);
+            }
+        }
+
+        auto found = named.begin();
+        for (const auto& proximity : proximities_) {
+            if (selection.empty()) {
+                break;
+            }
+            const auto& partners = proximity.names != nullptr
+                                       ? (found++)->second
+                                       : proximity.residue_ids;
+            prune::interactions(source, selection, partners,
+                                proximity.distance, proximity.keep);
+        }
+
+        return selection;
+    }
+
+  private:
+    template <typename S, typename F> friend class Query;
+
+    template <typename Next>
+    Query<Source, filter::Both<Filter, Next>> then_(Next next) const {
+        Query<Source, filter::Both<Filter, Next>> result(
+            *source_, filter::Both<Filter, Next>(filter_, std::move(next)));
+        result.proximities_ = proximities_;
+        return result;
+    }
+
+    Query with_(filter::Proximity proximity) const {
+        auto result = *this;
+        result.proximities_.push_back(std::move(proximity));
+        return result;
+    }
+
+    static size_t residue_count_(const chemfiles::Frame& frame) {
+        return frame.topology().residues().size();
+    }
+
+    static size_t residue_count_(const FrameIndex& index) {
+        return index.residue_count();
+    }
+
+    const Source* source_;
+    Filter filter_;
+    std::vector<filter::Proximity> proximities_;
+};
+
+//! Start a query of the residues of `frame`
+inline Query<chemfiles::Frame> query(const chemfiles::Frame& frame) {
+    return Query<chemfiles::Frame>(frame);
+}
+
+//! Start a query of the residues of an indexed frame
+inline Query<FrameIndex> query(const FrameIndex& index) {
+    return Query<FrameIndex>(index);
+}
+
+} // namespace lemon
+
+#endif
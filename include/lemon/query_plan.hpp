@@ -0,0 +1,480 @@
+#ifndef LEMON_QUERY_PLAN_HPP
+#define LEMON_QUERY_PLAN_HPP
+
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lemon/constants.hpp"
+#include "lemon/frame_index.hpp"
+#include "lemon/prune.hpp"
+#include "lemon/query.hpp"
+#include "lemon/residue_name.hpp"
+#include "lemon/select.hpp"
+#include "lemon/selection.hpp"
+
+namespace lemon {
+
+//! A query of residues given at runtime, compiled to a plan of selections
+//!
+//! The text of a query combines selections of residues with `&` (or `and`),
+//! `|` (or `or`), `!` (or `not`) and parentheses, and may end with an action
+//! after `->`:
+//!
+//! \code
+//! small_molecules & !cofactors & within(6.0, resn HEM HEC) -> count resn
+//! \endcode
+//!
+//! The selections are `all`, `small_molecules`, `peptides`, `nucleic_acids`,
+//! `metal_ions`, `cofactors`, `fatty_acids`, `resn` followed by one or more
+//! residue names, and `within(distance, selection)` for the residues with an
+//! atom closer than `distance` to an atom of the residues of `selection`. The
+//! actions are `list` (the default), `count` and `count resn`.
+//!
+//! Each selection is run with the function of the `select` namespace on a
+//! `FrameIndex`, and the results are combined as `Selection`s. In an
+//! intersection, the selections are run first, the excluded residues are
+//! removed next, and `within` is checked last, with
+//! `prune::keep_interactions` or `prune::remove_interactions`, on the
+//! remaining residues only. Names joined by `&` or `|` are merged into one
+//! set, checked in a single pass.
+class QueryPlan {
+  public:
+    //! What is done with the selected residues of each entry
+    enum Action {
+        LIST,       //!< Print the entry and the names of the residues
+        COUNT,      //!< Count the residues
+        COUNT_NAMES //!< Count the residues by name
+    };
+
+    //! Compile the query in `text`
+    //! \throws std::runtime_error if `text` is not a valid query.
+    explicit QueryPlan(const std::string& text) : tokens_(tokenize_(text)) {
+        auto root = parse_union_();
+
+        if (accept_("->")) {
+            if (accept_("list")) {
+                action_ = LIST;
+            } else if (accept_("count")) {
+                action_ = accept_("resn") ? COUNT_NAMES : COUNT;
+            } else {
+                error_("Expected 'list' or 'count'");
+            }
+        }
+
+        if (position_ != tokens_.size()) {
+            error_("Expected '&', '|' or '->'");
+        }
+
+        root_ = step_(root);
+        tokens_.clear();
+    }
+
+    //! What is done with the selected residues
+    Action action() const { return action_; }
+
+    //! Run the plan on an entry
+    //! \return The residues of the entry matching the query.
+    Selection select(const FrameIndex& index) const {
+        return run_(root_, index);
+    }
+
+    //! The steps of the plan, one per line, indented below the step using
+    //! their results
+    std::string str() const {
+        std::ostringstream os;
+        print_(os, root_, false, 0);
+        return os.str();
+    }
+
+  private:
+    enum Operation {
+        ALL,
+        SMALL_MOLECULES,
+        PEPTIDES,
+        NUCLEIC_ACIDS,
+        METAL_IONS,
+        NAMES,
+        UNION,
+        INTERSECTION,
+        WITHIN
+    };
+
+    // A step used by another one, whose residues are excluded if `negated`
+    struct Operand {
+        size_t step;
+        bool negated;
+    };
+
+    struct Step {
+        Operation operation;
+        ResidueNameSet names;
+        double distance;
+        std::vector<Operand> operands;
+    };
+
+    // Grammar, from the lowest precedence:
+    //   union        := intersection ('|' intersection)*
+    //   intersection := factor ('&' factor)*
+    //   factor       := '!' factor | '(' union ')' | selection
+    Operand parse_union_() {
+        std::vector<Operand> operands = {parse_intersection_()};
+        while (accept_("|") || accept_("or")) {
+            add_operand_(operands, parse_intersection_(), UNION);
+        }
+
+        if (operands.size() == 1) {
+            return operands[0];
+        }
+
+        for (auto& operand : operands) {
+            operand = {step_(operand), false};
+        }
+        return {add_step_(UNION, std::move(operands)), false};
+    }
+
+    Operand parse_intersection_() {
+        std::vector<Operand> operands = {parse_factor_()};
+        while (accept_("&") || accept_("and")) {
+            auto operand = parse_factor_();
+            if (!operand.negated &&
+                steps_[operand.step].operation == INTERSECTION) {
+                for (auto inner : steps_[operand.step].operands) {
+                    add_operand_(operands, inner, INTERSECTION);
+                }
+                continue;
+            }
+            add_operand_(operands, operand, INTERSECTION);
+        }
+
+        if (operands.size() == 1) {
+            return operands[0];
+        }
+
+        // Selections first, then exclusions, then the spatial checks
+        std::vector<Operand> ordered;
+        for (int pass = 0; pass < 3; ++pass) {
+            for (auto operand : operands) {
+                auto within = steps_[operand.step].operation == WITHIN;
+                auto rank = within ? 2 : (operand.negated ? 1 : 0);
+                if (rank == pass) {
+                    ordered.push_back(operand);
+                }
+            }
+        }
+
+        return {add_step_(INTERSECTION, std::move(ordered)), false};
+    }
+
+    Operand parse_factor_() {
+        if (accept_("!") || accept_("not")) {
+            auto operand = parse_factor_();
+            operand.negated = !operand.negated;
+            return operand;
+        }
+
+        if (accept_("(")) {
+            auto operand = parse_union_();
+            expect_(")");
+            return operand;
+        }
+
+        if (position_ == tokens_.size()) {
+            error_("Expected a selection");
+        }
+
+        const auto& word = tokens_[position_++];
+        if (word == "all") {
+            return {add_step_(ALL), false};
+        }
+        if (word == "small_molecules") {
+            return {add_step_(SMALL_MOLECULES), false};
+        }
+        if (word == "peptides") {
+            return {add_step_(PEPTIDES), false};
+        }
+        if (word == "nucleic_acids") {
+            return {add_step_(NUCLEIC_ACIDS), false};
+        }
+        if (word == "metal_ions") {
+            return {add_step_(METAL_IONS), false};
+        }
+        if (word == "cofactors") {
+            return {add_names_(common_cofactors), false};
+        }
+        if (word == "fatty_acids") {
+            return {add_names_(common_fatty_acids), false};
+        }
+        if (word == "resn") {
+            return {add_names_(parse_names_()), false};
+        }
+        if (word == "within") {
+            expect_("(");
+            auto distance = parse_distance_();
+            expect_(",");
+            auto partners = step_(parse_union_());
+            expect_(")");
+
+            auto index = add_step_(WITHIN, {{partners, false}});
+            steps_[index].distance = distance;
+            return {index, false};
+        }
+
+        --position_;
+        error_("Unknown selection '" + word + "'");
+        return {0, false};
+    }
+
+    ResidueNameSet parse_names_() {
+        ResidueNameSet names;
+        do {
+            if (position_ == tokens_.size() ||
+                !valid_name_(tokens_[position_])) {
+                error_("Expected a residue name");
+            }
+            names.insert(tokens_[position_++]);
+            accept_(",");
+        } while (position_ != tokens_.size() &&
+                 valid_name_(tokens_[position_]));
+        return names;
+    }
+
+    double parse_distance_() {
+        if (position_ == tokens_.size()) {
+            error_("Expected a distance");
+        }
+
+        const auto& word = tokens_[position_];
+        char* end = nullptr;
+        auto distance = std::strtod(word.c_str(), &end);
+        // Nothing is closer than zero, so such a `within` is an error
+        if (end != word.c_str() + word.size() || !(distance > 0.0) ||
+            !std::isfinite(distance)) {
+            error_("Invalid distance '" + word + "'");
+        }
+
+        ++position_;
+        return distance;
+    }
+
+    // Adds `operand` to the operands of a union or an intersection, merging
+    // the residue names with the names already there
+    void add_operand_(std::vector<Operand>& operands, Operand operand,
+                      Operation operation) {
+        const auto& step = steps_[operand.step];
+        if (step.operation == NAMES) {
+            for (auto& other : operands) {
+                auto& merged = steps_[other.step];
+                if (merged.operation != NAMES ||
+                    other.negated != operand.negated) {
+                    continue;
+                }
+
+                // !a & !b is !(a | b), and !a | !b is !(a & b)
+                if ((operation == UNION) != operand.negated) {
+                    merged.names |= step.names;
+                } else {
+                    merged.names &= step.names;
+                }
+                return;
+            }
+        }
+
+        operands.push_back(operand);
+    }
+
+    size_t add_step_(Operation operation,
+                     std::vector<Operand> operands = std::vector<Operand>()) {
+        steps_.push_back(
+            {operation, ResidueNameSet(), 0.0, std::move(operands)});
+        return steps_.size() - 1;
+    }
+
+    size_t add_names_(const ResidueNameSet& names) {
+        auto index = add_step_(NAMES);
+        steps_[index].names = names;
+        return index;
+    }
+
+    // The step giving the residues of `operand`
+    size_t step_(Operand operand) {
+        if (!operand.negated) {
+            return operand.step;
+        }
+
+        return add_step_(INTERSECTION, {operand});
+    }
+
+    Selection run_(size_t index, const FrameIndex& frame) const {
+        const auto& step = steps_[index];
+        switch (step.operation) {
+        case ALL:
+            return Selection::all(frame.residue_count());
+        case SMALL_MOLECULES:
+            return select::small_molecules<Selection>(frame);
+        case PEPTIDES:
+            return select::peptides<Selection>(frame);
+        case NUCLEIC_ACIDS:
+            return select::nucleic_acids<Selection>(frame);
+        case METAL_IONS:
+            return select::metal_ions<Selection>(frame.frame());
+        case NAMES:
+            return query(frame).in(step.names).select<Selection>();
+        case UNION: {
+            Selection selection;
+            for (auto operand : step.operands) {
+                selection |= run_(operand.step, frame);
+            }
+            return selection;
+        }
+        case WITHIN: {
+            auto selection = Selection::all(frame.residue_count());
+            auto partners = run_(step.operands[0].step, frame);
+            prune::keep_interactions(frame, selection, partners,
+                                     step.distance);
+            return selection;
+        }
+        case INTERSECTION:
+        default:
+            break;
+        }
+
+        // The operands are sorted: the selections, the exclusions, and the
+        // spatial checks which only look at the remaining residues
+        Selection selection;
+        auto operand = step.operands.begin();
+        if (!operand->negated && steps_[operand->step].operation != WITHIN) {
+            selection = run_(operand->step, frame);
+            ++operand;
+        } else {
+            selection = Selection::all(frame.residue_count());
+        }
+
+        for (; operand != step.operands.end() && !selection.empty();
+             ++operand) {
+            const auto& other = steps_[operand->step];
+            if (other.operation == WITHIN) {
+                auto partners = run_(other.operands[0].step, frame);
+                prune::interactions(frame, selection, partners,
+                                    other.distance, !operand->negated);
+            } else if (operand->negated) {
+                selection -= run_(operand->step, frame);
+            } else {
+                selection &= run_(operand->step, frame);
+            }
+        }
+
+        return selection;
+    }
+
+    void print_(std::ostream& os, size_t index, bool negated,
+                size_t depth) const {
+        static const char* names[] = {
+            "all",          "small_molecules", "peptides",
+            "nucleic_acids", "metal_ions",     "resn",
+            "union",        "intersection",    "within"};
+
+        const auto& step = steps_[index];
+        os << std::string(2 * depth, ' ') << (negated ? "not " : "")
+           << names[step.operation];
+
+        if (step.operation == NAMES) {
+            size_t shown = 0;
+            for (auto name : step.names) {
+                if (++shown > 8) {
+                    os << " ... (" << step.names.size() << " names)";
+                    break;
+                }
+                os << ' ' << name;
+            }
+        } else if (step.operation == WITHIN) {
+            os << ' ' << step.distance;
+        }
+        os << '\n';
+
+        for (auto operand : step.operands) {
+            print_(os, operand.step, operand.negated, depth + 1);
+        }
+    }
+
+    bool accept_(const char* token) {
+        if (position_ != tokens_.size() && tokens_[position_] == token) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect_(const char* token) {
+        if (!accept_(token)) {
+            error_(std::string("Expected '") + token + "'");
+        }
+    }
+
+    void error_(const std::string& message) const {
+        auto where = position_ < tokens_.size()
+                         ? "near '" + tokens_[position_] + "'"
+                         : std::string("at the end");
+        throw std::runtime_error("Invalid query " + where + ": " + message);
+    }
+
+    // Names which can be stored in a `ResidueName`
+    static bool valid_name_(const std::string& name) {
+        if (name.empty() || name.size() > 3) {
+            return false;
+        }
+        for (auto c : name) {
+            if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::vector<std::string> tokenize_(const std::string& text) {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < text.size()) {
+            auto c = text[i];
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                ++i;
+            } else if (c == '-' && i + 1 < text.size() && text[i + 1] == '>') {
+                tokens.emplace_back("->");
+                i += 2;
+            } else if (c == '&' || c == '|' || c == '!' || c == '(' ||
+                       c == ')' || c == ',') {
+                tokens.emplace_back(1, c);
+                ++i;
+            } else if (std::isalnum(static_cast<unsigned char>(c)) ||
+                       c == '_' || c == '.') {
+                auto start = i;
+                while (i < text.size() &&
+                       (std::isalnum(static_cast<unsigned char>(text[i])) ||
+                        text[i] == '_' || text[i] == '.')) {
+                    ++i;
+                }
+                tokens.emplace_back(text.substr(start, i - start));
+            } else {
+                throw std::runtime_error("Invalid query: unexpected '" +
+                                         std::string(1, c) + "'");
+            }
+        }
+        return tokens;
+    }
+
+    std::vector<std::string> tokens_;
+    size_t position_ = 0;
+    std::vector<Step> steps_;
+    size_t root_ = 0;
+    Action action_ = LIST;
+};
+
+} // namespace lemon
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef LEMON_REORDER_BUFFER_HPP
+#define LEMON_REORDER_BUFFER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/external/optional.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! A window of numbered items shared between threads, returned in order.
+//!
+//! Producers `push` the item with a given index, in any order, and a single
+//! consumer `pop`s them in order of their index. Every index, starting from
+//! zero, must be pushed exactly once, with `chemfiles::nullopt` if there is no
+//! item for it. A producer blocks while its index is `capacity` or more ahead
+//! of the next item to be returned, so at most `capacity` items wait in the
+//! buffer. Producers must therefore take their indices in increasing order.
+template <class T> class reorder_buffer {
+  public:
+    //! Create a buffer which holds at most `capacity` items.
+    explicit reorder_buffer(size_t capacity)
+        : slots_(capacity == 0 ? 1 : capacity), filled_(slots_.size(), false) {
+    }
+
+    reorder_buffer(const reorder_buffer&) = delete;
+    reorder_buffer& operator=(const reorder_buffer&) = delete;
+
+    //! Add the item with the given index, waiting for space if needed.
+    //!
+    //! \return False if the buffer was closed and the item was not added.
+    bool push(size_t index, chemfiles::optional<T> item) {
+        {
+            lock l(m_);
+            not_full_.wait(l, [this, index] {
+                return closed_ || index < next_ + slots_.size();
+            });
+
+            if (closed_) {
+                return false;
+            }
+
+            auto slot = index % slots_.size();
+            slots_[slot] = std::move(item);
+            filled_[slot] = true;
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+    //! Remove the next item, waiting for it if needed.
+    //!
+    //! Indices pushed without an item are skipped.
+    //! \return The item, or `chemfiles::nullopt` if the buffer is closed and
+    //!  the next index was never pushed.
+    chemfiles::optional<T> pop() {
+        lock l(m_);
+        while (true) {
+            auto slot = next_ % slots_.size();
+            ready_.wait(l, [this, slot] { return closed_ || filled_[slot]; });
+
+            if (!filled_[slot]) {
+                return chemfiles::nullopt;
+            }
+
+            chemfiles::optional<T> result = std::move(slots_[slot]);
+            slots_[slot] = chemfiles::nullopt;
+            filled_[slot] = false;
+            ++next_;
+            not_full_.notify_all();
+
+            if (result) {
+                return result;
+            }
+        }
+    }
+
+    //! Stop accepting new items and wake all waiting threads.
+    //!
+    //! Items which were already pushed are still returned by `pop`.
+    void close() {
+        {
+            lock l(m_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+        not_full_.notify_all();
+    }
+
+  private:
+    using lock = std::unique_lock<std::mutex>;
+
+    std::mutex m_;
+    std::condition_variable ready_;
+    std::condition_variable not_full_;
+    std::vector<chemfiles::optional<T>> slots_;
+    std::vector<bool> filled_;
+    size_t next_ = 0;
+    bool closed_ = false;
+};
+
+} // namespace lemon
+
+#endif
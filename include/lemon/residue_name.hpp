@@ -2,11 +2,18 @@
 #define LEMON_RESIDUE_NAME_HPP
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <initializer_list>
+#include <iterator>
 #include <ostream>
-#include <set>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lemon/bits.hpp"
 
 namespace lemon {
 
@@ -22,25 +29,41 @@ class ResidueName : public std::array<char, 3> {
     friend std::ostream& operator<<(std::ostream& os, const ResidueName& res_name);
     using super::operator[];
 
+    static constexpr bool valid_character_(char c) {
+        return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z');
+    }
+
     static char check_digit_(char c) {
 #ifndef NDEBUG
-        if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z'))) {
+        if (!valid_character_(c)) {
             throw std::range_error("Invalid character");
         }
 #endif
         return c;
     }
 
-    static char clamp_(char c) {
-        if (c == 0) {
-            return 36; // NOLINT 36 is the maximum value
+    static constexpr char clamp_(char c) {
+        return c == 0 ? 36 // NOLINT 36 is the maximum value
+                      : (c >= '0' && c <= '9')
+                            ? static_cast<char>(c - '0')
+                            : static_cast<char>(10 + c - 'A'); // NOLINT 'A' is 10
+    }
+
+    static constexpr char check_literal_(char c) {
+        return valid_character_(c) ? c
+                                   : throw std::range_error("Invalid character");
+    }
+
+    static char unclamp_(unsigned value) {
+        if (value == 36) { // NOLINT 36 is the maximum value
+            return 0;
         }
 
-        if (c >= '0' && c <= '9') {
-            return static_cast<char>(c - '0');
+        if (value < 10) { // NOLINT 'A' is 10
+            return static_cast<char>('0' + value);
         }
 
-        return static_cast<char>(10 + c - 'A'); // NOLINT 'A' is 10
+        return static_cast<char>('A' + value - 10); // NOLINT 'A' is 10
     }
 
   public:
@@ -100,8 +123,58 @@ class ResidueName : public std::array<char, 3> {
                                            clamp_((*this)[2]) * (37 * 37)); // NOLINT see above
     }
     const std::array<char, 3>& operator*() const { return *this; }
+
+    //! Check if the name is made of one to three digits or capital letters
+    //!
+    //! The names of the Chemical Component Dictionary are always valid. The
+    //! characters are only checked when a name is built in debug mode, and
+    //! invalid names can share their `hash()` with a valid one.
+    bool valid() const {
+        const auto& name = *this;
+        if (!valid_character_(name[0])) {
+            return false;
+        }
+
+        if (name[1] == 0) {
+            return name[2] == 0;
+        }
+
+        return valid_character_(name[1]) &&
+               (name[2] == 0 || valid_character_(name[2]));
+    }
+
+    //! The hash of the residue name given by a string literal.
+    //!
+    //! Unlike `hash()`, this function is evaluated at compile time, so it can
+    //! be used to build constant tables. An invalid name fails to compile.
+    template <size_t N>
+    static constexpr unsigned short literal_hash(const char (&name)[N]) {
+        static_assert(N >= 2 && N <= 4,
+                      "A residue name has one to three characters");
+        return static_cast<unsigned short>(
+            clamp_(check_literal_(name[0])) +
+            clamp_(N > 2 ? check_literal_(name[1]) : '\0') * 37 + // NOLINT see hash
+            clamp_(N > 3 ? check_literal_(name[N > 3 ? 2 : 0]) : '\0') *
+                (37 * 37)); // NOLINT see hash
+    }
+
+    //! The residue name with the given `hash`, which must be below
+    //! `RESIDUE_NAME_HASHES`
+    static ResidueName from_hash(unsigned short hash) {
+        ResidueName result;
+        result[0] = unclamp_(hash % 37u);        // NOLINT see hash
+        result[1] = unclamp_(hash / 37u % 37u);  // NOLINT see hash
+        result[2] = unclamp_(hash / (37u * 37u)); // NOLINT see hash
+        return result;
+    }
 };
 
+//! The number of hashes of valid residue names
+//!
+//! Every name made of one to three digits or capital letters has a different
+//! `ResidueName::hash()` below this value.
+constexpr size_t RESIDUE_NAME_HASHES = 37 * 37 * 37;
+
 struct ResidueNameHash {
     unsigned short operator()(const ResidueName& resn) const {
         return resn.hash();
@@ -168,9 +241,491 @@ inline bool operator<(const ResidueName& lhs, const ResidueName& rhs) {
     return false;
 }
 
-using ResidueNameCount =
-      std::unordered_map<ResidueName, std::size_t, ResidueNameHash>;
-using ResidueNameSet = std::set<ResidueName> ;
+namespace detail {
+
+template <size_t... I> struct index_list {};
+
+template <typename First, typename Second> struct concat_index_lists;
+
+template <size_t... I, size_t... J>
+struct concat_index_lists<index_list<I...>, index_list<J...>> {
+    using type = index_list<I..., (sizeof...(I) + J)...>;
+};
+
+// The indexes 0 to N - 1, built with a logarithmic template depth
+template <size_t N>
+struct make_index_list
+    : concat_index_lists<typename make_index_list<N / 2>::type,
+                         typename make_index_list<N - N / 2>::type> {};
+
+template <> struct make_index_list<0> { using type = index_list<>; };
+template <> struct make_index_list<1> { using type = index_list<0>; };
+
+template <size_t N> struct hash_list { unsigned short hashes[N]; };
+
+} // namespace detail
+
+//! A set of residue names, stored as one bit per `ResidueName::hash()`
+//!
+//! Checking if a name is in the set is a single bit test, and the union,
+//! intersection and difference of two sets work on 64 names at once. The
+//! set iterates over its names in the order of their hashes. A set of string
+//! literals is built at compile time, like the sets of `constants.hpp`.
+//! Only names which are `ResidueName::valid()` can be inserted, others throw
+//! a `std::range_error`. The set never contains an invalid name.
+class ResidueNameSet {
+    static constexpr size_t WORDS = (RESIDUE_NAME_HASHES + 63) / 64;
+
+  public:
+    //! Iterates over the names of the set, in the order of their hashes
+    class const_iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ResidueName;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const ResidueName*;
+        using reference = const ResidueName&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return name_; }
+        pointer operator->() const { return &name_; }
+
+        const_iterator& operator++() {
+            set_hash_(set_->next_(hash_ + 1));
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return hash_ == other.hash_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return hash_ != other.hash_;
+        }
+
+      private:
+        friend class ResidueNameSet;
+        const_iterator(const ResidueNameSet* set, size_t hash) : set_(set) {
+            set_hash_(hash);
+        }
+
+        void set_hash_(size_t hash) {
+            hash_ = hash;
+            if (hash_ < RESIDUE_NAME_HASHES) {
+                name_ = ResidueName::from_hash(static_cast<unsigned short>(hash));
+            }
+        }
+
+        const ResidueNameSet* set_ = nullptr;
+        size_t hash_ = 0;
+        ResidueName name_;
+    };
+
+    using iterator = const_iterator;
+    using value_type = ResidueName;
+    using size_type = size_t;
+
+    //! Create an empty set
+    constexpr ResidueNameSet() : words_{} {}
+
+    //! Create a set of `names`
+    ResidueNameSet(std::initializer_list<ResidueName> names) : words_{} {
+        for (const auto& name : names) {
+            insert(name);
+        }
+    }
+
+    //! Create a set of string literals at compile time
+    template <size_t N, size_t... M>
+    constexpr explicit ResidueNameSet(const char (&name)[N],
+                                      const char (&... names)[M])
+        : ResidueNameSet(
+              detail::hash_list<1 + sizeof...(M)>{
+                  {ResidueName::literal_hash(name),
+                   ResidueName::literal_hash(names)...}},
+              typename detail::make_index_list<WORDS>::type()) {}
+
+    //! The number of names in the set
+    size_t size() const {
+        size_t count = 0;
+        for (auto word : words_) {
+            count += popcount(word);
+        }
+        return count;
+    }
+
+    //! Check if the set contains no name
+    bool empty() const {
+        for (auto word : words_) {
+            if (word != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Check if `name` is in the set, false if `name` is not valid
+    bool contains(const ResidueName& name) const {
+        if (!name.valid()) {
+            return false;
+        }
+
+        auto hash = name.hash();
+        return (words_[hash / 64] >> (hash % 64) & 1) != 0;
+    }
+
+    //! The number of times `name` is in the set, zero or one
+    size_t count(const ResidueName& name) const {
+        return contains(name) ? 1 : 0;
+    }
+
+    //! Add `name` to the set
+    //! \return True if `name` was not in the set yet.
+    //! \throws std::range_error if `name` is not valid.
+    bool insert(const ResidueName& name) {
+        if (!name.valid()) {
+            throw std::range_error("Invalid residue name");
+        }
+
+        auto hash = name.hash();
+        auto& word = words_[hash / 64];
+        auto bit = uint64_t(1) << (hash % 64);
+        auto inserted = (word & bit) == 0;
+        word |= bit;
+        return inserted;
+    }
+
+    //! Remove `name` from the set
+    //! \return The number of names removed, zero or one
+    size_t erase(const ResidueName& name) {
+        if (!contains(name)) {
+            return 0;
+        }
+
+        auto hash = name.hash();
+        words_[hash / 64] &= ~(uint64_t(1) << (hash % 64));
+        return 1;
+    }
+
+    //! Remove all names
+    void clear() {
+        for (auto& word : words_) {
+            word = 0;
+        }
+    }
+
+    //! The first name of the set
+    const_iterator begin() const { return {this, next_(0)}; }
+
+    //! Past the last name of the set
+    const_iterator end() const { return {this, 64 * WORDS}; }
+
+    //! Add the names of `other` to the set
+    ResidueNameSet& operator|=(const ResidueNameSet& other) {
+        for (size_t word = 0; word < WORDS; ++word) {
+            words_[word] |= other.words_[word];
+        }
+        return *this;
+    }
+
+    //! Keep only the names also in `other`
+    ResidueNameSet& operator&=(const ResidueNameSet& other) {
+        for (size_t word = 0; word < WORDS; ++word) {
+            words_[word] &= other.words_[word];
+        }
+        return *this;
+    }
+
+    //! Remove the names of `other` from the set
+    ResidueNameSet& operator-=(const ResidueNameSet& other) {
+        for (size_t word = 0; word < WORDS; ++word) {
+            words_[word] &= ~other.words_[word];
+        }
+        return *this;
+    }
+
+    //! Check if both sets contain the same names
+    friend bool operator==(const ResidueNameSet& lhs,
+                           const ResidueNameSet& rhs) {
+        for (size_t word = 0; word < WORDS; ++word) {
+            if (lhs.words_[word] != rhs.words_[word]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Check if the sets contain different names
+    friend bool operator!=(const ResidueNameSet& lhs,
+                           const ResidueNameSet& rhs) {
+        return !(lhs == rhs);
+    }
+
+  private:
+    template <size_t N, size_t... W>
+    constexpr ResidueNameSet(const detail::hash_list<N>& list,
+                             detail::index_list<W...> /*unused*/)
+        : words_{word_(list, W, 0)...} {}
+
+    // The bits of the hashes of `list` from `i` falling in `word`
+    template <size_t N>
+    static constexpr uint64_t word_(const detail::hash_list<N>& list,
+                                    size_t word, size_t i) {
+        return i == N ? 0
+                      : (list.hashes[i] / 64 == word
+                             ? uint64_t(1) << (list.hashes[i] % 64)
+                             : 0) |
+                            word_(list, word, i + 1);
+    }
+
+    // The first hash of the set from `hash`, or `64 * WORDS` if none
+    size_t next_(size_t hash) const {
+        auto word = hash / 64;
+        if (word >= WORDS) {
+            return 64 * WORDS;
+        }
+
+        auto bits = words_[word] & (~uint64_t(0) << (hash % 64));
+        while (bits == 0) {
+            if (++word == WORDS) {
+                return 64 * WORDS;
+            }
+            bits = words_[word];
+        }
+        return 64 * word + trailing_zeros(bits);
+    }
+
+    uint64_t words_[WORDS];
+};
+
+//! The number of residues of each name, stored in arrays indexed by
+//! `ResidueName::hash()`
+//!
+//! The counts are stored in pages of 64 names, allocated when a name of the
+//! page is first used, so an empty count allocates nothing and counting a
+//! few residue names stays small. Adding a count to another one adds their
+//! pages element by element. Iterating over a count gives the names with a
+//! non-zero count and their count, in the order of their hashes. Only names
+//! which are `ResidueName::valid()` can be counted, others throw a
+//! `std::range_error`.
+class ResidueNameCount {
+    static constexpr size_t PAGE = 64;
+    static constexpr size_t PAGES = (RESIDUE_NAME_HASHES + PAGE - 1) / PAGE;
+
+  public:
+    using value_type = std::pair<ResidueName, size_t>;
+
+    //! Iterates over the names with a non-zero count, in the order of their
+    //! hashes
+    class const_iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ResidueNameCount::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return current_; }
+        pointer operator->() const { return &current_; }
+
+        const_iterator& operator++() {
+            set_hash_(count_->next_(hash_ + 1));
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return hash_ == other.hash_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return hash_ != other.hash_;
+        }
+
+      private:
+        friend class ResidueNameCount;
+        const_iterator(const ResidueNameCount* count, size_t hash)
+            : count_(count) {
+            set_hash_(hash);
+        }
+
+        void set_hash_(size_t hash) {
+            hash_ = hash;
+            if (hash_ < RESIDUE_NAME_HASHES) {
+                current_.first =
+                    ResidueName::from_hash(static_cast<unsigned short>(hash));
+                current_.second = *count_->find_(hash);
+            }
+        }
+
+        const ResidueNameCount* count_ = nullptr;
+        size_t hash_ = 0;
+        value_type current_;
+    };
+
+    using iterator = const_iterator;
+
+    //! Create an empty count
+    ResidueNameCount() = default;
+
+    //! The count of `name`, added with a count of zero if it is not present
+    //! \throws std::range_error if `name` is not valid.
+    size_t& operator[](const ResidueName& name) {
+        if (!name.valid()) {
+            throw std::range_error("Invalid residue name");
+        }
+
+        auto hash = name.hash();
+        return page_(hash / PAGE)[hash % PAGE];
+    }
+
+    //! The count of `name`, zero if it is not present or not valid
+    size_t at(const ResidueName& name) const {
+        if (!name.valid()) {
+            return 0;
+        }
+
+        auto found = find_(name.hash());
+        return found != nullptr ? *found : 0;
+    }
+
+    //! Set the count of `name` to `count` if it is zero
+    //! \throws std::range_error if `name` is not valid.
+    void emplace(const ResidueName& name, size_t count) {
+        auto& current = (*this)[name];
+        if (current == 0) {
+            current = count;
+        }
+    }
+
+    //! The number of names with a non-zero count
+    size_t size() const {
+        size_t result = 0;
+        for (auto count : counts_) {
+            result += count != 0;
+        }
+        return result;
+    }
+
+    //! Check if all counts are zero
+    bool empty() const { return size() == 0; }
+
+    //! Remove all counts
+    void clear() {
+        pages_.clear();
+        counts_.clear();
+    }
+
+    //! The first name with a non-zero count
+    const_iterator begin() const { return {this, next_(0)}; }
+
+    //! Past the last name with a non-zero count
+    const_iterator end() const { return {this, RESIDUE_NAME_HASHES}; }
+
+    //! Add the counts of `other`
+    ResidueNameCount& operator+=(const ResidueNameCount& other) {
+        if (other.pages_.empty()) {
+            return *this;
+        }
+
+        for (size_t page = 0; page < PAGES; ++page) {
+            auto other_page = other.pages_[page];
+            if (other_page == 0) {
+                continue;
+            }
+
+            auto counts = page_(page);
+            auto other_counts = &other.counts_[(other_page - 1) * PAGE];
+            for (size_t i = 0; i < PAGE; ++i) {
+                counts[i] += other_counts[i];
+            }
+        }
+        return *this;
+    }
+
+    //! Check if all names have the same count in both counts
+    friend bool operator==(const ResidueNameCount& lhs,
+                           const ResidueNameCount& rhs) {
+        for (size_t hash = 0; hash < RESIDUE_NAME_HASHES; hash += PAGE) {
+            auto lhs_counts = lhs.find_(hash);
+            auto rhs_counts = rhs.find_(hash);
+            for (size_t i = 0; i < PAGE; ++i) {
+                auto lhs_count = lhs_counts != nullptr ? lhs_counts[i] : 0;
+                auto rhs_count = rhs_counts != nullptr ? rhs_counts[i] : 0;
+                if (lhs_count != rhs_count) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    //! Check if a name has different counts in both counts
+    friend bool operator!=(const ResidueNameCount& lhs,
+                           const ResidueNameCount& rhs) {
+        return !(lhs == rhs);
+    }
+
+  private:
+    // The counts of `page`, allocated if needed
+    size_t* page_(size_t page) {
+        if (pages_.empty()) {
+            pages_.assign(PAGES, 0);
+        }
+
+        if (pages_[page] == 0) {
+            counts_.resize(counts_.size() + PAGE, 0);
+            pages_[page] = static_cast<uint32_t>(counts_.size() / PAGE);
+        }
+
+        return &counts_[(pages_[page] - 1) * PAGE];
+    }
+
+    // The count of `hash`, followed by the rest of its page, or nullptr if
+    // its page is not allocated
+    const size_t* find_(size_t hash) const {
+        if (pages_.empty() || pages_[hash / PAGE] == 0) {
+            return nullptr;
+        }
+        return &counts_[(pages_[hash / PAGE] - 1) * PAGE + hash % PAGE];
+    }
+
+    // The first hash with a non-zero count from `hash`, or
+    // `RESIDUE_NAME_HASHES` if none
+    size_t next_(size_t hash) const {
+        while (hash < RESIDUE_NAME_HASHES) {
+            auto counts = find_(hash);
+            if (counts == nullptr) {
+                hash = (hash / PAGE + 1) * PAGE;
+                continue;
+            }
+
+            if (*counts != 0) {
+                return hash;
+            }
+            ++hash;
+        }
+        return RESIDUE_NAME_HASHES;
+    }
+
+    // For each page, one plus its position in `counts_`, zero if none
+    std::vector<uint32_t> pages_;
+    std::vector<size_t> counts_;
+};
 
 inline std::ostream& operator<<(std::ostream& os, const ResidueName& res_name) {
     auto& resn = *res_name;
@@ -179,14 +734,6 @@ inline std::ostream& operator<<(std::ostream& os, const ResidueName& res_name) {
     return os;
 }
 
-inline ResidueNameCount& operator+=(ResidueNameCount& lhs,
-                                    const ResidueNameCount& rhs) {
-    for (auto iter : rhs) {
-        lhs[iter.first] += iter.second;
-    }
-    return lhs;
-}
-
 inline std::ostream& operator<<(std::ostream& os, const ResidueNameCount& rnc) {
     for (auto i : rnc) {
         os << "\t" << i.first << "\t" << i.second;
@@ -1,6 +1,7 @@
 #ifndef LEMON_SELECT_HPP
 #define LEMON_SELECT_HPP
 
+#include <set>
 #include <vector>
 #include <unordered_set>
 #include <string>
@@ -13,6 +14,9 @@ LEMON_EXTERNAL_FILE_PUSH
 LEMON_EXTERNAL_FILE_POP
 
 #include "lemon/constants.hpp"
+#include "lemon/frame_index.hpp"
+#include "lemon/frame_view.hpp"
+#include "lemon/query.hpp"
 #include "lemon/residue_name.hpp"
 
 namespace lemon {
@@ -38,33 +42,35 @@ inline Container small_molecules(
     const chemfiles::Frame& frame,
     const std::unordered_set<std::string>& types = small_molecule_types,
     size_t min_heavy_atoms = 10) {
+    return query(frame)
+        .small_molecules(types, min_heavy_atoms)
+        .template select<Container>();
+}
 
-    using chemfiles::Property;
+//! Select small molecules in a given `FrameView`
+template <typename Container = std::vector<uint64_t>>
+inline Container small_molecules(
+    const FrameView& frame,
+    const std::unordered_set<std::string>& types = small_molecule_types,
+    size_t min_heavy_atoms = 10) {
 
     Container selection;
-    const auto& residues = frame.topology().residues();
 
-    for (size_t selected_residue = 0; selected_residue < residues.size();
-         ++selected_residue) {
-        const auto& residue = residues[selected_residue];
+    for (size_t selected_residue = 0;
+         selected_residue < frame.residue_count(); ++selected_residue) {
+        auto residue = frame.residue(selected_residue);
 
-        // Quick check, filters out many ions and small molecules before more
-        // expensive checks.
-        // For example, water
         if (residue.size() < min_heavy_atoms) {
             continue;
         }
 
-        auto composition_type =
-            residue.get<Property::STRING>("composition_type").value_or("");
-
-        if (!types.count(composition_type)) {
+        if (!types.count(residue.composition_type())) {
             continue;
         }
 
         auto num_heavy_atoms = std::count_if(
-            std::begin(residue), std::end(residue), [&frame](size_t index) {
-                return *(frame[index].atomic_number()) != 1;
+            residue.begin(), residue.end(), [&frame](uint32_t index) {
+                return frame.atomic_number(index) != 1;
             });
 
         if (static_cast<size_t>(num_heavy_atoms) < min_heavy_atoms) {
@@ -77,6 +83,17 @@ inline Container small_molecules(
     return selection;
 }
 
+//! Select small molecules using the values stored in a `FrameIndex`
+template <typename Container = std::vector<uint64_t>>
+inline Container small_molecules(
+    const FrameIndex& index,
+    const std::unordered_set<std::string>& types = small_molecule_types,
+    size_t min_heavy_atoms = 10) {
+    return query(index)
+        .small_molecules(types, min_heavy_atoms)
+        .template select<Container>();
+}
+
 //! Select metal ions in a given frame
 //!
 //! This function populates the residue IDs of metal ions. We define a metal ion
@@ -101,6 +118,23 @@ inline Container metal_ions(const chemfiles::Frame& frame) {
     return selection;
 }
 
+//! Select metal ions in a given `FrameView`
+template <typename Container = std::vector<uint64_t>>
+inline Container metal_ions(const FrameView& frame) {
+    Container selection;
+
+    for (size_t selected_residue = 0;
+         selected_residue < frame.residue_count(); ++selected_residue) {
+        auto residue = frame.residue(selected_residue);
+
+        if (residue.size() == 1 && frame.charge(*residue.begin()) > 0.0f) {
+            selection.insert(selection.end(), selected_residue);
+        }
+    }
+
+    return selection;
+}
+
 //! Select nucleic acid residues in a given frame
 //!
 //! This function populates the residue IDs of nucleic acid residues.
@@ -110,17 +144,17 @@ inline Container metal_ions(const chemfiles::Frame& frame) {
 //! \return The selected residue locations
 template <typename Container = std::vector<uint64_t>>
 inline Container nucleic_acids(const chemfiles::Frame& frame) {
+    return query(frame).nucleic_acids().template select<Container>();
+}
 
-    using chemfiles::Property;
-
-    const auto& residues = frame.topology().residues();
+//! Select nucleic acid residues in a given `FrameView`
+template <typename Container = std::vector<uint64_t>>
+inline Container nucleic_acids(const FrameView& frame) {
     Container selection;
 
-    for (size_t selected_residue = 0; selected_residue < residues.size();
-         ++selected_residue) {
-        const chemfiles::Residue& residue = residues[selected_residue];
-        auto comp_type =
-            residue.get<Property::STRING>("composition_type").value_or("");
+    for (size_t selected_residue = 0;
+         selected_residue < frame.residue_count(); ++selected_residue) {
+        auto comp_type = frame.residue(selected_residue).composition_type();
 
         if (comp_type.find("DNA") == std::string::npos &&
             comp_type.find("RNA") == std::string::npos) {
@@ -133,6 +167,12 @@ inline Container nucleic_acids(const chemfiles::Frame& frame) {
     return selection;
 }
 
+//! Select nucleic acid residues using the values stored in a `FrameIndex`
+template <typename Container = std::vector<uint64_t>>
+inline Container nucleic_acids(const FrameIndex& index) {
+    return query(index).nucleic_acids().template select<Container>();
+}
+
 //! Select peptide residues in a given frame
 //!
 //! This function populates the residue IDs of peptide residues.
@@ -142,17 +182,17 @@ inline Container nucleic_acids(const chemfiles::Frame& frame) {
 //! \return The selected residue locations
 template <typename Container = std::vector<uint64_t>>
 inline Container peptides(const chemfiles::Frame& frame) {
+    return query(frame).peptides().template select<Container>();
+}
 
-    using chemfiles::Property;
-
-    const auto& residues = frame.topology().residues();
+//! Select peptide residues in a given `FrameView`
+template <typename Container = std::vector<uint64_t>>
+inline Container peptides(const FrameView& frame) {
     Container selection;
 
-    for (size_t selected_residue = 0; selected_residue < residues.size();
-         ++selected_residue) {
-        const chemfiles::Residue& residue = residues[selected_residue];
-        auto comp_type =
-            residue.get<Property::STRING>("composition_type").value_or("");
+    for (size_t selected_residue = 0;
+         selected_residue < frame.residue_count(); ++selected_residue) {
+        auto comp_type = frame.residue(selected_residue).composition_type();
 
         if (comp_type.find("PEPTIDE") == std::string::npos ||
             comp_type == "PEPTIDE-LIKE") {
@@ -165,6 +205,12 @@ inline Container peptides(const chemfiles::Frame& frame) {
     return selection;
 }
 
+//! Select peptide residues using the values stored in a `FrameIndex`
+template <typename Container = std::vector<uint64_t>>
+inline Container peptides(const FrameIndex& index) {
+    return query(index).peptides().template select<Container>();
+}
+
 //! Select residues with a given name in a given frame
 //!
 //! This function populates the residue IDs of peptides matching a given name
@@ -197,6 +243,26 @@ inline Container residue_ids(const chemfiles::Frame& frame,
     return selection;
 }
 
+//! Select residues with given IDs in a given `FrameView`
+template <typename Container = std::vector<uint64_t>>
+inline Container residue_ids(const FrameView& frame,
+                             const std::set<uint64_t>& resis) {
+    Container selection;
+
+    for (size_t selected_residue = 0;
+         selected_residue < frame.residue_count(); ++selected_residue) {
+        auto residue_id = frame.residue(selected_residue).id();
+
+        if (!residue_id || resis.count(*residue_id) == 0) {
+            continue;
+        }
+
+        selection.insert(selection.end(), selected_residue);
+    }
+
+    return selection;
+}
+
 //! Select residues with a given name in a given frame
 //!
 //! This function returns a set of residue locations within a given name set
@@ -206,15 +272,18 @@ inline Container residue_ids(const chemfiles::Frame& frame,
 template <typename Container = std::vector<uint64_t>>
 inline Container specific_residues(const chemfiles::Frame& frame,
                                    const ResidueNameSet& resnames) {
+    return query(frame).in(resnames).template select<Container>();
+}
 
-    const auto& residues = frame.topology().residues();
+//! Select residues with a given name in a given `FrameView`
+template <typename Container = std::vector<uint64_t>>
+inline Container specific_residues(const FrameView& frame,
+                                   const ResidueNameSet& resnames) {
     Container selection;
 
-    for (size_t selected_residue = 0; selected_residue < residues.size();
-         ++selected_residue) {
-        const auto& residue = residues[selected_residue];
-
-        if (resnames.count({residue.name()}) == 0) {
+    for (size_t selected_residue = 0;
+         selected_residue < frame.residue_count(); ++selected_residue) {
+        if (resnames.count({frame.residue(selected_residue).name()}) == 0) {
             continue;
         }
 
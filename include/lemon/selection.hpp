@@ -0,0 +1,330 @@
+#ifndef LEMON_SELECTION_HPP
+#define LEMON_SELECTION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+#include "lemon/bits.hpp"
+#include "lemon/frame_view.hpp"
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/Frame.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! A set of residue or atom indexes stored as one bit per index
+//!
+//! A `Selection` can be used in place of a `std::vector` or `std::list` of
+//! residue indexes with the functions of the `select`, `prune` and `count`
+//! namespaces. It iterates over its indexes in increasing order. Adding,
+//! removing and finding an index takes a constant time, and the union,
+//! intersection and difference of two selections work on 64 indexes at once.
+//! The storage grows when an index past its end is added.
+class Selection {
+  public:
+    //! Iterates over the selected indexes, in increasing order
+    class const_iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const size_t*;
+        using reference = size_t;
+
+        const_iterator() = default;
+
+        reference operator*() const { return index_; }
+
+        const_iterator& operator++() {
+            index_ = selection_->next_(index_ + 1);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return index_ != other.index_;
+        }
+
+      private:
+        friend class Selection;
+        const_iterator(const Selection* selection, size_t index)
+            : selection_(selection), index_(index) {}
+
+        const Selection* selection_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    using iterator = const_iterator;
+    using value_type = size_t;
+    using size_type = size_t;
+
+    //! Create an empty selection
+    Selection() = default;
+
+    //! Create an empty selection with room for the indexes below `bound`
+    explicit Selection(size_t bound) : words_((bound + 63) / 64, 0) {}
+
+    //! Create a selection of `indexes`
+    Selection(std::initializer_list<size_t> indexes) {
+        for (auto index : indexes) {
+            insert(index);
+        }
+    }
+
+    //! Create a selection of the indexes in `container`
+    template <typename Container>
+    static Selection from(const Container& container) {
+        Selection selection;
+        for (auto index : container) {
+            selection.insert(static_cast<size_t>(index));
+        }
+        return selection;
+    }
+
+    //! Select all indexes below `bound`
+    static Selection all(size_t bound) {
+        Selection selection(bound);
+        for (size_t word = 0; word < bound / 64; ++word) {
+            selection.words_[word] = ~uint64_t(0);
+        }
+        if (bound % 64 != 0) {
+            selection.words_.back() = (uint64_t(1) << (bound % 64)) - 1;
+        }
+        selection.count_ = bound;
+        return selection;
+    }
+
+    //! The number of selected indexes
+    size_t size() const { return count_; }
+
+    //! Check if no index is selected
+    bool empty() const { return count_ == 0; }
+
+    //! One past the largest index which can be stored without growing
+    size_t bound() const { return 64 * words_.size(); }
+
+    //! Check if `index` is selected
+    bool contains(size_t index) const {
+        return index / 64 < words_.size() &&
+               (words_[index / 64] >> (index % 64) & 1) != 0;
+    }
+
+    //! The number of times `index` is selected, zero or one
+    size_t count(size_t index) const { return contains(index) ? 1 : 0; }
+
+    //! Select `index`
+    void insert(size_t index) {
+        if (index / 64 >= words_.size()) {
+            words_.resize(index / 64 + 1, 0);
+        }
+
+        auto& word = words_[index / 64];
+        auto bit = uint64_t(1) << (index % 64);
+        if ((word & bit) == 0) {
+            word |= bit;
+            ++count_;
+        }
+    }
+
+    //! Select `index`. The position is ignored, as the indexes are sorted.
+    const_iterator insert(const_iterator /*unused*/, size_t index) {
+        insert(index);
+        return {this, index};
+    }
+
+    //! Unselect `index`
+    void erase(size_t index) {
+        if (index / 64 >= words_.size()) {
+            return;
+        }
+
+        auto& word = words_[index / 64];
+        auto bit = uint64_t(1) << (index % 64);
+        if ((word & bit) != 0) {
+            word &= ~bit;
+            --count_;
+        }
+    }
+
+    //! Unselect all indexes
+    void clear() {
+        std::fill(words_.begin(), words_.end(), 0);
+        count_ = 0;
+    }
+
+    //! Unselect the indexes for which `predicate` returns true
+    template <typename Predicate> void remove_if(Predicate&& predicate) {
+        for (size_t word = 0; word < words_.size(); ++word) {
+            auto bits = words_[word];
+            while (bits != 0) {
+                auto bit = trailing_zeros(bits);
+                bits &= bits - 1;
+                if (predicate(64 * word + bit)) {
+                    words_[word] &= ~(uint64_t(1) << bit);
+                    --count_;
+                }
+            }
+        }
+    }
+
+    //! The first selected index
+    const_iterator begin() const { return {this, next_(0)}; }
+
+    //! One past the last selected index
+    const_iterator end() const { return {this, bound()}; }
+
+    //! Select the indexes selected in `other` too
+    Selection& operator|=(const Selection& other) {
+        if (other.words_.size() > words_.size()) {
+            words_.resize(other.words_.size(), 0);
+        }
+        for (size_t word = 0; word < other.words_.size(); ++word) {
+            words_[word] |= other.words_[word];
+        }
+        recount_();
+        return *this;
+    }
+
+    //! Keep only the indexes also selected in `other`
+    Selection& operator&=(const Selection& other) {
+        auto common = std::min(words_.size(), other.words_.size());
+        for (size_t word = 0; word < common; ++word) {
+            words_[word] &= other.words_[word];
+        }
+        std::fill(words_.begin() + static_cast<std::ptrdiff_t>(common),
+                  words_.end(), 0);
+        recount_();
+        return *this;
+    }
+
+    //! Unselect the indexes selected in `other`
+    Selection& operator-=(const Selection& other) {
+        auto common = std::min(words_.size(), other.words_.size());
+        for (size_t word = 0; word < common; ++word) {
+            words_[word] &= ~other.words_[word];
+        }
+        recount_();
+        return *this;
+    }
+
+    //! The indexes selected in either selection
+    friend Selection operator|(Selection lhs, const Selection& rhs) {
+        return lhs |= rhs;
+    }
+
+    //! The indexes selected in both selections
+    friend Selection operator&(Selection lhs, const Selection& rhs) {
+        return lhs &= rhs;
+    }
+
+    //! The indexes selected in `lhs` but not in `rhs`
+    friend Selection operator-(Selection lhs, const Selection& rhs) {
+        return lhs -= rhs;
+    }
+
+    //! Check if both selections contain the same indexes
+    friend bool operator==(const Selection& lhs, const Selection& rhs) {
+        const auto& small = lhs.words_.size() < rhs.words_.size() ? lhs : rhs;
+        const auto& large = lhs.words_.size() < rhs.words_.size() ? rhs : lhs;
+        for (size_t word = 0; word < large.words_.size(); ++word) {
+            auto other = word < small.words_.size() ? small.words_[word] : 0;
+            if (large.words_[word] != other) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Check if the selections contain different indexes
+    friend bool operator!=(const Selection& lhs, const Selection& rhs) {
+        return !(lhs == rhs);
+    }
+
+    //! The atoms of the selected residues of `frame`
+    Selection atoms(const chemfiles::Frame& frame) const {
+        const auto& residues = frame.topology().residues();
+        Selection result(frame.size());
+        for (auto residue : *this) {
+            for (auto atom : residues[residue]) {
+                result.insert(atom);
+            }
+        }
+        return result;
+    }
+
+    //! The atoms of the selected residues of a `FrameView`
+    Selection atoms(const FrameView& frame) const {
+        Selection result(frame.size());
+        for (auto residue : *this) {
+            for (auto atom : frame.residue(residue)) {
+                result.insert(atom);
+            }
+        }
+        return result;
+    }
+
+  private:
+    // The first selected index from `index`, or `bound()` if none
+    size_t next_(size_t index) const {
+        auto word = index / 64;
+        if (word >= words_.size()) {
+            return bound();
+        }
+
+        auto bits = words_[word] & (~uint64_t(0) << (index % 64));
+        while (bits == 0) {
+            if (++word == words_.size()) {
+                return bound();
+            }
+            bits = words_[word];
+        }
+        return 64 * word + trailing_zeros(bits);
+    }
+
+    void recount_() {
+        count_ = 0;
+        for (auto word : words_) {
+            count_ += popcount(word);
+        }
+    }
+
+    std::vector<uint64_t> words_;
+    size_t count_ = 0;
+};
+
+//! Remove the residues for which `predicate` returns true from `residue_ids`
+//!
+//! Works with the sequence containers of the standard library and with
+//! `Selection`.
+template <typename Container, typename Predicate>
+inline void remove_residues_if(Container& residue_ids, Predicate predicate) {
+    residue_ids.erase(
+        std::remove_if(residue_ids.begin(), residue_ids.end(), predicate),
+        residue_ids.end());
+}
+
+//! Remove the residues for which `predicate` returns true from a `Selection`
+template <typename Predicate>
+inline void remove_residues_if(Selection& residue_ids, Predicate predicate) {
+    residue_ids.remove_if(predicate);
+}
+
+} // namespace lemon
+
+#endif
@@ -1,9 +1,12 @@
 #ifndef LEMON_SEPARATE_HPP
 #define LEMON_SEPARATE_HPP
 
+#include <algorithm>
+#include <iterator>
 #include <list>
 #include <set>
 #include <unordered_set>
+#include <vector>
 
 #include "lemon/external/gaurd.hpp"
 
@@ -12,6 +15,11 @@ LEMON_EXTERNAL_FILE_PUSH
 #include <chemfiles/Topology.hpp>
 LEMON_EXTERNAL_FILE_POP
 
+#include "lemon/atom_grid.hpp"
+#include "lemon/frame_index.hpp"
+#include "lemon/frame_view.hpp"
+#include "lemon/selection.hpp"
+
 namespace lemon {
 
 //! Separate entry frames into corresponding sub-frames
@@ -37,8 +45,9 @@ inline void residues(const chemfiles::Frame& entry,
     const auto& old_bonds = entry.topology().bonds();
     const auto& bond_ord = entry.topology().bond_orders();
 
-    std::unordered_map<size_t, size_t> old_to_new;
-    std::unordered_set<size_t> accepted_atoms;
+    // The new index of the copied atoms, one past the last atom if not copied
+    std::vector<size_t> old_to_new(entry.size(), entry.size());
+    Selection accepted_atoms(entry.size());
     for (auto res_id : accepted_residues) {
         const auto& res = residues[res_id];
 
@@ -53,7 +62,71 @@ inline void residues(const chemfiles::Frame& entry,
 
             new_frame.add_atom(entry[res_atom], positions[res_atom]);
             res_new.add_atom(new_frame.size() - 1);
-            old_to_new.insert({res_atom, new_frame.size() - 1});
+            old_to_new[res_atom] = new_frame.size() - 1;
+            accepted_atoms.insert(res_atom);
+        }
+
+        for (const auto& prop : res.properties()) {
+            if (prop.first == "chainid") {
+                res_new.set(prop.first, std::string(1, prop.second.as_string()[0]));
+                continue;
+            }
+            res_new.set(prop.first, prop.second);
+        }
+
+        new_frame.add_residue(std::move(res_new));
+    }
+
+    for (size_t bond_idx = 0; bond_idx < old_bonds.size(); ++bond_idx) {
+        if (accepted_atoms.contains(old_bonds[bond_idx][0]) &&
+            accepted_atoms.contains(old_bonds[bond_idx][1])) {
+
+            new_frame.add_bond(old_to_new[old_bonds[bond_idx][0]],
+                               old_to_new[old_bonds[bond_idx][1]],
+                               bond_ord[bond_idx]);
+        }
+    }
+}
+
+//! Copy residues into a frame, using the alternative locations stored in a
+//! `FrameIndex`
+//!
+//! \param [in] index The index of the frame from where the residues will be
+//! copied.
+//! \param [in] accepted_residues The residue IDs for the residues to be copied.
+//! \param [in,out] new_frame The frame where the residues wil be copied to.
+template <typename Container>
+inline void residues(const FrameIndex& index,
+                     const Container& accepted_residues,
+                     chemfiles::Frame& new_frame,
+                     const std::string& use_altloc = "A") {
+
+    const auto& entry = index.frame();
+    const auto& altlocs = index.tables().altlocs();
+    const auto& residues = entry.topology().residues();
+    const auto& positions = entry.positions();
+    const auto& old_bonds = entry.topology().bonds();
+    const auto& bond_ord = entry.topology().bond_orders();
+
+    // The new index of the copied atoms, one past the last atom if not copied
+    std::vector<size_t> old_to_new(entry.size(), entry.size());
+    Selection accepted_atoms(entry.size());
+    for (auto res_id : accepted_residues) {
+        const auto& res = residues[res_id];
+
+        auto res_new = chemfiles::Residue(res.name(), *(res.id()));
+
+        for (size_t res_atom : res) {
+
+            auto altloc = altlocs[res_atom];
+            if (altloc != ' ' &&
+                (use_altloc.size() != 1 || altloc != use_altloc[0])) {
+                continue;
+            }
+
+            new_frame.add_atom(entry[res_atom], positions[res_atom]);
+            res_new.add_atom(new_frame.size() - 1);
+            old_to_new[res_atom] = new_frame.size() - 1;
             accepted_atoms.insert(res_atom);
         }
 
@@ -69,8 +142,8 @@ inline void residues(const chemfiles::Frame& entry,
     }
 
     for (size_t bond_idx = 0; bond_idx < old_bonds.size(); ++bond_idx) {
-        if (accepted_atoms.count(old_bonds[bond_idx][0]) &&
-            accepted_atoms.count(old_bonds[bond_idx][1])) {
+        if (accepted_atoms.contains(old_bonds[bond_idx][0]) &&
+            accepted_atoms.contains(old_bonds[bond_idx][1])) {
 
             new_frame.add_bond(old_to_new[old_bonds[bond_idx][0]],
                                old_to_new[old_bonds[bond_idx][1]],
@@ -79,6 +152,156 @@ inline void residues(const chemfiles::Frame& entry,
     }
 }
 
+//! Copy residues from a `FrameView` into a frame
+//!
+//! The copied atoms and residues only have the properties stored in the
+//! `FrameView`.
+//! \param [in] entry The view from where the residues will be copied.
+//! \param [in] accepted_residues The residue IDs for the residues to be copied.
+//! \param [in,out] new_frame The frame where the residues wil be copied to.
+template <typename Container>
+inline void residues(const FrameView& entry,
+                     const Container& accepted_residues,
+                     chemfiles::Frame& new_frame,
+                     const std::string& use_altloc = "A") {
+
+    std::vector<size_t> old_to_new(entry.size(), entry.size());
+    std::vector<size_t> copied_atoms;
+    for (auto res_id : accepted_residues) {
+        auto res = entry.residue(res_id);
+        auto id = res.id();
+
+        auto res_new = id ? chemfiles::Residue(res.name(), *id)
+                          : chemfiles::Residue(res.name());
+
+        for (size_t res_atom : res) {
+            auto altloc = entry.altloc(res_atom);
+            if (altloc != ' ' && std::string(1, altloc) != use_altloc) {
+                continue;
+            }
+
+            auto atom = chemfiles::Atom(entry.atom_name(res_atom),
+                                        entry.atom_type(res_atom));
+            atom.set_charge(static_cast<double>(entry.charge(res_atom)));
+            if (altloc != ' ') {
+                atom.set("altloc", std::string(1, altloc));
+            }
+
+            const auto* position = entry.position(res_atom);
+            new_frame.add_atom(std::move(atom),
+                               {static_cast<double>(position[0]),
+                                static_cast<double>(position[1]),
+                                static_cast<double>(position[2])});
+            res_new.add_atom(new_frame.size() - 1);
+            old_to_new[res_atom] = new_frame.size() - 1;
+            copied_atoms.push_back(res_atom);
+        }
+
+        auto composition_type = res.composition_type();
+        if (!composition_type.empty()) {
+            res_new.set("composition_type", composition_type);
+        }
+
+        auto chainname = res.chainname();
+        if (!chainname.empty()) {
+            res_new.set("chainname", chainname);
+        }
+
+        auto chainid = res.chainid();
+        if (!chainid.empty()) {
+            res_new.set("chainid", std::string(1, chainid[0]));
+        }
+
+        auto assembly = res.assembly();
+        if (!assembly.empty()) {
+            res_new.set("assembly", assembly);
+        }
+
+        new_frame.add_residue(std::move(res_new));
+    }
+
+    for (auto old_atom : copied_atoms) {
+        const auto* first = entry.bonded_begin(old_atom);
+        for (auto it = first; it != entry.bonded_end(old_atom); ++it) {
+            auto other = old_to_new[*it];
+            if (*it <= old_atom || other == entry.size()) {
+                continue;
+            }
+
+            new_frame.add_bond(old_to_new[old_atom], other,
+                               entry.bond_order(old_atom, static_cast<size_t>(
+                                                              it - first)));
+        }
+    }
+}
+
+//! The residues with an atom closer than `pocket_size` to an atom of the
+//! ligands, using the spheres and grid stored in `index`
+//!
+//! The ligands and residues named *UNX* or *UNL* are not included. All
+//! residues with atoms are included if `pocket_size` is not positive.
+template <typename Container>
+inline std::list<size_t> pocket(const FrameIndex& index,
+                                const Container& ligand_ids,
+                                double pocket_size) {
+    const auto& frame = index.frame();
+    const auto& residues = frame.topology().residues();
+
+    std::vector<char> is_ligand(index.residue_count() + 1, 0);
+    bool any_atom = false;
+    for (auto lig_res : ligand_ids) {
+        is_ligand[lig_res] = 1;
+        any_atom = any_atom || residues[lig_res].size() != 0;
+    }
+
+    std::list<size_t> accepted_residues;
+    if (!any_atom) {
+        return accepted_residues;
+    }
+
+    const auto& residue_of = index.tables().residue_of();
+    auto near = [&](size_t prot_atom) {
+        return index.neighbors(prot_atom, pocket_size,
+            [&](size_t lig_atom) {
+                return is_ligand[residue_of[lig_atom]] != 0 &&
+                       frame.distance(prot_atom, lig_atom) < pocket_size;
+            });
+    };
+
+    for (size_t res_id = 0; res_id < residues.size(); ++res_id) {
+        const auto& res = residues[res_id];
+
+        // Do some cleaning up here
+        if (res.name() == "UNX" || res.name() == "UNL") {
+            continue;
+        }
+
+        if (is_ligand[res_id] != 0 || res.size() == 0) {
+            continue;
+        }
+
+        if (pocket_size <= 0) {
+            accepted_residues.push_back(res_id);
+            continue;
+        }
+
+        auto close = std::any_of(std::begin(ligand_ids), std::end(ligand_ids),
+            [&](size_t lig_res) {
+                return index.spheres().may_interact(frame, res_id, lig_res,
+                                                    pocket_size);
+            });
+        if (!close) {
+            continue;
+        }
+
+        if (std::any_of(res.begin(), res.end(), near)) {
+            accepted_residues.push_back(res_id);
+        }
+    }
+
+    return accepted_residues;
+}
+
 //! Separate a ligand and surrounding protein pocket into individual frames.
 //!
 //! The environment surrounding a ligand in a protein defines the *environment*
@@ -101,6 +324,16 @@ inline void protein_and_ligand(const chemfiles::Frame& entry, size_t ligand_id,
     const auto& residues = topology.residues();
     const auto& ligand_residue = residues[ligand_id];
 
+    // Only the residues whose bounding sphere is near the ligand are compared
+    // with the atoms of the ligand close to them
+    ResidueSpheres spheres(entry);
+    std::vector<size_t> ligand_atoms(ligand_residue.begin(),
+                                     ligand_residue.end());
+    AtomGrid grid;
+    if (pocket_size > 0 && !ligand_atoms.empty()) {
+        grid = AtomGrid(entry, ligand_atoms, pocket_size);
+    }
+
     std::list<size_t> accepted_residues;
     for (size_t res_id = 0; res_id < residues.size(); ++res_id) {
         if (res_id == ligand_id) {
@@ -114,16 +347,23 @@ inline void protein_and_ligand(const chemfiles::Frame& entry, size_t ligand_id,
             continue;
         }
 
+        if (pocket_size <= 0) {
+            if (res.size() != 0 && !ligand_atoms.empty()) {
+                accepted_residues.push_back(res_id);
+            }
+            continue;
+        }
+
+        if (!spheres.may_interact(entry, res_id, ligand_id, pocket_size)) {
+            continue;
+        }
+
         for (auto prot_atom : res) {
-            for (auto lig_atom : ligand_residue) {
-                if (pocket_size <= 0 ||
-                    entry.distance(prot_atom, lig_atom) < pocket_size) {
-                    accepted_residues.push_back(res_id);
-                    goto found_interaction;
-                }
+            if (grid.any_within(entry, prot_atom, pocket_size)) {
+                accepted_residues.push_back(res_id);
+                break;
             }
         }
-    found_interaction:;
     }
 
     lemon::separate::residues(entry, accepted_residues, protein, altloc);
@@ -132,6 +372,97 @@ inline void protein_and_ligand(const chemfiles::Frame& entry, size_t ligand_id,
     ligand.set("name", ligand_residue.name());
 }
 
+//! Separate a ligand and surrounding protein pocket of a `FrameView`
+//!
+//! \param [in] entry The view from where the residues will be copied.
+//! \param [in] ligand_id The residue ID for the ligand.
+//! \param [in] pocket_size The radius of the ligand environment copied into
+//! protein
+//! \param [in,out] protein The frame where the protein residues wil be
+//! copied to.
+//! \param [in,out] ligand The frame where the ligand residue will be
+//! copied to.
+inline void protein_and_ligand(const FrameView& entry, size_t ligand_id,
+                               double pocket_size, chemfiles::Frame& protein,
+                               chemfiles::Frame& ligand,
+                               const std::string& altloc = "A"
+                               ) {
+    auto ligand_residue = entry.residue(ligand_id);
+
+    ResidueSpheres spheres(entry);
+    std::vector<size_t> ligand_atoms(ligand_residue.begin(),
+                                     ligand_residue.end());
+    AtomGrid grid;
+    if (pocket_size > 0 && !ligand_atoms.empty()) {
+        grid = AtomGrid(entry, ligand_atoms, pocket_size);
+    }
+
+    std::list<size_t> accepted_residues;
+    for (size_t res_id = 0; res_id < entry.residue_count(); ++res_id) {
+        if (res_id == ligand_id) {
+            continue;
+        }
+
+        auto res = entry.residue(res_id);
+
+        // Do some cleaning up here
+        auto name = res.name();
+        if (name == "UNX" || name == "UNL") {
+            continue;
+        }
+
+        if (pocket_size <= 0) {
+            if (res.size() != 0 && !ligand_atoms.empty()) {
+                accepted_residues.push_back(res_id);
+            }
+            continue;
+        }
+
+        if (!spheres.may_interact(entry, res_id, ligand_id, pocket_size)) {
+            continue;
+        }
+
+        for (auto prot_atom : res) {
+            if (grid.any_within(entry, prot_atom, pocket_size)) {
+                accepted_residues.push_back(res_id);
+                break;
+            }
+        }
+    }
+
+    lemon::separate::residues(entry, accepted_residues, protein, altloc);
+    lemon::separate::residues(entry, std::list<size_t>({ligand_id}), ligand, altloc);
+
+    ligand.set("name", ligand_residue.name());
+}
+
+//! Separate a ligand and surrounding protein pocket, using the spheres and
+//! grid stored in a `FrameIndex`
+//!
+//! \param [in] index The index of the frame from where the residues will be
+//! copied.
+//! \param [in] ligand_id The residue ID for the ligand.
+//! \param [in] pocket_size The radius of the ligand environment copied into
+//! protein
+//! \param [in,out] protein The frame where the protein residues wil be
+//! copied to.
+//! \param [in,out] ligand The frame where the ligand residue will be
+//! copied to.
+inline void protein_and_ligand(const FrameIndex& index, size_t ligand_id,
+                               double pocket_size, chemfiles::Frame& protein,
+                               chemfiles::Frame& ligand,
+                               const std::string& altloc = "A"
+                               ) {
+    std::vector<size_t> ligand_ids = {ligand_id};
+    auto accepted_residues = pocket(index, ligand_ids, pocket_size);
+
+    lemon::separate::residues(index, accepted_residues, protein, altloc);
+    lemon::separate::residues(index, ligand_ids, ligand, altloc);
+
+    const auto& residues = index.frame().topology().residues();
+    ligand.set("name", residues[ligand_id].name());
+}
+
 //! Separate ligands and surrounding protein pocket into individual frames.
 //!
 //! The environment surrounding ligands in a protein defines the *environment*
@@ -154,6 +485,21 @@ inline void protein_and_ligands(const chemfiles::Frame& entry,
     const auto& topology = entry.topology();
     const auto& residues = topology.residues();
 
+    // Only the residues whose bounding sphere is near one of the ligands are
+    // compared with the atoms of the ligands close to them
+    ResidueSpheres spheres(entry);
+    std::set<size_t> ligand_set(std::begin(ligand_ids), std::end(ligand_ids));
+    std::vector<size_t> ligand_atoms;
+    for (auto lig_res : ligand_set) {
+        const auto& lig = residues[lig_res];
+        ligand_atoms.insert(ligand_atoms.end(), lig.begin(), lig.end());
+    }
+
+    AtomGrid grid;
+    if (pocket_size > 0 && !ligand_atoms.empty()) {
+        grid = AtomGrid(entry, ligand_atoms, pocket_size);
+    }
+
     std::list<size_t> accepted_residues;
     for (size_t res_id = 0; res_id < residues.size(); ++res_id) {
         const auto& res = residues[res_id];
@@ -163,30 +509,133 @@ inline void protein_and_ligands(const chemfiles::Frame& entry,
             continue;
         }
 
-        for (auto lig_res : ligand_ids) {
-            if (lig_res == res_id) {
-                goto found_interaction;
+        if (ligand_set.count(res_id) != 0) {
+            continue;
+        }
+
+        if (pocket_size <= 0) {
+            if (res.size() != 0 && !ligand_atoms.empty()) {
+                accepted_residues.push_back(res_id);
             }
+            continue;
+        }
+
+        auto near = std::any_of(ligand_set.begin(), ligand_set.end(),
+            [&](size_t lig_res) {
+                return spheres.may_interact(entry, res_id, lig_res,
+                                            pocket_size);
+            });
+        if (!near) {
+            continue;
         }
 
-        for (auto lig_res : ligand_ids) {
-            for (auto prot_atom : res) {
-                for (auto lig_atom : residues[lig_res]) {
-                    if (pocket_size <= 0 ||
-                        entry.distance(prot_atom, lig_atom) < pocket_size) {
-                        accepted_residues.push_back(res_id);
-                        goto found_interaction;
-                    }
-                }
+        for (auto prot_atom : res) {
+            if (grid.any_within(entry, prot_atom, pocket_size)) {
+                accepted_residues.push_back(res_id);
+                break;
             }
         }
-    found_interaction:;
     }
 
     lemon::separate::residues(entry, accepted_residues, protein);
     lemon::separate::residues(entry, ligand_ids, ligand, altloc);
 }
 
+//! Separate ligands and surrounding protein pocket of a `FrameView`
+//!
+//! \param [in] entry The view from where the residues will be copied.
+//! \param [in] ligand_ids The residue IDs for the ligand.
+//! \param [in] pocket_size The radius of the ligand environment copied into
+//! protein
+//! \param [in,out] protein The frame where the protein residues wil be
+//! copied to.
+//! \param [in,out] ligand The frame where the ligand residue will be
+//! copied to.
+template <typename Container>
+inline void protein_and_ligands(const FrameView& entry,
+                                const Container& ligand_ids,
+                                double pocket_size, chemfiles::Frame& protein,
+                                chemfiles::Frame& ligand,
+                                const std::string& altloc = "A") {
+    ResidueSpheres spheres(entry);
+    std::set<size_t> ligand_set(std::begin(ligand_ids), std::end(ligand_ids));
+    std::vector<size_t> ligand_atoms;
+    for (auto lig_res : ligand_set) {
+        auto lig = entry.residue(lig_res);
+        ligand_atoms.insert(ligand_atoms.end(), lig.begin(), lig.end());
+    }
+
+    AtomGrid grid;
+    if (pocket_size > 0 && !ligand_atoms.empty()) {
+        grid = AtomGrid(entry, ligand_atoms, pocket_size);
+    }
+
+    std::list<size_t> accepted_residues;
+    for (size_t res_id = 0; res_id < entry.residue_count(); ++res_id) {
+        auto res = entry.residue(res_id);
+
+        // Do some cleaning up here
+        auto name = res.name();
+        if (name == "UNX" || name == "UNL") {
+            continue;
+        }
+
+        if (ligand_set.count(res_id) != 0) {
+            continue;
+        }
+
+        if (pocket_size <= 0) {
+            if (res.size() != 0 && !ligand_atoms.empty()) {
+                accepted_residues.push_back(res_id);
+            }
+            continue;
+        }
+
+        auto near = std::any_of(ligand_set.begin(), ligand_set.end(),
+            [&](size_t lig_res) {
+                return spheres.may_interact(entry, res_id, lig_res,
+                                            pocket_size);
+            });
+        if (!near) {
+            continue;
+        }
+
+        for (auto prot_atom : res) {
+            if (grid.any_within(entry, prot_atom, pocket_size)) {
+                accepted_residues.push_back(res_id);
+                break;
+            }
+        }
+    }
+
+    lemon::separate::residues(entry, accepted_residues, protein);
+    lemon::separate::residues(entry, ligand_ids, ligand, altloc);
+}
+
+//! Separate ligands and surrounding protein pocket, using the spheres and
+//! grid stored in a `FrameIndex`
+//!
+//! \param [in] index The index of the frame from where the residues will be
+//! copied.
+//! \param [in] ligand_ids The residue IDs for the ligand.
+//! \param [in] pocket_size The radius of the ligand environment copied into
+//! protein
+//! \param [in,out] protein The frame where the protein residues wil be
+//! copied to.
+//! \param [in,out] ligand The frame where the ligand residue will be
+//! copied to.
+template <typename Container>
+inline void protein_and_ligands(const FrameIndex& index,
+                                const Container& ligand_ids,
+                                double pocket_size, chemfiles::Frame& protein,
+                                chemfiles::Frame& ligand,
+                                const std::string& altloc = "A") {
+    auto accepted_residues = pocket(index, ligand_ids, pocket_size);
+
+    lemon::separate::residues(index, accepted_residues, protein);
+    lemon::separate::residues(index, ligand_ids, ligand, altloc);
+}
+
 } // namespace separate
 
 } // namespace lemon
@@ -0,0 +1,262 @@
+#ifndef LEMON_STRUCTURE_CACHE_HPP
+#define LEMON_STRUCTURE_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "lemon/archive.hpp"
+#include "lemon/bounded_queue.hpp"
+#include "lemon/entries.hpp"
+#include "lemon/frame_view.hpp"
+#include "lemon/pack.hpp"
+#include "lemon/thread_pool.hpp"
+#include "lemon/work_stealing.hpp"
+
+namespace lemon {
+
+//! The `StructureCache` class reads a directory of parsed structures.
+//!
+//! Parsing MMTF records into `chemfiles::Frame`s is the most expensive part of
+//! most workflows. A structure cache stores every structure of the PDB already
+//! parsed, in the columns read by `FrameView`, so that workflows which search
+//! the same copy of the PDB many times only parse it once. The cache is
+//! created by `build_structure_cache` (or the `lm_cache` program) and uses the
+//! same container as the pack files, with the `.lmcache` extension. The cache
+//! files are mapped into memory, so several processes on the same machine
+//! share a single copy of the cache.
+class StructureCache {
+  public:
+    //! The extension of the structure cache files
+    static constexpr const char* EXTENSION = ".lmcache";
+
+    //! Open the structure cache in the directory `p`.
+    //!
+    //! \throws std::runtime_error if there is no structure cache in `p`.
+    explicit StructureCache(const std::string& p) : pack_(p, EXTENSION) {}
+
+    //! The cache files in the directory.
+    const std::vector<std::string>& files() const { return pack_.files(); }
+
+    //! All structures in the cache, in the order they appear on disk.
+    const std::vector<ArchiveRecord>& records() const {
+        return pack_.records();
+    }
+
+    //! The number of structures in the cache.
+    size_t size() const { return pack_.size(); }
+
+    //! Returns true if the cache contains a structure for `pdbid`.
+    bool contains(const std::string& pdbid) const {
+        return pack_.contains(pdbid);
+    }
+
+    //! Select the structures for the given entries.
+    //!
+    //! \param [in] entries Which entries to use. All structures if blank.
+    //! \param [in] skip_entries Which entries to skip. Not used if blank.
+    //! \return The selected structures, in the order they appear on disk.
+    std::vector<const ArchiveRecord*>
+    select(const Entries& entries = Entries(),
+           const Entries& skip_entries = Entries()) const {
+        return pack_.select(entries, skip_entries);
+    }
+
+    //! A view of a structure. It is valid for the lifetime of the cache.
+    FrameView view(const ArchiveRecord& record) const {
+        auto data = pack_.data(record);
+        return FrameView(data.data(), data.size());
+    }
+
+    //! A view of the structure with the given PDB ID.
+    //!
+    //! \throws std::out_of_range if the entry is not in the cache.
+    FrameView get(const std::string& pdbid) const {
+        auto data = pack_.data(pdbid);
+        return FrameView(data.data(), data.size());
+    }
+
+  private:
+    Pack pack_;
+};
+
+//! Returns true if the directory at `p` contains a structure cache.
+inline bool is_structure_cache_dir(const std::string& p) {
+    return !read_pack_dir(p, StructureCache::EXTENSION).empty();
+}
+
+//! Parse the PDB once and store it as a `StructureCache`.
+//!
+//! The entries are read from either the Hadoop sequence files or pack files in
+//! `input`. Each of the `ncpu` threads writes one cache file in `output`, and
+//! threads which finish early steal entries from the others. Entries which
+//! cannot be parsed are skipped.
+//! \param [in] input A directory of Hadoop sequence files or pack files.
+//! \param [in] output The directory to write the cache to.
+//! \param [in] ncpu The number of threads to use.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+//! \return The number of structures in the cache.
+//! \throws std::runtime_error if `output` already contains a cache or the
+//!  cache cannot be written.
+inline size_t build_structure_cache(const std::string& input,
+                                    const std::string& output,
+                                    size_t ncpu = 1,
+                                    const Entries& entries = Entries(),
+                                    const Entries& skip_entries = Entries()) {
+    if (is_structure_cache_dir(output)) {
+        throw std::runtime_error(output + " already contains a cache");
+    }
+
+    std::unique_ptr<Pack> pack;
+    std::unique_ptr<Archive> archive;
+    std::vector<const ArchiveRecord*> records;
+    const char* format = "MMTF/GZ";
+    if (is_pack_dir(input)) {
+        pack.reset(new Pack(input));
+        records = pack->select(entries, skip_entries);
+        format = Pack::FORMAT;
+    } else {
+        archive.reset(new Archive(input));
+        records = archive->select(entries, skip_entries);
+    }
+
+    ncpu = std::max<size_t>(1, std::min(ncpu, records.size()));
+    work_stealing_queue<const ArchiveRecord*> jobs(ncpu);
+    for (size_t i = 0; i < records.size(); ++i) {
+        jobs.push(i * ncpu / records.size(), records[i]);
+    }
+
+    std::vector<std::exception_ptr> errors(ncpu);
+    std::vector<size_t> written(ncpu, 0);
+
+    auto cache_records = [&](size_t index) {
+        try {
+            std::ostringstream name;
+            name << output << "/part-" << std::setw(5) << std::setfill('0')
+                 << index << StructureCache::EXTENSION;
+            PackWriter writer(name.str());
+
+            std::vector<char> buffer;
+            while (auto next = jobs.pop(index)) {
+                const auto& record = **next;
+                auto value = pack ? pack->data(record) : archive->data(record);
+
+                try {
+                    auto traj = chemfiles::Trajectory::memory_reader(
+                        value.data(), value.size(), format);
+                    write_frame_view(traj.read(), buffer);
+                } catch (...) {
+                    continue;
+                }
+
+                writer.add(record.pdbid, buffer.data(), buffer.size());
+            }
+
+            writer.finish();
+            written[index] = writer.size();
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    };
+
+    {
+        // Destroyed once all files are written
+        thread_pool pool(ncpu);
+        for (size_t i = 0; i < ncpu; ++i) {
+            pool.queue_task([&cache_records, i] { cache_records(i); });
+        }
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t total = 0;
+    for (auto count : written) {
+        total += count;
+    }
+    return total;
+}
+
+//! The `run_cached` function runs a workflow on a `StructureCache`.
+//!
+//! This function is the equivalent of `run_parallel` for a structure cache.
+//! The `worker` accepts a `FrameView` instead of a `chemfiles::Frame` and a
+//! `std::string` containing the PDB ID. As nothing is parsed, the speed of a
+//! workflow is only limited by the `worker` and the memory bandwidth. As in
+//! `run_parallel`, threads steal structures from each other and the results
+//! are passed to the `collector` on the calling thread while the workers run.
+//! \param worker A function object (C++11 lambda, struct the with operator()
+//!  overloaded, or std::function object) that the user wishes to apply.
+//! \param [in] p A path to the directory containing the structure cache.
+//! \param collector A function object that handles the output of `worker`.
+//! \param [in] ncpu The number of threads to use.
+//! \param [in] entries Which entries to use. Not used if blank.
+//! \param [in] skip_entries Which entries to skip. Not used if blank.
+template <typename Function, typename Collector>
+inline void run_cached(Function&& worker, const std::string& p,
+                       Collector& collector, size_t ncpu = 1,
+                       const Entries& entries = Entries(),
+                       const Entries& skip_entries = Entries()) {
+    using ret = typename std::result_of<Function&(const FrameView&,
+                                                  const std::string&)>::type;
+
+    StructureCache cache(p);
+    auto records = cache.select(entries, skip_entries);
+
+    ncpu = std::max<size_t>(ncpu, 1);
+    work_stealing_queue<const ArchiveRecord*> jobs(ncpu);
+    for (size_t i = 0; i < records.size(); ++i) {
+        jobs.push(i * ncpu / records.size(), records[i]);
+    }
+
+    // Only a few results per thread wait for the collector
+    bounded_queue<ret> results(4 * ncpu);
+    std::atomic<size_t> running(ncpu);
+
+    auto call_function = [&](size_t index) {
+        while (auto next = jobs.pop(index)) {
+            try {
+                auto view = cache.view(**next);
+                if (!results.push(worker(view, (*next)->pdbid))) {
+                    break;
+                }
+            } catch (...) {
+            }
+        }
+
+        if (--running == 0) {
+            results.close();
+        }
+    };
+
+    // The pool is destroyed first, once all tasks are complete
+    thread_pool pool(ncpu);
+    for (size_t i = 0; i < ncpu; ++i) {
+        pool.queue_task([&call_function, i] { call_function(i); });
+    }
+
+    try {
+        while (auto result = results.pop()) {
+            collector(*result);
+        }
+    } catch (...) {
+        // Stop the workers before passing on the error of the collector
+        results.close();
+        throw;
+    }
+}
+
+} // namespace lemon
+
+#endif
@@ -2,116 +2,396 @@
 #define LEMON_THREAD_POOL_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <exception>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <sstream>
 #include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-#include "lemon/external/gaurd.hpp"
-
-LEMON_EXTERNAL_FILE_PUSH
-#include <chemfiles/external/optional.hpp>
-LEMON_EXTERNAL_FILE_POP
-
 namespace lemon {
 
-template <class T> struct threaded_queue {
-    using lock = std::unique_lock<std::mutex>;
-    void push_back(T t) {
-        {
-            lock l(m);
-            data.push_back(std::move(t));
+//! A lock-free deque of pointers for work stealing (Chase and Lev, 2005).
+//!
+//! Only the thread owning the deque may call `push` and `pop`, which work on
+//! the bottom of the deque. Any thread may call `steal`, which takes the item
+//! at the top of the deque. The storage doubles in size when it is full. As
+//! other threads may still be reading the previous storage, it is only freed
+//! with the deque.
+template <class T> class chase_lev_deque {
+  public:
+    //! Create an empty deque with room for `capacity` items.
+    explicit chase_lev_deque(size_t capacity = 256) : top_(0), bottom_(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
         }
-        cv.notify_one();
+        buffers_.emplace_back(new buffer(static_cast<int64_t>(size)));
+        array_.store(buffers_.back().get(), std::memory_order_relaxed);
     }
 
-    chemfiles::optional<T> pop_front() {
-        lock l(m);
-        cv.wait(l, [this] { return abort || !data.empty(); });
-        if (abort)
-            return chemfiles::nullopt;
-        auto r = std::move(data.back());
-        data.pop_back();
-        return std::move(r);
+    chase_lev_deque(const chase_lev_deque&) = delete;
+    chase_lev_deque& operator=(const chase_lev_deque&) = delete;
+
+    //! Add an item to the bottom of the deque. Only called by the owner.
+    void push(T* item) {
+        auto b = bottom_.load(std::memory_order_relaxed);
+        auto t = top_.load(std::memory_order_acquire);
+        auto a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->size() - 1) {
+            a = grow_(a, t, b);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
     }
 
-    void terminate() {
-        {
-            lock l(m);
-            abort = true;
-            data.clear();
+    //! Take the item at the bottom of the deque. Only called by the owner.
+    //!
+    //! \return The item, or `nullptr` if the deque is empty.
+    T* pop() {
+        auto b = bottom_.load(std::memory_order_relaxed) - 1;
+        auto a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto item = a->get(b);
+        if (t == b) {
+            // Last item, race against the thieves
+            if (!top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
         }
-        cv.notify_all();
+        return item;
     }
 
-    ~threaded_queue() { terminate(); }
+    //! Take the item at the top of the deque. Called by any thread.
+    //!
+    //! \return The item, or `nullptr` if the deque is empty or another thread
+    //!  took the item first.
+    T* steal() {
+        auto t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        auto item = array_.load(std::memory_order_acquire)->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
 
   private:
-    std::mutex m;
-    std::deque<T> data;
-    std::condition_variable cv;
-    bool abort = false;
-};
+    struct buffer {
+        explicit buffer(int64_t size)
+            : mask(size - 1),
+              items(new std::atomic<T*>[static_cast<size_t>(size)]) {}
+
+        int64_t size() const { return mask + 1; }
 
-struct thread_pool {
-    thread_pool(std::size_t n = 1) { start_thread(n); }
-    thread_pool(thread_pool&&) = delete;
-    thread_pool& operator=(thread_pool&&) = delete;
-    ~thread_pool() = default;
+        T* get(int64_t i) const {
+            return items[static_cast<size_t>(i & mask)].load(
+                std::memory_order_acquire);
+        }
+
+        void put(int64_t i, T* item) {
+            items[static_cast<size_t>(i & mask)].store(
+                item, std::memory_order_release);
+        }
 
-    template <class F, class R = std::result_of_t<F&()>>
-    std::future<R> queue_task(F task) {
-        std::packaged_task<R()> p(std::move(task));
-        auto r = p.get_future();
-        tasks.push_back(std::move(p));
-        return r;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> items;
+    };
+
+    buffer* grow_(buffer* a, int64_t t, int64_t b) {
+        buffers_.emplace_back(new buffer(2 * a->size()));
+        auto bigger = buffers_.back().get();
+        for (auto i = t; i < b; ++i) {
+            bigger->put(i, a->get(i));
+        }
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
     }
 
-    template <class F, class R = std::result_of_t<F&()>>
-    std::future<R> run_task(F task) {
-        if (threads_active() >= total_threads()) {
-            start_thread();
+    std::atomic<int64_t> top_;
+    std::atomic<int64_t> bottom_;
+    std::atomic<buffer*> array_;
+    std::vector<std::unique_ptr<buffer>> buffers_;
+};
+
+//! A fixed number of threads running tasks with work stealing.
+//!
+//! Each worker thread owns a lock-free `chase_lev_deque`. Tasks queued from
+//! outside the pool wait in a shared queue and are started in the order they
+//! were queued. Tasks queued by a task running in the pool go to the deque of
+//! its worker, where idle workers steal them. A task can therefore split its
+//! work into subtasks and `wait` for them: the waiting thread runs subtasks of
+//! the pool instead of blocking, so nested parallelism never uses more threads
+//! than the pool has. See `parallel_for` for the simplest way to do
+//! this from a workflow.
+class thread_pool {
+  public:
+    //! Start `n` worker threads.
+    explicit thread_pool(size_t n = 1) {
+        n = std::max<size_t>(n, 1);
+        for (size_t i = 0; i < n; ++i) {
+            deques_.emplace_back(new chase_lev_deque<task>());
+        }
+        for (size_t i = 0; i < n; ++i) {
+            threads_.emplace_back(&thread_pool::work_, this, i);
         }
-        return queue_task(std::move(task));
     }
 
-    void terminate() { tasks.terminate(); }
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
 
-    std::size_t threads_active() const { return active; }
+    //! Run the remaining tasks and stop the worker threads.
+    ~thread_pool() {
+        {
+            lock l(sleep_m_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
 
-    std::size_t total_threads() const { return threads.size(); }
+    //! Queue a task which takes no arguments.
+    //!
+    //! \return A future holding the value returned, or the exception thrown,
+    //!  by the task.
+    template <class F, class R = typename std::result_of<F&()>::type>
+    std::future<R> queue_task(F function) {
+        std::packaged_task<R()> packaged(std::move(function));
+        auto result = packaged.get_future();
+        std::unique_ptr<task> job(
+            new task_impl<std::packaged_task<R()>>(std::move(packaged)));
 
-    void clear_threads() {
-        terminate();
-        threads.clear();
+        // Counted first, so that no worker falls asleep while it is queued
+        ++pending_;
+        const auto& context = context_();
+        if (context.pool == this) {
+            deques_[context.index]->push(job.release());
+        } else {
+            lock l(injected_m_);
+            injected_.push_back(job.release());
+        }
+
+        if (sleeping_ > 0) {
+            { lock l(sleep_m_); }
+            wake_.notify_one();
+        }
+        return result;
     }
 
-    void start_thread(std::size_t n = 1) {
-        while (n-- > 0) {
-            threads.push_back(std::async(std::launch::async, [this] {
-                while (auto task = tasks.pop_front()) {
-                    ++active;
-                    try {
-                        (*task)();
-                    } catch (...) {
-                        --active;
-                        throw;
-                    }
-                    --active;
-                }
-            }));
+    //! Wait for the task of `future` to complete.
+    //!
+    //! The calling thread runs subtasks of the pool while it waits, but never
+    //! the tasks queued from outside the pool: these may wait for the task
+    //! which is waiting here, as the workers of `run_ordered` do. Use this
+    //! function instead of `std::future::wait` in tasks running in the pool.
+    template <class R> void wait(const std::future<R>& future) {
+        const auto& context = context_();
+        auto index = context.pool == this ? context.index : deques_.size();
+        while (future.wait_for(std::chrono::seconds(0)) !=
+               std::future_status::ready) {
+            if (auto job = take_(index, false)) {
+                run_(job);
+            } else {
+                std::this_thread::yield();
+            }
         }
     }
 
+    //! The number of worker threads.
+    size_t total_threads() const { return threads_.size(); }
+
+    //! The number of worker threads currently running a task.
+    size_t threads_active() const { return active_; }
+
+    //! The pool running the calling thread, or `nullptr` if the calling thread
+    //! is not a worker of a pool.
+    static thread_pool* current() { return context_().pool; }
+
   private:
-    std::vector<std::future<void>> threads;
-    threaded_queue<std::packaged_task<void()>> tasks;
-    std::atomic<std::size_t> active;
+    using lock = std::unique_lock<std::mutex>;
+
+    struct task {
+        virtual ~task() = default;
+        virtual void run() = 0;
+    };
+
+    template <class F> struct task_impl : task {
+        explicit task_impl(F f) : function(std::move(f)) {}
+        void run() override { function(); }
+        F function;
+    };
+
+    struct worker_context {
+        thread_pool* pool;
+        size_t index;
+    };
+
+    static worker_context& context_() {
+        static thread_local worker_context context = {nullptr, 0};
+        return context;
+    }
+
+    // Own deque first (newest subtask), then the shared queue (oldest task) if
+    // `injected` is set, then the other deques (oldest subtask).
+    task* take_(size_t index, bool injected) {
+        task* job = nullptr;
+        if (index < deques_.size()) {
+            job = deques_[index]->pop();
+        }
+
+        if (job == nullptr && injected) {
+            lock l(injected_m_);
+            if (!injected_.empty()) {
+                job = injected_.front();
+                injected_.pop_front();
+            }
+        }
+
+        for (size_t i = 1; job == nullptr && i <= deques_.size(); ++i) {
+            job = deques_[(index + i) % deques_.size()]->steal();
+        }
+
+        if (job != nullptr) {
+            --pending_;
+        }
+        return job;
+    }
+
+    void run_(task* job) {
+        std::unique_ptr<task> owned(job);
+        ++active_;
+        owned->run();
+        --active_;
+    }
+
+    void work_(size_t index) {
+        context_() = {this, index};
+        while (true) {
+            if (auto job = take_(index, true)) {
+                run_(job);
+                continue;
+            }
+
+            lock l(sleep_m_);
+            ++sleeping_;
+            wake_.wait(l, [this] { return stop_ || pending_ > 0; });
+            --sleeping_;
+            if (stop_ && pending_ == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<chase_lev_deque<task>>> deques_;
+    std::mutex injected_m_;
+    std::deque<task*> injected_;
+
+    std::mutex sleep_m_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> sleeping_{0};
+    std::atomic<size_t> active_{0};
+    std::vector<std::thread> threads_;
 };
+
+//! Run `function` for every index from `first` to `last`, in parallel if
+//! possible.
+//!
+//! When called from a task of a `thread_pool`, such as a workflow started by
+//! `run_parallel`, the indices are split into subtasks for the idle threads of
+//! the same pool and the calling thread works on them as well. Otherwise, the
+//! indices are processed on the calling thread. Use this function to split
+//! large entries, for example by chain or by ligand.
+//! \param [in] first The first index.
+//! \param [in] last One past the last index.
+//! \param function A function object accepting a `size_t` index.
+//! \throws The first exception thrown by `function`, once all indices were
+//!  processed.
+template <class Function>
+inline void parallel_for(size_t first, size_t last, Function&& function) {
+    auto pool = thread_pool::current();
+    if (pool == nullptr || last - first < 2) {
+        for (auto i = first; i < last; ++i) {
+            function(i);
+        }
+        return;
+    }
+
+    auto run_range = [&function](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            function(i);
+        }
+    };
+
+    // A few chunks per thread, so that chunks of unequal cost even out
+    auto chunks = std::min(last - first, 4 * pool->total_threads());
+    auto size = (last - first + chunks - 1) / chunks;
+
+    std::vector<std::future<void>> futures;
+    for (auto begin = first + size; begin < last; begin += size) {
+        auto end = std::min(begin + size, last);
+        futures.push_back(pool->queue_task(
+            [&run_range, begin, end] { run_range(begin, end); }));
+    }
+
+    std::exception_ptr error;
+    try {
+        run_range(first, std::min(first + size, last));
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // All subtasks must be complete before `function` goes out of scope
+    for (auto& future : futures) {
+        pool->wait(future);
+    }
+
+    for (auto& future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
 } // namespace lemon
 
 #endif
@@ -5,6 +5,9 @@
 #include <set>
 #include <limits>
 #include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "lemon/external/gaurd.hpp"
 
@@ -30,16 +33,41 @@ inline size_t find_element_by_name(const chemfiles::Frame& frame,
     return frame.size();
 }
 
-inline unsigned long find_operlapping_residues(const chemfiles::Frame& search,
-                                               const chemfiles::Frame& native,
-                                               std::vector<size_t>& a_search,
-                                               std::vector<size_t>& a_native,
-                                               const std::string& s_chain,
-                                               const std::string& n_chain) {
+//! A residue which can be aligned: its alpha carbon, chain name and ID
+struct AlignedResidue {
+    size_t alpha_carbon;
+    std::string chain_name;
+    uint64_t id;
+};
 
-    // Setup which residues to return
-    const auto& search_res = search.topology().residues();
-    const auto& native_res = native.topology().residues();
+//! The residues of `frame` with an alpha carbon, in order
+//!
+//! The properties of each residue are read once here instead of once for
+//! every pair of residues compared by `find_operlapping_residues`.
+inline std::vector<AlignedResidue> aligned_residues(
+    const chemfiles::Frame& frame) {
+    std::vector<AlignedResidue> result;
+    for (const auto& res : frame.topology().residues()) {
+        auto i = find_element_by_name(frame, res, "CA");
+        if (i == frame.size()) {
+            continue;
+        }
+
+        auto chainname = res.get("chainname");
+        auto chain_name = chainname &&
+                          chainname->kind() == chemfiles::Property::STRING?
+            chainname->as_string() : "ZZZ";
+
+        result.push_back({i, chain_name, *res.id()});
+    }
+    return result;
+}
+
+inline unsigned long find_operlapping_residues(
+    const std::vector<AlignedResidue>& search_res,
+    const std::vector<AlignedResidue>& native_res,
+    std::vector<size_t>& a_search, std::vector<size_t>& a_native,
+    const std::string& s_chain, const std::string& n_chain) {
 
     a_search.clear();
     a_native.clear();
@@ -47,49 +75,37 @@ inline unsigned long find_operlapping_residues(const chemfiles::Frame& search,
     a_search.reserve(search_res.size());
     a_native.reserve(native_res.size());
 
+    // The native residues with a given ID, in order
+    std::unordered_map<uint64_t, std::vector<size_t>> native_ids;
+    for (size_t j = 0; j < native_res.size(); ++j) {
+        native_ids[native_res[j].id].push_back(j);
+    }
+
     auto n_ali = 0UL;
     for (const auto& s_res : search_res) {
-        auto i = find_element_by_name(search, s_res, "CA");
-
-        if (i == search.size()) {
+        // Check to see if we have forced a chain ID
+        if (!s_chain.empty() && s_res.chain_name != s_chain) {
             continue;
         }
 
-        auto s_chainname = s_res.get("chainname");
-        auto s_chain_name = s_chainname &&
-                            s_chainname->kind() == chemfiles::Property::STRING?
-            s_chainname->as_string() : "ZZZ";
-
-        // Check to see if we have forced a chain ID
-        if (!s_chain.empty() && s_chain_name != s_chain) {
+        auto same_id = native_ids.find(s_res.id);
+        if (same_id == native_ids.end()) {
             continue;
         }
 
-        for (const auto& n_res : native_res) {
-            if (*s_res.id() != *n_res.id()) {
-                continue;
-            }
-
-            auto n_chainname = n_res.get("chainname");
-            auto n_chain_name = n_chainname &&
-                            n_chainname->kind() == chemfiles::Property::STRING?
-            n_chainname->as_string() : "ZZZ";
-
-            if (s_chain_name != n_chain_name && s_chain.empty()) {
-                continue;
-            }
+        for (auto j : same_id->second) {
+            const auto& n_res = native_res[j];
 
-            if (!n_chain.empty() && n_chain_name != n_chain) {
+            if (s_res.chain_name != n_res.chain_name && s_chain.empty()) {
                 continue;
             }
 
-            auto j = find_element_by_name(native, n_res, "CA");
-            if (j == native.size()) {
+            if (!n_chain.empty() && n_res.chain_name != n_chain) {
                 continue;
             }
 
-            a_search.emplace_back(i);
-            a_native.emplace_back(j);
+            a_search.emplace_back(s_res.alpha_carbon);
+            a_native.emplace_back(n_res.alpha_carbon);
             n_ali++;
 
             break;
@@ -99,6 +115,17 @@ inline unsigned long find_operlapping_residues(const chemfiles::Frame& search,
     return n_ali;
 }
 
+inline unsigned long find_operlapping_residues(const chemfiles::Frame& search,
+                                               const chemfiles::Frame& native,
+                                               std::vector<size_t>& a_search,
+                                               std::vector<size_t>& a_native,
+                                               const std::string& s_chain,
+                                               const std::string& n_chain) {
+    return find_operlapping_residues(aligned_residues(search),
+                                     aligned_residues(native), a_search,
+                                     a_native, s_chain, n_chain);
+}
+
 inline unsigned long count_number_of_atom_names(const chemfiles::Frame& frame,
                                          const std::string& elem) {
     const auto& residues = frame.topology().residues();
@@ -322,7 +349,10 @@ inline TMResult TMscore(const chemfiles::Frame& search,
     auto search_align_id = std::vector<size_t>();
     auto native_align_id = std::vector<size_t>();
 
-    auto n_ali = find_operlapping_residues(search, native,
+    auto search_residues = aligned_residues(search);
+    auto native_residues = aligned_residues(native);
+
+    auto n_ali = find_operlapping_residues(search_residues, native_residues,
                                            search_align_id, native_align_id,
                                            "", "");
 
@@ -351,7 +381,7 @@ inline TMResult TMscore(const chemfiles::Frame& search,
 
     for (auto& s_chain : search_names) {
         for (auto& n_chain : native_names) {
-            n_ali = find_operlapping_residues(search, native,
+            n_ali = find_operlapping_residues(search_residues, native_residues,
                                              search_align_id, native_align_id,
                                              s_chain, n_chain);
 
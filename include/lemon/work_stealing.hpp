@@ -0,0 +1,101 @@
+#ifndef LEMON_WORK_STEALING_HPP
+#define LEMON_WORK_STEALING_HPP
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "lemon/external/gaurd.hpp"
+
+LEMON_EXTERNAL_FILE_PUSH
+#include <chemfiles/external/optional.hpp>
+LEMON_EXTERNAL_FILE_POP
+
+namespace lemon {
+
+//! A set of job deques, one per worker thread, with work stealing.
+//!
+//! Each worker takes jobs from the front of its own deque. When its deque is
+//! empty, the worker steals a job from the back of the deque of another worker.
+//! Workers therefore process contiguous jobs (such as consecutive records of a
+//! sequence file) as long as they have work, and jobs only move between
+//! threads when a thread would otherwise be idle.
+template <class T> class work_stealing_queue {
+  public:
+    //! Create an empty deque for each of the `workers` threads.
+    explicit work_stealing_queue(size_t workers)
+        : size_(workers == 0 ? 1 : workers), slots_(new slot[size_]) {}
+
+    work_stealing_queue(const work_stealing_queue&) = delete;
+    work_stealing_queue& operator=(const work_stealing_queue&) = delete;
+
+    //! The number of worker deques
+    size_t workers() const { return size_; }
+
+    //! Add a job to the back of the deque of `worker`.
+    void push(size_t worker, T item) {
+        auto& s = slots_[worker % size_];
+        lock l(s.m);
+        s.data.push_back(std::move(item));
+    }
+
+    //! Add jobs to the front of the deque of `worker`, keeping their order.
+    //!
+    //! Use this function to split a job into smaller jobs which should be
+    //! processed next by `worker`.
+    void push_front(size_t worker, std::vector<T> items) {
+        auto& s = slots_[worker % size_];
+        lock l(s.m);
+        s.data.insert(s.data.begin(), std::make_move_iterator(items.begin()),
+                      std::make_move_iterator(items.end()));
+    }
+
+    //! Take the next job for `worker`.
+    //!
+    //! \return The job at the front of the deque of `worker`, or a job stolen
+    //!  from the back of another deque. `chemfiles::nullopt` if all deques are
+    //!  empty.
+    chemfiles::optional<T> pop(size_t worker) {
+        worker %= size_;
+        {
+            auto& s = slots_[worker];
+            lock l(s.m);
+            if (!s.data.empty()) {
+                chemfiles::optional<T> result(std::move(s.data.front()));
+                s.data.pop_front();
+                return result;
+            }
+        }
+
+        for (size_t i = 1; i < size_; ++i) {
+            auto& s = slots_[(worker + i) % size_];
+            lock l(s.m);
+            if (!s.data.empty()) {
+                chemfiles::optional<T> result(std::move(s.data.back()));
+                s.data.pop_back();
+                return result;
+            }
+        }
+
+        return chemfiles::nullopt;
+    }
+
+  private:
+    using lock = std::unique_lock<std::mutex>;
+
+    struct slot {
+        std::mutex m;
+        std::deque<T> data;
+    };
+
+    size_t size_;
+    std::unique_ptr<slot[]> slots_;
+};
+
+} // namespace lemon
+
+#endif
@@ -11,6 +11,8 @@ LEMON_EXTERNAL_FILE_POP
 #include <set>
 #include <unordered_map>
 
+#include "lemon/frame_index.hpp"
+
 namespace lemon {
 
 namespace xscore {
@@ -343,27 +345,14 @@ inline BondMap create_bond_map(const std::vector<chemfiles::Bond>& bonds) {
 //! Default maximum for interactions
 constexpr auto DEFAULT_INTERACTION_DISTANCE = 8.0;
 
-//! XScore is a 'docking' scoring function used to evaluate compound-protein
-//! interactions
-//!
-//! The docking program AutoDOCK Vina utilizes a modified version of the XScore
-//! scoring function to evaluate the fit of a compound-protein interaction.
-//! Since the original XScore program is not open source, we've included a copy
-//! of the Vina version of this scoring function.
-//! \param [in] frame The frame for which the ligand-protein score will be
-//!  calculated
-//! \param [in] ligid The residue ID for the ligand in the entry
-//! \param [in] recid The residue IDs for the protein in the entry
-//! \param [in] cutoff The interaction distance cutoff between ligand and
-//!  protein
-//! \return The five components of Vina/XScore's scoring function.
+//! XScore of a ligand, using the bonds of each atom in `bond_map`
 template <typename Container>
-inline VinaScore vina_score(const chemfiles::Frame& frame, size_t ligid,
+inline VinaScore vina_score(const chemfiles::Frame& frame,
+                            const BondMap& bond_map, size_t ligid,
                             Container recid,
                             double cutoff = DEFAULT_INTERACTION_DISTANCE) {
     const auto& topo = frame.topology();
     const auto& residues = topo.residues();
-    auto bond_map = create_bond_map(topo.bonds());
 
     // Not memory efficient, but simple to implement
     std::vector<XS_TYPE> xs_types(frame.size());
@@ -411,6 +400,39 @@ inline VinaScore vina_score(const chemfiles::Frame& frame, size_t ligid,
     return X_Score;
 }
 
+//! XScore is a 'docking' scoring function used to evaluate compound-protein
+//! interactions
+//!
+//! The docking program AutoDOCK Vina utilizes a modified version of the XScore
+//! scoring function to evaluate the fit of a compound-protein interaction.
+//! Since the original XScore program is not open source, we've included a copy
+//! of the Vina version of this scoring function.
+//! \param [in] frame The frame for which the ligand-protein score will be
+//!  calculated
+//! \param [in] ligid The residue ID for the ligand in the entry
+//! \param [in] recid The residue IDs for the protein in the entry
+//! \param [in] cutoff The interaction distance cutoff between ligand and
+//!  protein
+//! \return The five components of Vina/XScore's scoring function.
+template <typename Container>
+inline VinaScore vina_score(const chemfiles::Frame& frame, size_t ligid,
+                            Container recid,
+                            double cutoff = DEFAULT_INTERACTION_DISTANCE) {
+    return vina_score(frame, create_bond_map(frame.topology().bonds()), ligid,
+                      recid, cutoff);
+}
+
+//! XScore of a ligand, using the bonds stored in a `FrameIndex`
+//!
+//! The bonds of each atom are found once per index instead of once per call,
+//! for workflows scoring many ligands of the same entry.
+template <typename Container>
+inline VinaScore vina_score(const FrameIndex& index, size_t ligid,
+                            Container recid,
+                            double cutoff = DEFAULT_INTERACTION_DISTANCE) {
+    return vina_score(index.frame(), index.bond_map(), ligid, recid, cutoff);
+}
+
 } // namespace xscore
 
 } // namespace lemon
@@ -36,6 +36,9 @@ int main(int argc, char *argv[]) {
     lemon::Options o;
     std::string py_script("lemon.py");
     o.add_option("--py_script,-p", py_script, "Python script to load");
+    bool processes = false;
+    o.add_flag("--processes", processes,
+               "Run the workers in separate processes instead of threads");
     o.parse_command_line(argc, argv);
 
     // Register the module with the interpreter
@@ -51,6 +54,7 @@ int main(int argc, char *argv[]) {
     try {
         python::exec("LEMON_HADOOP_DIR='" + o.work_dir() + "'\n");
         python::exec("LEMON_NUM_THREADS=" + std::to_string(o.ncpu()));
+        python::module::import("lemon").attr("USE_PROCESSES") = processes;
         python::eval_file(py_script, python::globals(), locals);
     } catch (python::error_already_set& err) {
         std::cerr << err.what() << std::endl;
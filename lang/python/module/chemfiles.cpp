@@ -124,7 +124,18 @@ void add_chemfiles_features(py::module& m) {
 
     py::bind_vector<std::vector<Vector3D>>(m, "Coordinates");
 
-    py::class_<span<Vector3D>>(m, "CoordinateSpan");
+    // An (N, 3) array of doubles, viewed without a copy by numpy.asarray
+    static_assert(sizeof(Vector3D) == 3 * sizeof(double),
+                  "Vector3D must be three contiguous doubles");
+    py::class_<span<Vector3D>>(m, "CoordinateSpan", py::buffer_protocol())
+        .def("__len__", &span<Vector3D>::size)
+        .def_buffer([](span<Vector3D>& v) {
+            return py::buffer_info(
+                v.data(), sizeof(double),
+                py::format_descriptor<double>::format(), 2,
+                {v.size(), size_t(3)},
+                {sizeof(Vector3D), sizeof(double)});
+        });
 
     /**************************************************************************
      * Optional
@@ -1,9 +1,14 @@
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <mutex>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include "lemon/lemon.hpp"
 #include "lemon/launch.hpp"
+#include "lemon/processes.hpp"
 #include "lemon/geometry.hpp"
 #include "lemon/tmalign.hpp"
 #include "lemon/xscore.hpp"
@@ -29,6 +34,24 @@ LEMON_EXTERNAL_FILE_POP
 
 namespace py = pybind11;
 
+// Residue IDs and atom columns are shared with Python by reference and through
+// the buffer protocol, instead of being copied to and from Python lists
+PYBIND11_MAKE_OPAQUE(std::vector<uint64_t>)
+PYBIND11_MAKE_OPAQUE(std::vector<uint8_t>)
+
+// Sets and counts of residue names are converted to Python sets and dicts, as
+// the standard containers they replace
+namespace pybind11 {
+namespace detail {
+template <>
+struct type_caster<lemon::ResidueNameSet>
+    : set_caster<lemon::ResidueNameSet, lemon::ResidueName> {};
+template <>
+struct type_caster<lemon::ResidueNameCount>
+    : map_caster<lemon::ResidueNameCount, lemon::ResidueName, size_t> {};
+} // namespace detail
+} // namespace pybind11
+
 namespace lemon {
 
 struct LemonPythonWrap : LemonPythonBase {
@@ -65,19 +88,297 @@ struct LemonPythonWrap : LemonPythonBase {
     }
 };
 
-void run_lemon_workflow(LemonPythonBase& py, const std::string& p, size_t threads, const Entries& entries) {
-    py::gil_scoped_release release;
+struct LemonPythonBatchWrap : LemonPythonBatchBase {
+    virtual std::string worker_batch(
+        const std::vector<const chemfiles::Frame*>& frames,
+        const std::vector<std::string>& pdbids) override {
+        py::gil_scoped_acquire acq;
+        auto first = pdbids.empty() ? std::string() : pdbids.front();
+        try {
+            PYBIND11_OVERLOAD_PURE(
+                std::string,
+                LemonPythonBatchBase,
+                worker_batch,
+                frames,
+                pdbids
+            );
+        } catch (py::error_already_set& err) {
+            std::cerr << first + " " + err.what() + "\n";
+        } catch (py::cast_error& err) {
+            std::cerr << first + " Problem with type: " + err.what() + "\n";
+        } catch (std::exception& err) {
+            std::cerr << first + " " + err.what() + "\n";
+        } catch (...) {
+            std::cerr << first + " unknown error." + "\n";
+        }
+
+        return std::string("");
+    }
+
+    virtual void finalize() override {
+        PYBIND11_OVERLOAD(
+            void,
+            LemonPythonBatchBase,
+            finalize,
+        );
+    }
+};
+
+// Name of the module, which differs when installed as a package
+std::string lemon_module_name("lemon");
 
+void run_lemon_processes(LemonPythonBase& py, const std::string& p, size_t nprocs, const Entries& entries) {
+#ifdef _WIN32
+    (void)py; (void)p; (void)nprocs; (void)entries;
+    throw std::runtime_error("Worker processes are not supported on Windows");
+#else
     auto worker = [&py](chemfiles::Frame entry, const std::string& pdbid) {
         return py.worker(&entry, pdbid);
     };
 
+    auto flush = [] {
+        auto sys = py::module::import("sys");
+        sys.attr("stdout").attr("flush")();
+        sys.attr("stderr").attr("flush")();
+    };
+
+    // The interpreter must be consistent in the new processes, so the
+    // Python lock is held while forking
+    ProcessHooks hooks;
+    hooks.before_fork = [flush] {
+        flush();
+#if PY_VERSION_HEX >= 0x03070000
+        PyOS_BeforeFork();
+#endif
+    };
+#if PY_VERSION_HEX >= 0x03070000
+    hooks.after_fork_parent = [] { PyOS_AfterFork_Parent(); };
+    hooks.after_fork_child = [] { PyOS_AfterFork_Child(); };
+#else
+    hooks.after_fork_child = [] { PyOS_AfterFork(); };
+#endif
+    hooks.finish = [&py, flush] {
+        py.finalize();
+        flush();
+    };
+
+    print_combine combiner(std::cout);
+    py::gil_scoped_acquire acq;
+    lemon::run_processes(worker, p, combiner, nprocs, entries, Entries(), hooks);
+#endif
+}
+
+// The sum of the values returned by the workers for a key. A number is
+// stored as a sequence of one value. Integers are summed apart from floats,
+// so that they stay exact.
+struct ReducedValue {
+    std::vector<int64_t> integers;
+    std::vector<double> reals;
+    bool integer = true;
+    bool sequence = false;
+};
+
+using Reduction = std::map<std::string, ReducedValue>;
+
+// Add `value` to `total`, element by element for sequences
+void merge_value(ReducedValue& total, const ReducedValue& value,
+                 const std::string& key) {
+    if (total.sequence != value.sequence) {
+        throw py::type_error("Cannot add a number and a sequence for " + key);
+    }
+
+    if (total.integers.size() < value.integers.size()) {
+        total.integers.resize(value.integers.size(), 0);
+        total.reals.resize(value.reals.size(), 0.0);
+    }
+
+    for (size_t i = 0; i < value.integers.size(); ++i) {
+        total.integers[i] += value.integers[i];
+        total.reals[i] += value.reals[i];
+    }
+    total.integer = total.integer && value.integer;
+}
+
+void merge_reduction(Reduction& total, const Reduction& other) {
+    for (const auto& item : other) {
+        auto found = total.find(item.first);
+        if (found == total.end()) {
+            total.emplace(item.first, item.second);
+        } else {
+            merge_value(found->second, item.second, item.first);
+        }
+    }
+}
+
+// Convert a number, or a sequence of numbers, returned by a worker
+ReducedValue to_reduced_value(py::handle value, const std::string& key) {
+    ReducedValue result;
+    auto add_number = [&result, &key](py::handle number) {
+        if (py::isinstance<py::int_>(number)) {
+            result.integers.push_back(number.cast<int64_t>());
+            result.reals.push_back(0.0);
+        } else if (py::isinstance<py::float_>(number)) {
+            result.integers.push_back(0);
+            result.reals.push_back(number.cast<double>());
+            result.integer = false;
+        } else {
+            throw py::type_error("Only numbers can be reduced for " + key);
+        }
+    };
+
+    if (py::isinstance<py::list>(value) || py::isinstance<py::tuple>(value)) {
+        result.sequence = true;
+        for (auto number : py::reinterpret_borrow<py::sequence>(value)) {
+            add_number(number);
+        }
+    } else {
+        add_number(value);
+    }
+
+    return result;
+}
+
+// Add the dict returned by a worker to the accumulator of its thread
+void reduce_result(Reduction& total, py::handle result) {
+    if (result.is_none()) {
+        return;
+    }
+
+    if (!py::isinstance<py::dict>(result)) {
+        throw py::type_error("The worker must return a dict to be reduced");
+    }
+
+    // Converted first, so that an invalid result adds nothing
+    Reduction entry;
+    for (auto item : py::reinterpret_borrow<py::dict>(result)) {
+        if (!py::isinstance<py::str>(item.first)) {
+            throw py::type_error("The keys of the dict must be strings");
+        }
+
+        auto key = item.first.cast<std::string>();
+        auto value = to_reduced_value(item.second, key);
+        auto found = total.find(key);
+        if (found != total.end() && found->second.sequence != value.sequence) {
+            throw py::type_error("Cannot add a number and a sequence for " +
+                                 key);
+        }
+        entry[key] = std::move(value);
+    }
+
+    merge_reduction(total, entry);
+}
+
+py::dict to_python(const Reduction& total) {
+    py::dict result;
+    for (const auto& item : total) {
+        const auto& value = item.second;
+        auto number = [&value](size_t i) -> py::object {
+            if (value.integer) {
+                return py::int_(value.integers[i]);
+            }
+            return py::float_(static_cast<double>(value.integers[i]) +
+                              value.reals[i]);
+        };
+
+        py::str key(item.first);
+        if (!value.sequence) {
+            result[key] = number(0);
+            continue;
+        }
+
+        py::list values;
+        for (size_t i = 0; i < value.integers.size(); ++i) {
+            values.append(number(i));
+        }
+        result[key] = values;
+    }
+    return result;
+}
+
+// Reduce the dicts returned by the workers with one accumulator per thread
+py::object run_lemon_reduce(LemonPythonBase& py, const std::string& p, size_t threads, const Entries& entries) {
+    auto workflow = py::cast(&py, py::return_value_policy::reference);
+    Reduction total;
+
+    {
+        py::gil_scoped_release release;
+
+        auto worker = [&workflow](chemfiles::Frame entry,
+                                  const std::string& pdbid, Reduction& acc) {
+            py::gil_scoped_acquire acq;
+            try {
+                auto result = workflow.attr("worker")(&entry, pdbid);
+                reduce_result(acc, result);
+            } catch (py::error_already_set& err) {
+                std::cerr << pdbid + " " + err.what() + "\n";
+            } catch (std::exception& err) {
+                std::cerr << pdbid + " " + err.what() + "\n";
+            }
+        };
+
+        lemon::run_reduce(worker, p, total, merge_reduction, threads, entries);
+        py.finalize();
+    }
+
+    return to_python(total);
+}
+
+py::object run_lemon_workflow(LemonPythonBase& py, const std::string& p, size_t threads, const Entries& entries, py::object processes, bool reduce) {
+    if (processes.is_none()) {
+        processes = py::module::import(lemon_module_name.c_str()).attr("USE_PROCESSES");
+    }
+
+    if (reduce) {
+        if (processes.cast<bool>()) {
+            throw std::runtime_error("Results cannot be reduced with worker processes");
+        }
+        return run_lemon_reduce(py, p, threads, entries);
+    }
+
+    if (processes.cast<bool>()) {
+        run_lemon_processes(py, p, threads, entries);
+        return py::none();
+    }
+
+    {
+        py::gil_scoped_release release;
+
+        auto worker = [&py](chemfiles::Frame entry, const std::string& pdbid) {
+            return py.worker(&entry, pdbid);
+        };
+
+        print_combine combiner(std::cout);
+        lemon::run_parallel(worker, p, combiner, threads, entries);
+        py.finalize();
+    }
+
+    return py::none();
+}
+
+void run_lemon_batches(LemonPythonBatchBase& py, const std::string& p, size_t threads, const Entries& entries, size_t batch_size) {
+    py::gil_scoped_release release;
+
+    // Frames of the next batches are parsed while Python runs
+    auto worker = [&py](std::vector<chemfiles::Frame> frames,
+                        const std::vector<std::string>& pdbids) {
+        std::vector<const chemfiles::Frame*> pointers;
+        pointers.reserve(frames.size());
+        for (const auto& frame : frames) {
+            pointers.push_back(&frame);
+        }
+        return py.worker_batch(pointers, pdbids);
+    };
+
+    PipelineThreads stages;
+    stages.decode = threads;
+    stages.worker = threads;
+
     print_combine combiner(std::cout);
-    lemon::run_parallel(worker, p, combiner, threads, entries);
+    lemon::run_batches(worker, p, combiner, stages, batch_size, entries);
     py.finalize();
 }
 
-using default_id_list = std::list<uint64_t>;
+using default_id_list = std::vector<uint64_t>;
 inline std::ostream& operator<<(std::ostream& os, const default_id_list& idlist) {
     os << '[';
     for (auto i : idlist) {
@@ -112,6 +413,43 @@ std::string to_string(const Affine& affine) {
     return ss.str();
 }
 
+// The atomic number of every atom, zero if unknown
+std::vector<uint8_t> atom_elements(const chemfiles::Frame& frame) {
+    std::vector<uint8_t> elements(frame.size(), 0);
+    for (size_t i = 0; i < frame.size(); ++i) {
+        auto atomic_number = frame[i].atomic_number();
+        if (atomic_number) {
+            elements[i] = static_cast<uint8_t>(*atomic_number);
+        }
+    }
+    return elements;
+}
+
+// The index of the residue of every atom, the largest integer if none
+default_id_list atom_residues(const chemfiles::Frame& frame) {
+    default_id_list residues(frame.size(),
+                             std::numeric_limits<uint64_t>::max());
+    const auto& topology_residues = frame.topology().residues();
+    for (size_t i = 0; i < topology_residues.size(); ++i) {
+        for (auto atom : topology_residues[i]) {
+            residues[atom] = i;
+        }
+    }
+    return residues;
+}
+
+// The first character of the alternate location of every atom, ' ' if none
+std::vector<uint8_t> atom_altlocs(const chemfiles::Frame& frame) {
+    std::vector<uint8_t> altlocs(frame.size(), ' ');
+    for (size_t i = 0; i < frame.size(); ++i) {
+        auto altloc = frame[i].get<chemfiles::Property::STRING>("altloc");
+        if (altloc && !altloc->empty()) {
+            altlocs[i] = static_cast<uint8_t>((*altloc)[0]);
+        }
+    }
+    return altlocs;
+}
+
 void translate(lemon::geometry::geometry_error const& e) {
     // Use the Python 'C' API to set up an exception object
     auto msg = std::string("Geometry Error: ") + e.what();
@@ -125,15 +463,66 @@ void add_lemon_features(py::module& m) {
     using namespace chemfiles;
     using namespace lemon;
 
+    // Functions which loop over a frame run without the global interpreter
+    // lock, so that the other threads of a workflow can run Python code. The
+    // arguments are converted before, and the result after, the lock is
+    // released.
+    using release_gil = py::call_guard<py::gil_scoped_release>;
+
     py::class_<LemonPythonBase, LemonPythonWrap>(m, "Workflow")
         .def(py::init<>())
         .def("worker", &LemonPythonBase::worker)
         .def("finalize", &LemonPythonBase::finalize);
 
-    m.def("launch", run_lemon_workflow);
-    m.def("launch", [](LemonPythonBase& py, const std::string& p, size_t threads){
-        run_lemon_workflow(py, p, threads, Entries());
-    });
+    // Run the workers in separate processes instead of threads
+    lemon_module_name = m.attr("__name__").cast<std::string>();
+    m.attr("USE_PROCESSES") = false;
+
+    m.def("launch", run_lemon_workflow,
+          py::arg("workflow"), py::arg("path"), py::arg("threads"),
+          py::arg("entries"), py::arg("processes") = py::none(),
+          py::arg("reduce") = false);
+    m.def("launch", [](LemonPythonBase& py, const std::string& p, size_t threads, py::object processes, bool reduce){
+        return run_lemon_workflow(py, p, threads, Entries(), processes, reduce);
+    }, py::arg("workflow"), py::arg("path"), py::arg("threads"),
+       py::arg("processes") = py::none(), py::arg("reduce") = false);
+
+    // Iterate over the PDB without a Workflow, parsing ahead in C++ threads
+    auto next_frame = [](FrameStream& stream) {
+        chemfiles::optional<pipeline_frame> item;
+        {
+            py::gil_scoped_release release;
+            item = stream.next();
+        }
+
+        if (!item) {
+            throw py::stop_iteration();
+        }
+        return py::make_tuple(item->first, py::cast(std::move(item->second)));
+    };
+
+    py::class_<FrameStream>(m, "FrameStream")
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__", next_frame)
+        .def("next", next_frame)
+        .def("close", &FrameStream::close);
+
+    m.def("iterate", [](const std::string& p, size_t threads, const Entries& entries) {
+        return std::unique_ptr<FrameStream>(new FrameStream(p, threads, entries));
+    }, py::arg("path"), py::arg("threads") = 1, py::arg("entries") = Entries());
+
+    py::class_<LemonPythonBatchBase, LemonPythonBatchWrap>(m, "BatchWorkflow")
+        .def(py::init<>())
+        .def("worker_batch", &LemonPythonBatchBase::worker_batch)
+        .def("finalize", &LemonPythonBatchBase::finalize);
+
+    m.def("launch", run_lemon_batches,
+          py::arg("workflow"), py::arg("path"), py::arg("threads"),
+          py::arg("entries"), py::arg("batch_size") = 64);
+    m.def("launch", [](LemonPythonBatchBase& py, const std::string& p, size_t threads, size_t batch_size){
+        run_lemon_batches(py, p, threads, Entries(), batch_size);
+    }, py::arg("workflow"), py::arg("path"), py::arg("threads"),
+       py::arg("batch_size") = 64);
 
     /**************************************************************************
      * Residue Name
@@ -157,60 +546,116 @@ void add_lemon_features(py::module& m) {
     m.attr("common_fatty_acids") = common_fatty_acids;
     m.attr("proline_res") = proline_res;
 
+    /**************************************************************************
+     * Residue IDs and atom columns
+     **************************************************************************/
+    py::bind_vector<default_id_list>(m, "ResidueIDs", py::buffer_protocol())
+        .def("__str__", [](const default_id_list& v) {
+            return to_string(v);
+        });
+    py::implicitly_convertible<py::list, default_id_list>();
+
+    py::bind_vector<std::vector<uint8_t>>(m, "UInt8Array",
+                                          py::buffer_protocol());
+
+    m.def("atom_elements", atom_elements, release_gil());
+    m.def("atom_residues", atom_residues, release_gil());
+    m.def("atom_altlocs", atom_altlocs, release_gil());
+
     /**************************************************************************
      * Select
      **************************************************************************/
 
-    m.def("select_small_molecules", &select::small_molecules<default_id_list>);
-    m.def("select_metal_ions", &select::metal_ions<default_id_list>);
-    m.def("select_nucleic_acids", &select::nucleic_acids<default_id_list>);
-    m.def("select_peptides", &select::peptides<default_id_list>);
-    m.def("select_residue_ids", &select::residue_ids<default_id_list>);
-    m.def("select_specific_residues",
-          &select::specific_residues<default_id_list>);
+    // The select functions are overloaded for FrameView, so the Frame
+    // version must be picked explicitly
+    default_id_list (*small_molecules_f)(const Frame&,
+                                         const std::unordered_set<std::string>&,
+                                         size_t) =
+        &select::small_molecules<default_id_list>;
+    m.def("select_small_molecules", small_molecules_f, release_gil());
+
+    default_id_list (*metal_ions_f)(const Frame&) =
+        &select::metal_ions<default_id_list>;
+    m.def("select_metal_ions", metal_ions_f, release_gil());
+
+    default_id_list (*nucleic_acids_f)(const Frame&) =
+        &select::nucleic_acids<default_id_list>;
+    m.def("select_nucleic_acids", nucleic_acids_f, release_gil());
+
+    default_id_list (*peptides_f)(const Frame&) =
+        &select::peptides<default_id_list>;
+    m.def("select_peptides", peptides_f, release_gil());
+
+    default_id_list (*residue_ids_f)(const Frame&, const std::set<uint64_t>&) =
+        &select::residue_ids<default_id_list>;
+    m.def("select_residue_ids", residue_ids_f, release_gil());
+
+    default_id_list (*specific_residues_f)(const Frame&,
+                                           const ResidueNameSet&) =
+        &select::specific_residues<default_id_list>;
+    m.def("select_specific_residues", specific_residues_f, release_gil());
     m.def("select_residue_property",
-          &select::residue_property<default_id_list>);
+          &select::residue_property<default_id_list>, release_gil());
 
     /**************************************************************************
      * Count
      **************************************************************************/
-    m.def("count_atomic_property", count::atom_property);
-    m.def("count_residue_property", count::residue_property);
+    m.def("count_atomic_property", count::atom_property, release_gil());
+    m.def("count_residue_property", count::residue_property, release_gil());
     m.def("count_print_residue_names",
-        count::print_residue_names<default_id_list>);
+        count::print_residue_names<default_id_list>, release_gil());
 
     ResidueNameCount& (*residues1)(const Frame&, ResidueNameCount&) =
         &count::residues;
-    m.def("count_residues", residues1);
+    m.def("count_residues", residues1, release_gil());
 
     ResidueNameCount& (*residues2)(const Frame&, const default_id_list&,
                                    ResidueNameCount&) =
         &count::residues;
-    m.def("count_residues", residues2);
+    m.def("count_residues", residues2, release_gil());
 
     /**************************************************************************
      * Prune
      **************************************************************************/
-    m.def("prune_identical_residues",
-        prune::identical_residues<default_id_list>);
-    m.def("prune_cofactors", prune::cofactors<default_id_list>);
-    m.def("keep_interactions", prune::keep_interactions<default_id_list>);
-    m.def("remove_interactions", prune::remove_interactions<default_id_list>);
+    default_id_list (*identical_residues_f)(const Frame&, default_id_list&) =
+        &prune::identical_residues<default_id_list>;
+    m.def("prune_identical_residues", identical_residues_f, release_gil());
+
+    default_id_list (*cofactors_f)(const Frame&, default_id_list&,
+                                   const ResidueNameSet&) =
+        &prune::cofactors<default_id_list>;
+    m.def("prune_cofactors", cofactors_f, release_gil());
+
+    default_id_list (*keep_interactions_f)(const Frame&, default_id_list&,
+                                           const default_id_list&, double) =
+        &prune::keep_interactions<default_id_list>;
+    m.def("keep_interactions", keep_interactions_f, release_gil());
+
+    default_id_list (*remove_interactions_f)(const Frame&, default_id_list&,
+                                             const default_id_list&, double) =
+        &prune::remove_interactions<default_id_list>;
+    m.def("remove_interactions", remove_interactions_f, release_gil());
     m.def("intersection", prune::intersection<default_id_list>);
     m.def("has_property", prune::has_property<default_id_list>);
 
     /**************************************************************************
      * Separate
      **************************************************************************/
-    m.def("separate_residues", separate::residues<default_id_list>);
+    void (*residues_f)(const Frame&, const default_id_list&, Frame&,
+                       const std::string&) =
+        &separate::residues<default_id_list>;
+    m.def("separate_residues", residues_f, release_gil());
 
     m.def("separate_residues", [](const chemfiles::Frame& input,
                                   const default_id_list& accepted_residues,
                                   chemfiles::Frame& new_frame) {
         separate::residues(input, accepted_residues, new_frame);
-    });
+    }, release_gil());
 
-    m.def("separate_protein_and_ligand", separate::protein_and_ligand);
+    void (*protein_and_ligand_f)(const Frame&, size_t, double, Frame&, Frame&,
+                                 const std::string&) =
+        &separate::protein_and_ligand;
+    m.def("separate_protein_and_ligand", protein_and_ligand_f, release_gil());
 
     m.def("separate_protein_and_ligand", [](const chemfiles::Frame& input,
                                             size_t ligand_id,
@@ -218,9 +663,12 @@ void add_lemon_features(py::module& m) {
                                             chemfiles::Frame& protein,
                                             chemfiles::Frame& ligand) {
         separate::protein_and_ligand(input, ligand_id, pocket_size, protein, ligand);
-    });
+    }, release_gil());
 
-    m.def("separate_protein_and_ligands", separate::protein_and_ligands<default_id_list>);
+    void (*protein_and_ligands_f)(const Frame&, const default_id_list&, double,
+                                  Frame&, Frame&, const std::string&) =
+        &separate::protein_and_ligands<default_id_list>;
+    m.def("separate_protein_and_ligands", protein_and_ligands_f, release_gil());
 
     m.def("separate_protein_and_ligands", [](const chemfiles::Frame& input,
                                              const default_id_list& ligand_ids,
@@ -228,7 +676,7 @@ void add_lemon_features(py::module& m) {
                                              chemfiles::Frame& protein,
                                              chemfiles::Frame& ligand) {
         separate::protein_and_ligands(input, ligand_ids, pocket_size, protein, ligand);
-    });
+    }, release_gil());
 
     /**************************************************************************
      * geometry
@@ -249,7 +697,7 @@ void add_lemon_features(py::module& m) {
         });
 
     Affine (*kabsch_f)(Coordinates&, Coordinates&, double) = &kabsch;
-    m.def("kabsch", kabsch_f);
+    m.def("kabsch", kabsch_f, release_gil());
 
     void (*align_f)(span<Vector3D>&, const Affine&) = &align;
     m.def("align", align_f);
@@ -264,7 +712,10 @@ void add_lemon_features(py::module& m) {
         .def_readonly("hydrophobic", &xscore::VinaScore::hydrophobic)
         .def_readonly("hydrogen", &xscore::VinaScore::hydrogen);
 
-    m.def("vina_score", xscore::vina_score<default_id_list>);
+    xscore::VinaScore (*vina_score_f)(const Frame&, size_t, default_id_list,
+                                      double) =
+        &xscore::vina_score<default_id_list>;
+    m.def("vina_score", vina_score_f, release_gil());
 
     /**************************************************************************
      * TMAlign
@@ -275,5 +726,5 @@ void add_lemon_features(py::module& m) {
         .def_readonly("aligned", &tmalign::TMResult::aligned)
         .def_readonly("affine", &tmalign::TMResult::affine);
 
-    m.def("TMscore", tmalign::TMscore);
+    m.def("TMscore", tmalign::TMscore, release_gil());
 }
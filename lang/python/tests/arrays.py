@@ -0,0 +1,53 @@
+import lemon
+class MyWorkflow(lemon.Workflow):
+    def __init__(self):
+        import lemon
+        lemon.Workflow.__init__(self)
+        self.checked = []
+        self.failures = []
+    def worker(self, entry, pdbid):
+        import lemon
+
+        # Errors raised here are not passed on by launch, so they are kept
+        # and raised once it returns
+        try:
+            # The positions are viewed without a copy
+            positions = memoryview(entry.positions())
+            if positions.shape != (len(entry), 3) or positions.format != 'd':
+                raise RuntimeError("Bad positions")
+
+            residues = lemon.atom_residues(entry)
+            elements = lemon.atom_elements(entry)
+            altlocs = lemon.atom_altlocs(entry)
+            if len(residues) != len(entry) or len(elements) != len(entry) or \
+               len(altlocs) != len(entry):
+                raise RuntimeError("Bad atom columns")
+
+            # Selections are contiguous arrays of unsigned 64 bit integers
+            peptides = lemon.select_peptides(entry)
+            ids = memoryview(peptides)
+            if ids.format not in ('Q', 'L') or ids.itemsize != 8 or \
+               ids.shape != (len(peptides),):
+                raise RuntimeError("Bad selection")
+
+            # Python lists are still accepted
+            lemon.prune_identical_residues(entry, list(peptides))
+        except Exception as error:
+            self.failures.append(pdbid + ": " + str(error))
+            return ""
+
+        self.checked.append(pdbid)
+        return pdbid + '\t' + str(len(peptides)) + '\n'
+    def finalize(self):
+        pass
+
+wf = MyWorkflow()
+
+# The checks are kept on the workflow, so it must run in this process
+lemon.launch(wf, LEMON_HADOOP_DIR, LEMON_NUM_THREADS, processes=False)
+
+if wf.failures:
+    raise RuntimeError(", ".join(wf.failures))
+
+if len(wf.checked) != 6:
+    raise RuntimeError("Bad number of entries checked")
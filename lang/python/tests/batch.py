@@ -0,0 +1,28 @@
+import lemon
+class MyWorkflow(lemon.BatchWorkflow):
+    def __init__(self):
+        import lemon
+        lemon.BatchWorkflow.__init__(self)
+        self.sizes = []
+    def worker_batch(self, frames, pdbids):
+        self.sizes.append((len(frames), len(pdbids)))
+
+        result = ""
+        for frame, pdbid in zip(frames, pdbids):
+            result += pdbid + '\t' + str(len(frame)) + '\n'
+        return result
+    def finalize(self):
+        pass
+
+wf = MyWorkflow()
+
+lemon.launch(wf, LEMON_HADOOP_DIR, LEMON_NUM_THREADS, batch_size=4)
+
+# Errors raised by worker_batch are not passed on by launch, so the sizes of
+# the batches are checked here
+for frames, pdbids in wf.sizes:
+    if frames != pdbids or frames == 0 or frames > 4:
+        raise RuntimeError("Bad batch size: " + str(wf.sizes))
+
+if sum(frames for frames, _ in wf.sizes) != 6:
+    raise RuntimeError("Bad number of entries: " + str(wf.sizes))
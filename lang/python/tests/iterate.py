@@ -0,0 +1,18 @@
+from __future__ import print_function
+import lemon
+
+pdbids = []
+for pdbid, frame in lemon.iterate(LEMON_HADOOP_DIR, threads=LEMON_NUM_THREADS):
+    pdbids.append(pdbid)
+
+print(sorted(pdbids))
+if len(pdbids) != 6:
+    raise RuntimeError("Wrong number of entries")
+
+selected = [pdbid for pdbid, frame in lemon.iterate(LEMON_HADOOP_DIR, entries={"1DZF", "1DZI"})]
+if sorted(selected) != ["1DZF", "1DZI"]:
+    raise RuntimeError("Wrong selected entries")
+
+# Stopping early does not wait for the remaining entries
+for pdbid, frame in lemon.iterate(LEMON_HADOOP_DIR):
+    break
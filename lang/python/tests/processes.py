@@ -0,0 +1,20 @@
+from __future__ import print_function
+import lemon
+class MyWorkflow(lemon.Workflow):
+    def __init__(self):
+        import lemon
+        lemon.Workflow.__init__(self)
+        self.count = 0
+    def worker(self, entry, pdbid):
+        self.count += 1
+        return pdbid + '\n'
+    def finalize(self):
+        pass
+
+wf = MyWorkflow()
+
+lemon.launch(wf, LEMON_HADOOP_DIR, LEMON_NUM_THREADS, processes=True)
+
+# The workers ran on copies of the workflow
+if wf.count != 0:
+    raise RuntimeError("The workflow ran in the calling process")
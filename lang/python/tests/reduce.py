@@ -0,0 +1,25 @@
+from __future__ import print_function
+import lemon
+class MyWorkflow(lemon.Workflow):
+    def worker(self, entry, pdbid):
+        import lemon
+        if pdbid == "1DZI":
+            return None
+        return {"entries": 1, "atoms": len(entry), "first": [1, 0, 0.5], pdbid: 1,
+                "large": 2**53 + 1}
+    def finalize(self):
+        pass
+
+wf = MyWorkflow()
+
+totals = lemon.launch(wf, LEMON_HADOOP_DIR, LEMON_NUM_THREADS, reduce=True)
+print(totals)
+
+if totals["entries"] != 5 or totals["1DZE"] != 2 or "1DZI" in totals:
+    raise RuntimeError("Bad counts")
+
+if totals["first"] != [5, 0, 2.5]:
+    raise RuntimeError("Bad sequence")
+
+if totals["large"] != 5 * (2**53 + 1):
+    raise RuntimeError("Inexact sum of integers")
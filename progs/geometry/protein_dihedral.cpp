@@ -18,15 +18,14 @@ int main(int argc, char* argv[]) {
     o.parse_command_line(argc, argv);
 
     auto worker = [bin_size](chemfiles::Frame entry,
-                             const std::string& pdbid) {
-        DihedralCounts bins;
-        
+                             const std::string& pdbid,
+                             DihedralCounts& bins) {
         // Selection phase
         chemfiles::Frame protein_only;
         auto peptides = lemon::select::specific_residues(entry, lemon::common_peptides);
 
         if (peptides.empty()) {
-            return bins;
+            return;
         }
 
         lemon::separate::residues(entry, peptides, protein_only);
@@ -58,13 +57,10 @@ int main(int argc, char* argv[]) {
 
             ++(bin_iterator->second);
         }
-
-        return bins;
     };
 
     DihedralCounts sc_total;
-    auto collector = lemon::map_combine<DihedralCounts>(sc_total);
-    lemon::launch(o, worker, collector);
+    lemon::launch_reduce(o, worker, sc_total);
 
     for (const auto& i : sc_total) {
         std::cout << i.first.first << "\t"
@@ -13,17 +13,15 @@ int main(int argc, char* argv[]) {
     auto worker = [distance](const chemfiles::Frame& entry,
                              const std::string& pdbid) -> std::string {
 
-        // Selection phase
-        auto hemegs = lemon::select::specific_residues(
-            entry, {"HEM", "HEA", "HEB", "HEC"});
-        auto smallm = lemon::select::small_molecules(entry);
-
-        // Pruning phase
-        lemon::prune::identical_residues(entry, smallm);
-        lemon::prune::cofactors(entry, smallm, lemon::common_cofactors);
-        lemon::prune::cofactors(entry, smallm, lemon::common_fatty_acids);
-
-        lemon::prune::keep_interactions(entry, smallm, hemegs, distance);
+        // Selection and pruning phases, in a single pass over the residues
+        constexpr lemon::ResidueNameSet hemes("HEM", "HEA", "HEB", "HEC");
+        auto smallm = lemon::query(entry)
+                          .small_molecules()
+                          .same_assembly()
+                          .not_in(lemon::common_cofactors)
+                          .not_in(lemon::common_fatty_acids)
+                          .near(hemes, distance)
+                          .select();
 
         // Output phase
         return pdbid + lemon::count::print_residue_names(entry, smallm);
@@ -0,0 +1,27 @@
+#include <iostream>
+
+#include "lemon/launch.hpp"
+#include "lemon/structure_cache.hpp"
+
+int main(int argc, char* argv[]) {
+    lemon::Options o;
+    std::string outdir = ".";
+    o.add_option("--outdir,-o", outdir, "Directory to write the cache to")
+        ->check(CLI::ExistingDirectory);
+    o.parse_command_line(argc, argv);
+
+    try {
+        auto entries = lemon::read_entry_file(o.entries());
+        auto skip_entries = lemon::read_entry_file(o.skip_entries());
+
+        auto total = lemon::build_structure_cache(o.work_dir(), outdir, o.ncpu(),
+                                                  entries, skip_entries);
+
+        std::cout << "Cached " << total << " entries in " << outdir << "\n";
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <zlib.h>
+
+#include "lemon/launch.hpp"
+#include "lemon/pack.hpp"
+
+// Decompress a gzipped MMTF record. Returns false if the record is invalid.
+static bool inflate_record(chemfiles::span<const char> input,
+                           std::vector<char>& output) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    // 32 is added to the window size to decode gzip headers
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+
+    output.resize(std::max<size_t>(4 * input.size(), 4096));
+    size_t written = 0;
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (written == output.size()) {
+            output.resize(2 * output.size());
+        }
+        stream.next_out = reinterpret_cast<Bytef*>(output.data() + written);
+        stream.avail_out = static_cast<uInt>(output.size() - written);
+        status = inflate(&stream, Z_NO_FLUSH);
+        written = output.size() - stream.avail_out;
+    }
+
+    inflateEnd(&stream);
+    output.resize(written);
+    return status == Z_STREAM_END;
+}
+
+int main(int argc, char* argv[]) {
+    lemon::Options o;
+    std::string outdir = ".";
+    o.add_option("--outdir,-o", outdir, "Directory to write the pack files to")
+        ->check(CLI::ExistingDirectory);
+    o.parse_command_line(argc, argv);
+
+    if (lemon::is_pack_dir(outdir)) {
+        std::cerr << outdir << " already contains pack files\n";
+        return 1;
+    }
+
+    try {
+        auto entries = lemon::read_entry_file(o.entries());
+        auto skip_entries = lemon::read_entry_file(o.skip_entries());
+
+        lemon::Archive archive(o.work_dir());
+        auto records = archive.select(entries, skip_entries);
+
+        // Each pack file holds a contiguous range of PDB IDs
+        std::stable_sort(
+            records.begin(), records.end(),
+            [](const lemon::ArchiveRecord* a, const lemon::ArchiveRecord* b) {
+                return a->pdbid < b->pdbid;
+            });
+
+        auto ncpu = std::max<size_t>(1, std::min(o.ncpu(), records.size()));
+        std::vector<std::thread> threads(ncpu);
+        std::vector<std::exception_ptr> errors(ncpu);
+        std::vector<size_t> packed(ncpu, 0);
+
+        auto pack_range = [&](size_t index, size_t first, size_t last) {
+            try {
+                std::ostringstream name;
+                name << outdir << "/part-" << std::setw(5) << std::setfill('0')
+                     << index << lemon::PackFormat::EXTENSION;
+                lemon::PackWriter writer(name.str());
+
+                std::vector<char> buffer;
+                for (auto i = first; i < last; ++i) {
+                    const auto& record = *records[i];
+                    if (!inflate_record(archive.data(record), buffer)) {
+                        std::cerr << "Could not decompress " + record.pdbid +
+                                         "\n";
+                        continue;
+                    }
+                    writer.add(record.pdbid, buffer.data(), buffer.size());
+                }
+
+                writer.finish();
+                packed[index] = writer.size();
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
+        };
+
+        auto grainsize = records.size() / ncpu;
+        for (size_t i = 0; i < ncpu; ++i) {
+            auto last = i == ncpu - 1 ? records.size() : (i + 1) * grainsize;
+            threads[i] = std::thread(pack_range, i, i * grainsize, last);
+        }
+
+        for (auto&& thread : threads) {
+            thread.join();
+        }
+
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        size_t total = 0;
+        for (auto count : packed) {
+            total += count;
+        }
+
+        std::cout << "Packed " << total << " entries into " << ncpu
+                  << " files in " << outdir << "\n";
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <memory>
+#include "lemon/lemon.hpp"
+#include "lemon/launch.hpp"
+#include "lemon/query_plan.hpp"
+
+int main(int argc, char* argv[]) {
+    lemon::Options o;
+    std::string text;
+    auto explain = false;
+    o.add_option("--query,-q", text,
+                 "Query to run, for example: small_molecules & !cofactors & "
+                 "within(6.0, resn HEM) -> count resn")
+        ->required();
+    o.add_flag("--explain", explain, "Print the plan of the query and exit.");
+    o.parse_command_line(argc, argv);
+
+    std::unique_ptr<lemon::QueryPlan> plan;
+    try {
+        plan.reset(new lemon::QueryPlan(text));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (explain) {
+        std::cout << plan->str();
+        return 0;
+    }
+
+    const auto& query = *plan;
+    if (query.action() == lemon::QueryPlan::LIST) {
+        auto worker = [&query](const chemfiles::Frame& entry,
+                               const std::string& pdbid) -> std::string {
+            lemon::FrameIndex index(entry);
+            auto selected = query.select(index);
+            if (selected.empty()) {
+                return std::string("");
+            }
+
+            return pdbid + lemon::count::print_residue_names(entry, selected);
+        };
+
+        auto collector = lemon::print_combine(std::cout);
+        return lemon::launch(o, worker, collector);
+    }
+
+    if (query.action() == lemon::QueryPlan::COUNT) {
+        auto worker = [&query](const chemfiles::Frame& entry,
+                               const std::string& /*unused*/, size_t& count) {
+            lemon::FrameIndex index(entry);
+            count += query.select(index).size();
+        };
+
+        size_t total = 0;
+        auto merge = [](size_t& count1, size_t count2) { count1 += count2; };
+        auto result = lemon::launch_reduce(o, worker, total, merge);
+
+        std::cout << total << "\n";
+        return result;
+    }
+
+    auto worker = [&query](const chemfiles::Frame& entry,
+                           const std::string& /*unused*/,
+                           lemon::ResidueNameCount& counts) {
+        lemon::FrameIndex index(entry);
+        lemon::count::residues(entry, query.select(index), counts);
+    };
+
+    lemon::ResidueNameCount total;
+    auto result = lemon::launch_reduce(o, worker, total);
+
+    for (auto i : total) {
+        std::cout << i.first << "\t" << i.second << "\n";
+    }
+
+    return result;
+}
@@ -10,14 +10,17 @@ int main(int argc, char* argv[]) {
     auto worker = [](const chemfiles::Frame& entry,
                      const std::string& pdbid) -> std::string {
 
+        // Computed once for all ligands of the entry
+        lemon::FrameIndex index(entry);
+
         // Selection phase= 
-        auto smallm = lemon::select::small_molecules(entry);
+        auto smallm = lemon::select::small_molecules(index);
         if (smallm.empty()) {
             return std::string("");
         }
 
         // Pruning phase
-        lemon::prune::identical_residues(entry, smallm);
+        lemon::prune::identical_residues(index, smallm);
         lemon::prune::cofactors(entry, smallm, lemon::common_cofactors);
         lemon::prune::cofactors(entry, smallm, lemon::common_fatty_acids);
 
@@ -32,11 +35,11 @@ int main(int argc, char* argv[]) {
         for (auto smallm_id : smallm) {
             auto prot_copy = proteins;
 
-            lemon::prune::keep_interactions(entry, smallm, prot_copy, lemon::xscore::DEFAULT_INTERACTION_DISTANCE);
+            lemon::prune::keep_interactions(index, smallm, prot_copy, lemon::xscore::DEFAULT_INTERACTION_DISTANCE);
             prot_copy.erase(std::remove(prot_copy.begin(), prot_copy.end(), smallm_id), prot_copy.end());
 
             auto vscore =
-                lemon::xscore::vina_score(entry, smallm_id, prot_copy);
+                lemon::xscore::vina_score(index, smallm_id, prot_copy);
 
             result += pdbid + "\t" +
                 residues[smallm_id].name() + "\t" +
@@ -0,0 +1,165 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/frame_index.hpp"
+#include "lemon/prune.hpp"
+#include "lemon/select.hpp"
+#include "lemon/separate.hpp"
+#include "lemon/xscore.hpp"
+
+#include "random_frame.hpp"
+
+static std::vector<uint64_t> residue_ids(const chemfiles::Frame& frame) {
+    std::vector<uint64_t> ids;
+    for (const auto& residue : frame.topology().residues()) {
+        ids.push_back(*residue.id());
+    }
+    return ids;
+}
+
+TEST_CASE("Store the properties of a frame in tables") {
+    auto frame = random_frame(50, 1);
+    lemon::FrameTables tables(frame);
+    const auto& residues = frame.topology().residues();
+
+    REQUIRE(tables.residue_count() == 50);
+    REQUIRE(tables.size() == frame.size());
+
+    CHECK(tables.string(tables.composition_types()[0]) == "NON-POLYMER");
+    CHECK(tables.string(tables.composition_types()[7]) == "L-PEPTIDE LINKING");
+    CHECK(tables.chain_ids()[0] == tables.chain_ids()[2]);
+    CHECK(tables.chain_ids()[0] != tables.chain_ids()[1]);
+    CHECK(tables.assemblies()[0] == tables.assemblies()[3]);
+    CHECK(tables.string(tables.chain_names()[0]).empty());
+
+    auto matching = tables.matching({"OTHER", "RNA LINKING"});
+    CHECK(matching[tables.composition_types()[5]] == 1);
+    CHECK(matching[tables.composition_types()[2]] == 1);
+    CHECK(matching[tables.composition_types()[0]] == 0);
+
+    for (size_t i = 0; i < residues.size(); ++i) {
+        CHECK(tables.atom_counts()[i] == residues[i].size());
+        size_t heavy = 0;
+        for (auto atom : residues[i]) {
+            CHECK(tables.residue_of()[atom] == i);
+            heavy += *frame[atom].atomic_number() != 1;
+        }
+        CHECK(tables.heavy_atoms()[i] == heavy);
+    }
+
+    for (size_t atom = 0; atom < frame.size(); ++atom) {
+        auto altloc = frame[atom].get("altloc");
+        CHECK(tables.altlocs()[atom] ==
+              (altloc ? altloc->as_string()[0] : ' '));
+        CHECK(tables.atomic_numbers()[atom] == *frame[atom].atomic_number());
+    }
+}
+
+TEST_CASE("Select and prune with a FrameIndex") {
+    auto frame = random_frame(300, 3);
+    lemon::FrameIndex index(frame);
+
+    CHECK(index.residue_count() == 300);
+    CHECK(index.chain(1) == "B");
+    CHECK(index.assembly(3) == "1");
+    CHECK(index.kind(1) == lemon::FrameIndex::PEPTIDE);
+    CHECK(index.kind(2) == lemon::FrameIndex::NUCLEIC_ACID);
+    CHECK(index.kind(3) == lemon::FrameIndex::OTHER);
+    CHECK(index.tables().kinds()[1] == lemon::FrameTables::PEPTIDE);
+    CHECK(index.residue_of(0) == 0);
+
+    auto smallm = lemon::select::small_molecules(frame, {"NON-POLYMER"}, 4);
+    CHECK(lemon::select::small_molecules(index, {"NON-POLYMER"}, 4) == smallm);
+    CHECK(lemon::select::peptides(index) == lemon::select::peptides(frame));
+    CHECK(lemon::select::nucleic_acids(index) ==
+          lemon::select::nucleic_acids(frame));
+
+    auto all = lemon::select::small_molecules(frame, {"NON-POLYMER", "OTHER"}, 1);
+    auto expected = all;
+    auto res = all;
+    lemon::prune::identical_residues(frame, expected);
+    lemon::prune::identical_residues(index, res);
+    CHECK(res == expected);
+
+    auto peptides = lemon::select::peptides(frame);
+    for (auto cutoff : {0.0, 1.0, 4.0, 6.0, 15.0}) {
+        for (auto periodic : {false, true}) {
+            frame.set_cell(periodic ? chemfiles::UnitCell(41.0, 38.0, 45.0)
+                                    : chemfiles::UnitCell());
+            lemon::FrameIndex current(frame);
+
+            expected = all;
+            res = all;
+            lemon::prune::keep_interactions(frame, expected, peptides, cutoff);
+            lemon::prune::keep_interactions(current, res, peptides, cutoff);
+            CHECK(res == expected);
+
+            expected = all;
+            res = all;
+            lemon::prune::remove_interactions(frame, expected, peptides, cutoff);
+            lemon::prune::remove_interactions(current, res, peptides, cutoff);
+            CHECK(res == expected);
+        }
+    }
+}
+
+TEST_CASE("Separate and score with a FrameIndex") {
+    auto frame = random_frame(300, 5);
+    frame.set_cell(chemfiles::UnitCell(41.0, 38.0, 45.0));
+    lemon::FrameIndex index(frame);
+
+    for (auto cutoff : {0.0, 2.0, 6.0, 12.0}) {
+        chemfiles::Frame protein1, ligand1, protein2, ligand2;
+        lemon::separate::protein_and_ligand(frame, 12, cutoff, protein1,
+                                            ligand1);
+        lemon::separate::protein_and_ligand(index, 12, cutoff, protein2,
+                                            ligand2);
+        CHECK(residue_ids(protein1) == residue_ids(protein2));
+        CHECK(residue_ids(ligand1) == residue_ids(ligand2));
+        CHECK(protein1.size() == protein2.size());
+        CHECK(ligand1.size() == ligand2.size());
+
+        std::vector<size_t> ligands = {4, 100, 250};
+        chemfiles::Frame proteins1, ligands1, proteins2, ligands2;
+        lemon::separate::protein_and_ligands(frame, ligands, cutoff, proteins1,
+                                             ligands1);
+        lemon::separate::protein_and_ligands(index, ligands, cutoff, proteins2,
+                                             ligands2);
+        CHECK(residue_ids(proteins1) == residue_ids(proteins2));
+        CHECK(residue_ids(ligands1) == residue_ids(ligands2));
+        CHECK(proteins1.size() == proteins2.size());
+    }
+
+    std::vector<size_t> receptor = {1, 7, 13, 19, 25};
+    auto score1 = lemon::xscore::vina_score(frame, 12, receptor, 40.0);
+    auto score2 = lemon::xscore::vina_score(index, 12, receptor, 40.0);
+    CHECK(score1.g1 == score2.g1);
+    CHECK(score1.g2 == score2.g2);
+    CHECK(score1.rep == score2.rep);
+    CHECK(score1.hydrophobic == score2.hydrophobic);
+    CHECK(score1.hydrogen == score2.hydrogen);
+}
+
+TEST_CASE("Compare a FrameIndex with the frame of an entry") {
+    for (auto path : {"files/1AAQ.mmtf", "files/4XUF.mmtf.gz"}) {
+        auto frame = chemfiles::Trajectory(path, 'r').read();
+        lemon::FrameIndex index(frame);
+
+        auto smallm = lemon::select::small_molecules(frame);
+        CHECK(lemon::select::small_molecules(index) == smallm);
+        auto peptides = lemon::select::peptides(frame);
+        CHECK(lemon::select::peptides(index) == peptides);
+        CHECK(lemon::select::nucleic_acids(index) ==
+              lemon::select::nucleic_acids(frame));
+
+        for (auto cutoff : {4.0, 6.0}) {
+            auto expected = smallm;
+            auto res = smallm;
+            lemon::prune::keep_interactions(frame, expected, peptides, cutoff);
+            lemon::prune::keep_interactions(index, res, peptides, cutoff);
+            CHECK(res == expected);
+        }
+    }
+}
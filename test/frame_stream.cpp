@@ -0,0 +1,57 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/frame_stream.hpp"
+
+#include "scratch_directory.hpp"
+
+#include <set>
+#include <stdexcept>
+
+TEST_CASE("Read entries from a FrameStream") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    std::multiset<std::string> pdbids;
+    lemon::FrameStream stream(p, 2);
+    while (auto item = stream.next()) {
+        pdbids.insert(item->first);
+    }
+    CHECK(pdbids.size() == 6);
+    CHECK(pdbids.count("1DZE") == 2);
+    CHECK(!stream.next());
+
+    pdbids.clear();
+    lemon::FrameStream selected(p, 2, {"1DZE", "1DZF"}, {"1DZF"});
+    while (auto item = selected.next()) {
+        pdbids.insert(item->first);
+    }
+    CHECK(pdbids == std::multiset<std::string>({"1DZE", "1DZE"}));
+}
+
+TEST_CASE("Stop a FrameStream early") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    {
+        // Only one entry is taken before the stream is destroyed
+        lemon::FrameStream stream(p, 2, lemon::Entries(), lemon::Entries(), 1);
+        CHECK(stream.next());
+    }
+
+    lemon::FrameStream stream(p);
+    stream.close();
+    size_t remaining = 0;
+    while (stream.next()) {
+        ++remaining;
+    }
+    CHECK(remaining <= 2);
+}
+
+TEST_CASE("Report the errors of a FrameStream") {
+    lemon::FrameStream stream("not_a_directory");
+    CHECK_THROWS_AS(stream.next(), std::runtime_error&);
+    CHECK(!stream.next());
+}
@@ -0,0 +1,235 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/frame_view.hpp"
+#include "lemon/prune.hpp"
+#include "lemon/select.hpp"
+#include "lemon/separate.hpp"
+#include "lemon/structure_cache.hpp"
+
+#include "scratch_directory.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <set>
+
+// A small frame with a ligand, two peptide residues and a metal ion
+static chemfiles::Frame make_frame() {
+    chemfiles::Frame frame;
+
+    auto add_residue = [&frame](const std::string& name, uint64_t id,
+                                const std::string& type, size_t atoms,
+                                double x) {
+        chemfiles::Residue residue(name, id);
+        for (size_t i = 0; i < atoms; ++i) {
+            auto element = i == 0 ? "N" : (i % 3 == 0 ? "O" : "C");
+            frame.add_atom(chemfiles::Atom("A" + std::to_string(i), element),
+                           {x + 0.5 * static_cast<double>(i), 0, 0});
+            residue.add_atom(frame.size() - 1);
+        }
+        residue.set("composition_type", type);
+        residue.set("chainid", "AB");
+        residue.set("chainname", "A");
+        residue.set("assembly", "1");
+        frame.add_residue(std::move(residue));
+    };
+
+    add_residue("LIG", 1, "NON-POLYMER", 12, 0.0);
+    add_residue("ALA", 2, "L-PEPTIDE LINKING", 5, 8.0);
+    add_residue("GLY", 3, "L-PEPTIDE LINKING", 4, 30.0);
+
+    chemfiles::Atom zinc("ZN", "Zn");
+    zinc.set_charge(2.0);
+    zinc.set("altloc", "B");
+    frame.add_atom(zinc, {-3.0, 0, 0});
+    chemfiles::Residue ion("ZN", 4);
+    ion.add_atom(frame.size() - 1);
+    ion.set("composition_type", "NON-POLYMER");
+    frame.add_residue(std::move(ion));
+
+    frame.add_bond(0, 1, chemfiles::Bond::SINGLE);
+    frame.add_bond(1, 2, chemfiles::Bond::DOUBLE);
+    frame.add_bond(12, 13);
+
+    return frame;
+}
+
+TEST_CASE("Store a frame in columns") {
+    auto frame = make_frame();
+    std::vector<char> buffer;
+    lemon::write_frame_view(frame, buffer);
+    lemon::FrameView view(buffer.data(), buffer.size());
+
+    CHECK(view.size() == frame.size());
+    CHECK(view.residue_count() == 4);
+    CHECK(view.bond_count() == 3);
+
+    CHECK(view.atom_name(3) == "A3");
+    CHECK(view.atom_type(3) == "O");
+    CHECK(view.atomic_number(0) == 7);
+    CHECK(view.charge(21) == 2.0f);
+    CHECK(view.altloc(21) == 'B');
+    CHECK(view.altloc(0) == ' ');
+    CHECK(view.position(1)[0] == 0.5f);
+    CHECK(view.distance(0, 12) == Approx(frame.distance(0, 12)));
+
+    auto residue = view.residue(1);
+    CHECK(residue.name() == "ALA");
+    CHECK(*residue.id() == 2);
+    CHECK(residue.size() == 5);
+    CHECK(*residue.begin() == 12);
+    CHECK(residue.composition_type() == "L-PEPTIDE LINKING");
+    CHECK(residue.chainid() == "AB");
+    CHECK(residue.chainname() == "A");
+    CHECK(residue.assembly() == "1");
+    CHECK(view.residue(3).assembly() == "");
+
+    CHECK(view.bonded_end(1) - view.bonded_begin(1) == 2);
+    CHECK(view.bond_order(1, 1) == chemfiles::Bond::DOUBLE);
+    CHECK(view.bonded_end(5) == view.bonded_begin(5));
+
+    buffer[0] = 42;
+    CHECK_THROWS_AS(lemon::FrameView(buffer.data(), buffer.size()),
+                    std::runtime_error&);
+    CHECK_THROWS_AS(lemon::FrameView(buffer.data(), 8), std::runtime_error&);
+}
+
+TEST_CASE("Reject stored structures with invalid columns") {
+    using Layout = lemon::FrameViewLayout;
+    std::vector<char> buffer;
+    lemon::write_frame_view(make_frame(), buffer);
+    lemon::FrameView(buffer.data(), buffer.size());
+
+    Layout::Header header;
+    std::memcpy(&header, buffer.data(), sizeof(header));
+
+    // Change a value of the header or a column, and expect an error
+    auto corrupt = [&buffer](size_t position, const void* value, size_t size) {
+        auto copy = buffer;
+        std::memcpy(&copy[position], value, size);
+        return copy;
+    };
+    auto rejected = [](const std::vector<char>& data) {
+        try {
+            lemon::FrameView(data.data(), data.size());
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+
+    // A header count which does not match the stored columns
+    uint64_t count = header.residues - 1;
+    CHECK(rejected(corrupt(offsetof(Layout::Header, residues), &count, 8)));
+    count = header.bonds + 1;
+    CHECK(rejected(corrupt(offsetof(Layout::Header, bonds), &count, 8)));
+    count = ~uint64_t(0);
+    CHECK(rejected(corrupt(offsetof(Layout::Header, atoms), &count, 8)));
+
+    // Offsets which decrease or point past their columns
+    auto residue_offsets = header.offsets[Layout::RESIDUE_OFFSETS];
+    uint32_t offset = static_cast<uint32_t>(header.residue_atoms + 1);
+    CHECK(rejected(corrupt(residue_offsets + 4 * header.residues, &offset, 4)));
+    offset = 0;
+    CHECK(rejected(corrupt(residue_offsets + 8, &offset, 4)));
+    offset = 1;
+    CHECK(rejected(corrupt(header.offsets[Layout::BOND_OFFSETS], &offset, 4)));
+
+    // Atom and string indexes out of range
+    auto index = static_cast<uint32_t>(header.atoms);
+    CHECK(rejected(corrupt(header.offsets[Layout::RESIDUE_ATOMS], &index, 4)));
+    CHECK(rejected(corrupt(header.offsets[Layout::BOND_NEIGHBORS], &index, 4)));
+    index = static_cast<uint32_t>(header.strings);
+    CHECK(rejected(corrupt(header.offsets[Layout::RESIDUE_NAME], &index, 4)));
+    CHECK(rejected(corrupt(header.offsets[Layout::ATOM_TYPE], &index, 4)));
+
+    // A truncated structure
+    CHECK(rejected(std::vector<char>(buffer.begin(), buffer.end() - 8)));
+}
+
+TEST_CASE("Select, prune and separate a FrameView") {
+    auto frame = make_frame();
+    std::vector<char> buffer;
+    lemon::write_frame_view(frame, buffer);
+    lemon::FrameView view(buffer.data(), buffer.size());
+
+    auto smallm = lemon::select::small_molecules(view);
+    CHECK(smallm == lemon::select::small_molecules(frame));
+    CHECK(smallm.size() == 1);
+
+    CHECK(lemon::select::metal_ions(view) ==
+          lemon::select::metal_ions(frame));
+    CHECK(lemon::select::peptides(view) == lemon::select::peptides(frame));
+    CHECK(lemon::select::nucleic_acids(view).empty());
+    CHECK(lemon::select::specific_residues(view, {"GLY"}).size() == 1);
+    CHECK(lemon::select::residue_ids(view, {2, 4}).size() == 2);
+
+    auto peptides = lemon::select::peptides(view);
+    auto kept = smallm;
+    lemon::prune::keep_interactions(view, kept, peptides, 3.0);
+    CHECK(kept.size() == 1);
+
+    kept = smallm;
+    lemon::prune::keep_interactions(view, kept, peptides, 2.0);
+    CHECK(kept.empty());
+
+    kept = smallm;
+    lemon::prune::remove_interactions(view, kept, peptides, 2.0);
+    CHECK(kept.size() == 1);
+
+    kept = smallm;
+    lemon::prune::cofactors(view, kept, {"LIG"});
+    CHECK(kept.empty());
+
+    auto all = std::vector<uint64_t>{0, 1, 3};
+    lemon::prune::identical_residues(view, all);
+    CHECK(all.size() == 2);
+
+    chemfiles::Frame protein, ligand;
+    lemon::separate::protein_and_ligand(view, 0, 6.0, protein, ligand);
+    CHECK(ligand.size() == 12);
+    CHECK(ligand.topology().bonds().size() == 2);
+    CHECK(protein.size() == 5);
+    CHECK(protein.topology().residues().size() == 2); // Zinc is in altloc B
+
+    chemfiles::Frame protein2, ligand2;
+    lemon::separate::protein_and_ligand(frame, 0, 6.0, protein2, ligand2);
+    CHECK(protein.size() == protein2.size());
+    CHECK(protein.topology().residues().size() ==
+          protein2.topology().residues().size());
+    CHECK(ligand.size() == ligand2.size());
+}
+
+TEST_CASE("Build and use a structure cache") {
+    ScratchDirectory input, output;
+    auto p = input.copy_sequence_files();
+    output.file("part-00000.lmcache");
+    output.file("part-00001.lmcache");
+
+    auto total = lemon::build_structure_cache(p, output.path(), 2);
+    CHECK(lemon::is_structure_cache_dir(output.path()));
+    CHECK_THROWS_AS(lemon::build_structure_cache(p, output.path()),
+                    std::runtime_error&);
+
+    lemon::StructureCache cache(output.path());
+    CHECK(cache.size() == total);
+
+    std::multiset<std::string> pdbids;
+    auto worker = [](const lemon::FrameView& view, const std::string& pdbid) {
+        return pdbid + std::to_string(view.size());
+    };
+    auto collector = [&pdbids](const std::string& result) {
+        pdbids.insert(result);
+    };
+    lemon::run_cached(worker, output.path(), collector, 2);
+    CHECK(pdbids.size() == total);
+
+    // The workers stop when the collector throws
+    auto failing = [](const std::string&) {
+        throw std::runtime_error("Collector failed");
+    };
+    CHECK_THROWS_AS(lemon::run_cached(worker, output.path(), failing, 2),
+                    std::runtime_error&);
+}
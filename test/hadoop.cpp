@@ -3,15 +3,27 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+#include "lemon/archive.hpp"
 #include "lemon/hadoop.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <fstream>
+#include <iterator>
+#include <map>
 #include <mutex>
+#include <set>
+#include <thread>
 
 #include "lemon/count.hpp"
 #include "lemon/parallel.hpp"
+#include "lemon/reorder_buffer.hpp"
+#include "lemon/work_stealing.hpp"
 #include "lemon/launch.hpp"
 
+#include "scratch_directory.hpp"
+
 TEST_CASE("Read single MMTF Sequence File") {
     std::ifstream hadoop_file("files/rcsb_hadoop/hadoop", std::istream::binary);
     lemon::Hadoop sequence(hadoop_file);
@@ -48,8 +60,179 @@ TEST_CASE("Read multiple MMTF Sequence File") {
     CHECK(count == 5);
 }
 
+TEST_CASE("Skip unwanted records in a MMTF Sequence File") {
+    std::ifstream hadoop_file("files/rcsb_hadoop/hadoop_multiple",
+                              std::istream::binary);
+    lemon::Hadoop sequence(hadoop_file);
+
+    std::ifstream hadoop_file2("files/rcsb_hadoop/hadoop_multiple",
+                               std::istream::binary);
+    lemon::Hadoop skipping(hadoop_file2);
+
+    lemon::MappedHadoop mapped("files/rcsb_hadoop/hadoop_multiple");
+
+    std::vector<std::string> keys;
+    while (sequence.has_next()) {
+        auto expected = sequence.next();
+        keys.push_back(expected.first);
+
+        CHECK(skipping.next_key() == expected.first);
+        CHECK(mapped.next_key() == expected.first);
+
+        if (expected.first != "1DZG") {
+            skipping.skip_value();
+            continue; // The mapped value is skipped by the next call
+        }
+
+        CHECK(skipping.value() == expected.second);
+
+        auto value = mapped.value();
+        REQUIRE(value.size() == expected.second.size());
+        CHECK(std::equal(value.begin(), value.end(), expected.second.begin()));
+    }
+
+    CHECK(!skipping.has_next());
+    CHECK(!mapped.has_next());
+    auto expected_keys =
+        std::vector<std::string>{"1DZE", "1DZF", "1DZG", "1DZH", "1DZI"};
+    CHECK(keys == expected_keys);
+}
+
+TEST_CASE("Read memory mapped MMTF Sequence File") {
+    std::ifstream hadoop_file("files/rcsb_hadoop/hadoop_multiple",
+                              std::istream::binary);
+    lemon::Hadoop sequence(hadoop_file);
+    lemon::MappedHadoop mapped("files/rcsb_hadoop/hadoop_multiple");
+
+    size_t count = 0;
+    while (mapped.has_next()) {
+        REQUIRE(sequence.has_next());
+        auto expected = sequence.next();
+        auto result = mapped.next();
+
+        CHECK(result.first == expected.first);
+        REQUIRE(result.second.size() == expected.second.size());
+        CHECK(std::equal(result.second.begin(), result.second.end(),
+                         expected.second.begin()));
+
+        auto traj = chemfiles::Trajectory::memory_reader(
+            result.second.data(),
+            result.second.size(),
+            "MMTF/GZ"
+        );
+        auto frame = traj.read();
+        ++count;
+    }
+    CHECK(!sequence.has_next());
+    CHECK(count == 5);
+
+    CHECK_THROWS_AS(lemon::MappedHadoop("files/nofile"), std::runtime_error&);
+}
+
+TEST_CASE("Reject records with an invalid key") {
+    std::ifstream input("files/rcsb_hadoop/hadoop", std::istream::binary);
+    std::vector<char> buffer((std::istreambuf_iterator<char>(input)),
+                             std::istreambuf_iterator<char>());
+
+    // The key length follows the length of the first record
+    size_t offset = lemon::Hadoop::HADOOP_HEADER_SIZE - 3 + 4;
+    REQUIRE(buffer.size() > offset + 4);
+    buffer[offset] = buffer[offset + 1] = buffer[offset + 2] = 0;
+    buffer[offset + 3] = 4;
+
+    ScratchDirectory scratch;
+    auto path = scratch.file("hadoop_short_key");
+    {
+        std::ofstream output(path, std::ostream::binary);
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+
+    lemon::MappedHadoop mapped(path);
+    REQUIRE(mapped.has_next());
+    CHECK_THROWS_AS(mapped.next_key(), std::runtime_error&);
+
+    std::ifstream stream(path, std::istream::binary);
+    lemon::Hadoop sequence(stream);
+    REQUIRE(sequence.has_next());
+    CHECK_THROWS_AS(sequence.next_key(), std::runtime_error&);
+}
+
+TEST_CASE("Random access to an archive of Sequence Files") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    lemon::Archive archive(p);
+    CHECK(archive.files().size() == 2);
+    CHECK(archive.size() == 6); // 1DZE is in both files
+    CHECK(archive.contains("1DZE"));
+    CHECK(archive.contains("1DZI"));
+    CHECK(!archive.contains("1AAQ"));
+
+    auto data = archive.data("1DZG");
+    std::ifstream hadoop_file("files/rcsb_hadoop/hadoop_multiple",
+                              std::istream::binary);
+    lemon::Hadoop sequence(hadoop_file);
+    while (sequence.has_next()) {
+        auto result = sequence.next();
+        if (result.first == "1DZG") {
+            REQUIRE(result.second.size() == data.size());
+            CHECK(std::equal(data.begin(), data.end(), result.second.begin()));
+        }
+    }
+
+    auto frame = archive.get("1DZH");
+    CHECK_THROWS_AS(archive.get("1AAQ"), std::out_of_range&);
+
+    CHECK(archive.select().size() == 6);
+    CHECK(archive.select({"1DZE", "1AAQ"}).size() == 2);
+    CHECK(archive.select({"1DZE", "1DZF"}, {"1DZE"}).size() == 1);
+    CHECK(archive.select({}, {"1DZF"}).size() == 5);
+
+    // The second archive uses the index written by the first
+    std::ifstream index(scratch.file(lemon::Archive::INDEX_NAME));
+    CHECK(index.good());
+
+    lemon::Archive archive2(p);
+    REQUIRE(archive2.size() == archive.size());
+    for (size_t i = 0; i < archive.size(); ++i) {
+        CHECK(archive2.records()[i].pdbid == archive.records()[i].pdbid);
+        CHECK(archive2.records()[i].offset == archive.records()[i].offset);
+        CHECK(archive2.records()[i].length == archive.records()[i].length);
+    }
+}
+
+TEST_CASE("Rebuild the index of a rewritten sequence file") {
+    ScratchDirectory scratch;
+    auto path = scratch.file("hadoop");
+
+    std::ifstream input("files/rcsb_hadoop/hadoop", std::istream::binary);
+    std::vector<char> buffer((std::istreambuf_iterator<char>(input)),
+                             std::istreambuf_iterator<char>());
+    auto write = [&]() {
+        std::ofstream output(path, std::ostream::binary);
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    };
+
+    write();
+    lemon::Archive archive(scratch.path());
+    REQUIRE(archive.size() == 1);
+    auto pdbid = archive.records()[0].pdbid;
+
+    // Same size and, most likely, the same modification time: the ID in the
+    // key of the first record is changed
+    auto key = lemon::Hadoop::HADOOP_HEADER_SIZE - 3 + 8 + 1;
+    REQUIRE(std::string(buffer.data() + key, 4) == pdbid);
+    buffer[static_cast<size_t>(key) + 3] = 'X';
+    write();
+
+    lemon::Archive rewritten(scratch.path());
+    CHECK(rewritten.contains(pdbid.substr(0, 3) + "X"));
+    CHECK(!rewritten.contains(pdbid));
+}
+
 TEST_CASE("Use run_parallel") {
-    std::string p("files/rcsb_hadoop");
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
 
     auto worker = [](const chemfiles::Frame& entry,
                      const std::string& /*unused*/) -> lemon::ResidueNameCount {
@@ -66,7 +249,8 @@ TEST_CASE("Use run_parallel") {
 }
 
 TEST_CASE("Use run_parallel, but only for a entry") {
-    std::string p("files/rcsb_hadoop");
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
 
     auto worker = [](const chemfiles::Frame& entry,
                      const std::string& /*unused*/) -> lemon::ResidueNameCount {
@@ -85,7 +269,8 @@ TEST_CASE("Use run_parallel, but only for a entry") {
 }
 
 TEST_CASE("Use run_parallel, but skip a entry") {
-    std::string p("files/rcsb_hadoop");
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
 
     auto worker = [](const chemfiles::Frame& entry,
                      const std::string& /*unused*/) -> lemon::ResidueNameCount {
@@ -102,6 +287,242 @@ TEST_CASE("Use run_parallel, but skip a entry") {
     CHECK(totals.size() == 28);
 }
 
+TEST_CASE("Pass on the errors of the collector") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    auto worker = [](const chemfiles::Frame& /*unused*/,
+                     const std::string& pdbid) { return pdbid; };
+
+    size_t collected = 0;
+    auto collector = [&collected](const std::string& /*unused*/) {
+        if (++collected == 2) {
+            throw std::runtime_error("Collector error");
+        }
+    };
+
+    CHECK_THROWS_AS(lemon::run_parallel(worker, p, collector, 2),
+                    std::runtime_error&);
+    CHECK(collected == 2);
+
+    collected = 0;
+    lemon::PipelineThreads threads;
+    threads.worker = 2;
+    CHECK_THROWS_AS(lemon::run_pipeline(worker, p, collector, threads),
+                    std::runtime_error&);
+    CHECK(collected == 2);
+}
+
+TEST_CASE("Keep the readable records of a truncated sequence file") {
+    ScratchDirectory scratch;
+    auto path = scratch.file("hadoop_multiple");
+
+    // Cut the file in the third record
+    std::vector<std::string> expected;
+    size_t size = 0;
+    {
+        lemon::MappedHadoop sequence("files/rcsb_hadoop/hadoop_multiple");
+        expected.push_back(sequence.next().first);
+        expected.push_back(sequence.next().first);
+        size = sequence.position() + 100;
+    }
+
+    std::ifstream input("files/rcsb_hadoop/hadoop_multiple",
+                        std::istream::binary);
+    std::vector<char> buffer(size);
+    input.read(buffer.data(), static_cast<std::streamsize>(size));
+    {
+        std::ofstream output(path, std::ostream::binary);
+        output.write(buffer.data(), static_cast<std::streamsize>(size));
+    }
+
+    auto worker = [](const chemfiles::Frame& /*unused*/,
+                     const std::string& pdbid) { return pdbid; };
+
+    std::vector<std::string> collected;
+    auto collector = [&collected](const std::string& pdbid) {
+        collected.push_back(pdbid);
+    };
+
+    lemon::PipelineThreads threads;
+    threads.worker = 2;
+    lemon::run_pipeline(worker, scratch.path(), collector, threads);
+    std::sort(collected.begin(), collected.end());
+    std::sort(expected.begin(), expected.end());
+    CHECK(collected == expected);
+
+    collected.clear();
+    lemon::run_parallel(worker, scratch.path(), collector, 2);
+    std::sort(collected.begin(), collected.end());
+    CHECK(collected == expected);
+}
+
+TEST_CASE("Use run_pipeline") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    auto worker = [](const chemfiles::Frame& entry,
+                     const std::string& /*unused*/) -> lemon::ResidueNameCount {
+        lemon::ResidueNameCount resn_counts;
+        lemon::count::residues(entry, resn_counts);
+        return resn_counts;
+    };
+
+    lemon::PipelineThreads threads;
+    threads.io = 2;
+    threads.decode = 2;
+    threads.worker = 2;
+    threads.queue_size = 1;
+
+    lemon::ResidueNameCount totals;
+    auto collector = lemon::map_combine<lemon::ResidueNameCount>(totals);
+    lemon::run_pipeline(worker, p, collector, threads);
+    CHECK(totals.size() == 36);
+
+    lemon::ResidueNameCount totals2;
+    auto collector2 = lemon::map_combine<lemon::ResidueNameCount>(totals2);
+    std::unordered_set<std::string> e({"1DZE"});
+    lemon::run_pipeline(worker, p, collector2, threads, e);
+    CHECK(totals2.size() == 27);
+
+    lemon::ResidueNameCount totals3;
+    auto collector3 = lemon::map_combine<lemon::ResidueNameCount>(totals3);
+    lemon::run_pipeline(worker, p, collector3, threads, lemon::Entries(), e);
+    CHECK(totals3.size() == 28);
+}
+
+TEST_CASE("Use run_batches") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    auto worker = [](std::vector<chemfiles::Frame> frames,
+                     const std::vector<std::string>& pdbids) {
+        CHECK(frames.size() == pdbids.size());
+        return pdbids;
+    };
+
+    lemon::PipelineThreads threads;
+    threads.decode = 2;
+    threads.worker = 2;
+
+    std::vector<size_t> sizes;
+    std::multiset<std::string> pdbids;
+    auto collector = [&sizes, &pdbids](const std::vector<std::string>& batch) {
+        sizes.push_back(batch.size());
+        pdbids.insert(batch.begin(), batch.end());
+    };
+
+    lemon::run_batches(worker, p, collector, threads, 4);
+    CHECK(pdbids.size() == 6);
+    CHECK(pdbids.count("1DZE") == 2);
+    for (auto size : sizes) {
+        CHECK(size <= 4);
+    }
+    CHECK(sizes.size() >= 2);
+
+    pdbids.clear();
+    std::unordered_set<std::string> e({"1DZE"});
+    lemon::run_batches(worker, p, collector, threads, 4, lemon::Entries(), e);
+    CHECK(pdbids.size() == 4);
+    CHECK(pdbids.count("1DZE") == 0);
+}
+
+TEST_CASE("Use run_reduce") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+    using Counts = std::map<std::string, size_t>;
+
+    auto worker = [](const chemfiles::Frame& /*unused*/,
+                     const std::string& pdbid, Counts& counts) {
+        ++counts[pdbid];
+    };
+
+    Counts totals;
+    lemon::run_reduce(worker, p, totals, lemon::map_merge<Counts>(), 3);
+    CHECK(totals.size() == 5);
+    CHECK(totals["1DZE"] == 2);
+    CHECK(totals["1DZI"] == 1);
+
+    // Results are added to the existing total
+    lemon::run_reduce(worker, p, totals, lemon::map_merge<Counts>(), 1,
+                      {"1DZE"});
+    CHECK(totals["1DZE"] == 4);
+}
+
+TEST_CASE("Use run_ordered") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    auto worker = [](const chemfiles::Frame& /*unused*/,
+                     const std::string& pdbid) { return pdbid; };
+
+    std::vector<std::string> pdbids;
+    auto collector = [&pdbids](const std::string& pdbid) {
+        pdbids.push_back(pdbid);
+    };
+
+    lemon::run_ordered(worker, p, collector, 3);
+    CHECK(pdbids.size() == 6);
+    CHECK(std::is_sorted(pdbids.begin(), pdbids.end()));
+
+    pdbids.clear();
+    lemon::run_ordered(worker, p, collector, 2, {"1DZE", "1DZH"}, {"1DZH"});
+    CHECK(pdbids == std::vector<std::string>({"1DZE", "1DZE"}));
+
+    // Workers splitting their entries while the other workers are busy
+    auto nested = [](const chemfiles::Frame& entry, const std::string& pdbid) {
+        std::atomic<size_t> atoms(0);
+        lemon::parallel_for(0, entry.size(), [&atoms](size_t) { ++atoms; });
+        return atoms == entry.size() ? pdbid : std::string();
+    };
+
+    pdbids.clear();
+    lemon::run_ordered(nested, p, collector, 4);
+    CHECK(pdbids.size() == 6);
+    CHECK(std::is_sorted(pdbids.begin(), pdbids.end()));
+    CHECK(std::find(pdbids.begin(), pdbids.end(), "") == pdbids.end());
+}
+
+TEST_CASE("Reorder results from several threads") {
+    lemon::reorder_buffer<int> results(3);
+
+    std::thread producer([&results] {
+        results.push(2, 12);
+        results.push(1, chemfiles::nullopt);
+        results.push(0, 10);
+        results.push(3, 13); // Waits for the first results to be taken
+        results.close();
+    });
+
+    CHECK(*results.pop() == 10);
+    CHECK(*results.pop() == 12);
+    CHECK(*results.pop() == 13);
+    CHECK(!results.pop());
+    producer.join();
+
+    CHECK(!results.push(4, 14));
+}
+
+TEST_CASE("Steal work from other threads") {
+    lemon::work_stealing_queue<int> jobs(2);
+    CHECK(jobs.workers() == 2);
+    CHECK(!jobs.pop(0));
+
+    jobs.push(0, 1);
+    jobs.push(0, 2);
+    jobs.push(0, 3);
+    jobs.push_front(0, {4, 5});
+
+    // The owner takes jobs from the front, other workers from the back
+    CHECK(*jobs.pop(0) == 4);
+    CHECK(*jobs.pop(1) == 3);
+    CHECK(*jobs.pop(0) == 5);
+    CHECK(*jobs.pop(0) == 1);
+    CHECK(*jobs.pop(1) == 2);
+    CHECK(!jobs.pop(0));
+    CHECK(!jobs.pop(1));
+}
+
 TEST_CASE("Provide an invalid directory to Hadoop run") {
     CHECK_THROWS_AS(lemon::read_hadoop_dir({"/nodir/"}), std::runtime_error&);
     CHECK_THROWS_AS(lemon::read_hadoop_dir({"."}), std::runtime_error&);
@@ -0,0 +1,93 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/pack.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+#include "lemon/parallel.hpp"
+
+static std::vector<char> read_file(const std::string& path) {
+    std::ifstream input(path, std::istream::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(input),
+                             std::istreambuf_iterator<char>());
+}
+
+TEST_CASE("Write and read a pack file") {
+    auto mmtf = read_file("files/1AAQ.mmtf");
+    REQUIRE(!mmtf.empty());
+
+    const std::string path = "files/test_pack.lemon";
+    {
+        lemon::PackWriter writer(path);
+        writer.add("1AAQ", mmtf.data(), mmtf.size());
+        writer.add("0XYZ", mmtf.data(), 17);
+        writer.add("1AAQ", mmtf.data(), mmtf.size());
+        CHECK(writer.size() == 3);
+        CHECK_THROWS_AS(writer.add("", mmtf.data(), 1), std::runtime_error&);
+        CHECK_THROWS_AS(writer.add("PDB_000000001AAQX", mmtf.data(), 1),
+                        std::runtime_error&);
+    }
+
+    CHECK(lemon::is_pack_dir("files"));
+    CHECK(!lemon::is_pack_dir("files/rcsb_hadoop"));
+
+    lemon::Pack pack("files");
+    CHECK(pack.files().size() == 1);
+    CHECK(pack.size() == 3);
+    CHECK(pack.contains("1AAQ"));
+    CHECK(pack.contains("0XYZ"));
+    CHECK(!pack.contains("1DZE"));
+
+    // Records are aligned and in the order they were written
+    for (const auto& record : pack.records()) {
+        CHECK(record.offset % lemon::PackFormat::ALIGNMENT == 0);
+    }
+    CHECK(pack.records()[0].pdbid == "1AAQ");
+    CHECK(pack.records()[1].pdbid == "0XYZ");
+
+    auto data = pack.data("1AAQ");
+    REQUIRE(data.size() == mmtf.size());
+    CHECK(std::equal(data.begin(), data.end(), mmtf.begin()));
+    CHECK(pack.data("0XYZ").size() == 17);
+    CHECK_THROWS_AS(pack.data("1DZE"), std::out_of_range&);
+
+    auto frame = pack.get("1AAQ");
+    auto expected = chemfiles::Trajectory("files/1AAQ.mmtf").read();
+    CHECK(frame.size() == expected.size());
+
+    CHECK(pack.select().size() == 3);
+    CHECK(pack.select({"1AAQ"}).size() == 2);
+    CHECK(pack.select({}, {"1AAQ"}).size() == 1);
+
+    std::multiset<std::string> pdbids;
+    auto worker = [](chemfiles::Frame /*unused*/, const std::string& pdbid) {
+        return pdbid;
+    };
+    auto collector = [&pdbids](const std::string& pdbid) {
+        pdbids.insert(pdbid);
+    };
+    lemon::run_parallel(worker, "files", collector, 2, {"1AAQ"});
+    CHECK(pdbids.size() == 2);
+    CHECK(pdbids.count("1AAQ") == 2);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Reject invalid pack files") {
+    CHECK_THROWS_AS(lemon::Pack("files/rcsb_hadoop"), std::runtime_error&);
+
+    const std::string path = "files/test_invalid.lemon";
+    {
+        std::ofstream output(path, std::ofstream::binary);
+        output << "This is not a pack file";
+    }
+
+    CHECK_THROWS_AS(lemon::Pack("files"), std::runtime_error&);
+    std::remove(path.c_str());
+}
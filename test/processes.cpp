@@ -0,0 +1,75 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/processes.hpp"
+
+#include "scratch_directory.hpp"
+
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+
+#ifndef _WIN32
+
+TEST_CASE("Use run_processes") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    size_t calls = 0;
+    auto worker = [&calls](const chemfiles::Frame& /*unused*/,
+                           const std::string& pdbid) {
+        ++calls;
+        return pdbid;
+    };
+
+    std::multiset<std::string> pdbids;
+    auto collector = [&pdbids](const std::string& pdbid) {
+        pdbids.insert(pdbid);
+    };
+
+    lemon::run_processes(worker, p, collector, 3);
+    CHECK(pdbids.size() == 6);
+    CHECK(pdbids.count("1DZE") == 2);
+
+    // The worker runs in other processes
+    CHECK(calls == 0);
+
+    pdbids.clear();
+    lemon::run_processes(worker, p, collector, 2, {"1DZE", "1DZF"}, {"1DZF"});
+    CHECK(pdbids == std::multiset<std::string>({"1DZE", "1DZE"}));
+}
+
+TEST_CASE("Handle failing processes") {
+    ScratchDirectory scratch;
+    auto p = scratch.copy_sequence_files();
+
+    auto worker = [](const chemfiles::Frame& /*unused*/,
+                     const std::string& pdbid) { return pdbid; };
+
+    size_t collected = 0;
+    auto collector = [&collected](const std::string& /*unused*/) {
+        ++collected;
+    };
+
+    size_t forks = 0;
+    lemon::ProcessHooks hooks;
+    hooks.before_fork = [&forks] { ++forks; };
+    hooks.finish = [] { throw std::runtime_error("Worker process error"); };
+
+    CHECK_THROWS_AS(lemon::run_processes(worker, p, collector, 2,
+                                         lemon::Entries(), lemon::Entries(),
+                                         hooks),
+                    std::runtime_error&);
+    CHECK(collected == 6);
+    CHECK(forks == 2);
+
+    auto throwing = [](const std::string& /*unused*/) {
+        throw std::runtime_error("Collector error");
+    };
+    CHECK_THROWS_AS(lemon::run_processes(worker, p, throwing, 2),
+                    std::runtime_error&);
+}
+
+#endif
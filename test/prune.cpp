@@ -1,6 +1,7 @@
 #include "lemon/prune.hpp"
 #include <chemfiles.hpp>
 #include "lemon/select.hpp"
+#include "random_frame.hpp"
 #include <iostream>
 
 #define CATCH_CONFIG_MAIN
@@ -106,4 +107,81 @@ TEST_CASE("Intersection of chain ID and peptides") {
     lemon::prune::has_property(frame, res2, "chainid", "A");
     CHECK(res2.size() == 99);
     std::cout << "HERE" << std::endl;
-}
\ No newline at end of file
+}
+
+static std::vector<size_t> brute_force(const chemfiles::Frame& frame,
+                                       const std::vector<size_t>& residue_ids,
+                                       const std::vector<size_t>& interaction_ids,
+                                       double distance_cutoff) {
+    const auto& residues = frame.topology().residues();
+    std::vector<size_t> kept;
+    for (auto current : residue_ids) {
+        bool found = false;
+        for (auto other : interaction_ids) {
+            for (auto i : residues[other]) {
+                for (auto j : residues[current]) {
+                    found = found || frame.distance(i, j) < distance_cutoff;
+                }
+            }
+        }
+        if (found) {
+            kept.push_back(current);
+        }
+    }
+    return kept;
+}
+
+TEST_CASE("Find interactions with a grid") {
+    auto frame = random_frame(300, 42);
+
+    std::vector<size_t> ligands, others;
+    for (size_t i = 0; i < 300; ++i) {
+        (i % 3 == 0 ? ligands : others).push_back(i);
+    }
+
+    for (auto cutoff : {0.5, 2.0, 4.0, 6.0, 12.0, 40.0}) {
+        auto expected = brute_force(frame, ligands, others, cutoff);
+
+        auto res = ligands;
+        lemon::prune::keep_interactions(frame, res, others, cutoff);
+        CHECK(res == expected);
+
+        // With periodic boundary conditions
+        frame.set_cell(chemfiles::UnitCell(41.0, 38.0, 45.0));
+        expected = brute_force(frame, ligands, others, cutoff);
+        res = ligands;
+        lemon::prune::keep_interactions(frame, res, others, cutoff);
+        CHECK(res == expected);
+
+        res = ligands;
+        lemon::prune::remove_interactions(frame, res, others, cutoff);
+        CHECK(res.size() + expected.size() == ligands.size());
+        frame.set_cell(chemfiles::UnitCell());
+    }
+
+    // Empty sets of residues and no cutoff
+    auto res = ligands;
+    lemon::prune::keep_interactions(frame, res, std::vector<size_t>());
+    CHECK(res.empty());
+    res = ligands;
+    lemon::prune::keep_interactions(frame, res, others, 0.0);
+    CHECK(res == ligands);
+
+    lemon::AtomGrid empty;
+    double origin[3] = {0, 0, 0};
+    CHECK(!empty.neighbors(origin, 10.0, [](size_t) { return true; }));
+}
+
+TEST_CASE("Find interactions of an entry with a grid") {
+    auto frame = chemfiles::Trajectory("files/1AAQ.mmtf", 'r').read();
+    auto peptides = lemon::select::peptides(frame);
+    auto others = lemon::select::specific_residues(frame, {"PSI", "HOH"});
+    std::vector<size_t> ligands(others.begin(), others.end());
+    std::vector<size_t> protein(peptides.begin(), peptides.end());
+
+    for (auto cutoff : {2.0, 4.0, 6.0}) {
+        auto res = ligands;
+        lemon::prune::keep_interactions(frame, res, protein, cutoff);
+        CHECK(res == brute_force(frame, ligands, protein, cutoff));
+    }
+}
@@ -0,0 +1,130 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/prune.hpp"
+#include "lemon/query.hpp"
+#include "lemon/select.hpp"
+#include "lemon/selection.hpp"
+
+#include "random_frame.hpp"
+
+
+TEST_CASE("Select residues in a single pass") {
+    auto frame = random_frame(400, 13);
+    frame.set_cell(chemfiles::UnitCell(41.0, 38.0, 45.0));
+    lemon::FrameIndex index(frame);
+    constexpr lemon::ResidueNameSet hemes("HEM", "HEC");
+
+    for (auto distance : {0.0, 3.0, 6.0}) {
+        // The same workflow with the free functions
+        auto hemegs = lemon::select::specific_residues(frame, hemes);
+        auto expected =
+            lemon::select::small_molecules(frame, {"NON-POLYMER", "OTHER"}, 3);
+        lemon::prune::identical_residues(frame, expected);
+        lemon::prune::cofactors(frame, expected, lemon::common_cofactors);
+        lemon::prune::cofactors(frame, expected, lemon::common_fatty_acids);
+        lemon::prune::keep_interactions(frame, expected, hemegs, distance);
+
+        auto result = lemon::query(frame)
+                          .small_molecules({"NON-POLYMER", "OTHER"}, 3)
+                          .same_assembly()
+                          .not_in(lemon::common_cofactors)
+                          .not_in(lemon::common_fatty_acids)
+                          .near(hemes, distance)
+                          .select();
+        CHECK(result == expected);
+
+        auto indexed = lemon::query(index)
+                           .small_molecules({"NON-POLYMER", "OTHER"}, 3)
+                           .same_assembly()
+                           .not_in(lemon::common_cofactors)
+                           .not_in(lemon::common_fatty_acids)
+                           .near(hemes, distance)
+                           .select();
+        CHECK(indexed == expected);
+
+        // Spatial filters are applied last, and can be given residues
+        auto peptides = lemon::select::peptides(frame);
+        expected =
+            lemon::select::small_molecules(frame, {"NON-POLYMER", "OTHER"}, 3);
+        lemon::prune::remove_interactions(frame, expected, peptides, distance);
+        lemon::prune::cofactors(frame, expected, hemes);
+
+        // The types are not copied by the query, which is kept below
+        const std::unordered_set<std::string> types = {"NON-POLYMER", "OTHER"};
+        auto query = lemon::query(index)
+                         .not_near(peptides, distance)
+                         .small_molecules(types, 3)
+                         .not_in(hemes);
+        CHECK(query.select() == expected);
+        CHECK(lemon::query(frame)
+                  .not_near(peptides, distance)
+                  .small_molecules({"NON-POLYMER", "OTHER"}, 3)
+                  .not_in(hemes)
+                  .select() == expected);
+
+        // Running a query again gives the same result
+        CHECK(query.select<lemon::Selection>() ==
+              lemon::Selection::from(expected));
+    }
+}
+
+TEST_CASE("Filter residues by kind, name and assembly") {
+    auto frame = random_frame(200, 17);
+    lemon::FrameIndex index(frame);
+
+    auto peptides = lemon::select::peptides(frame);
+    CHECK(lemon::query(frame).peptides().select() == peptides);
+    CHECK(lemon::query(index).peptides().select() == peptides);
+    CHECK(lemon::select::peptides(index) == peptides);
+
+    auto nucleic_acids = lemon::select::nucleic_acids(frame);
+    CHECK(!nucleic_acids.empty());
+    CHECK(lemon::query(index).nucleic_acids().select() == nucleic_acids);
+
+    lemon::ResidueNameSet names{"HEM", "GOL"};
+    auto named = lemon::query(frame).in(names).select();
+    CHECK(named.size() == 58);
+    for (auto residue : named) {
+        CHECK((residue % 7 == 1 || residue % 7 == 2));
+    }
+    CHECK(lemon::query(index).in(names).select() == named);
+    CHECK(lemon::select::specific_residues(frame, names) == named);
+
+    // The assembly is the one of the first residue kept before
+    auto second = lemon::query(frame)
+                      .where([](size_t residue) { return residue > 1; })
+                      .same_assembly()
+                      .select();
+    CHECK(second.size() == 40);
+    CHECK(second.front() == 2);
+    CHECK(lemon::query(index)
+              .where([](size_t residue) { return residue > 1; })
+              .same_assembly()
+              .select() == second);
+}
+
+TEST_CASE("Select the residues of an entry in a single pass") {
+    for (auto path : {"files/1AAQ.mmtf", "files/4XUF.mmtf.gz"}) {
+        auto frame = chemfiles::Trajectory(path, 'r').read();
+        lemon::FrameIndex index(frame);
+
+        auto peptides = lemon::select::peptides(frame);
+        auto expected = lemon::select::small_molecules(frame);
+        lemon::prune::cofactors(frame, expected, lemon::common_cofactors);
+        lemon::prune::keep_interactions(frame, expected, peptides, 6.0);
+
+        CHECK(lemon::query(frame)
+                  .small_molecules()
+                  .not_in(lemon::common_cofactors)
+                  .near(peptides, 6.0)
+                  .select() == expected);
+        CHECK(lemon::query(index)
+                  .small_molecules()
+                  .not_in(lemon::common_cofactors)
+                  .near(peptides, 6.0)
+                  .select() == expected);
+    }
+}
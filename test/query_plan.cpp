@@ -0,0 +1,134 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/count.hpp"
+#include "lemon/prune.hpp"
+#include "lemon/query_plan.hpp"
+#include "lemon/select.hpp"
+#include "lemon/selection.hpp"
+
+#include "random_frame.hpp"
+
+
+static lemon::Selection run(const std::string& text,
+                            const lemon::FrameIndex& index) {
+    return lemon::QueryPlan(text).select(index);
+}
+
+TEST_CASE("Compile queries") {
+    CHECK(lemon::QueryPlan("small_molecules").action() ==
+          lemon::QueryPlan::LIST);
+    CHECK(lemon::QueryPlan("peptides -> list").action() ==
+          lemon::QueryPlan::LIST);
+    CHECK(lemon::QueryPlan("all->count").action() == lemon::QueryPlan::COUNT);
+    CHECK(lemon::QueryPlan("small_molecules & !cofactors & within(6.0, resn "
+                           "HEM) -> count resn")
+              .action() == lemon::QueryPlan::COUNT_NAMES);
+
+    // Spatial checks are run last, and names are merged in one step
+    lemon::QueryPlan plan(
+        "within(4, peptides) & !resn HEM & small_molecules & !resn GOL");
+    CHECK(plan.str() == "intersection\n"
+                        "  small_molecules\n"
+                        "  not resn GOL HEM\n"
+                        "  within 4\n"
+                        "    peptides\n");
+    CHECK(lemon::QueryPlan("resn ALA or (resn GLY | resn ALA)").str() ==
+          "resn ALA GLY\n");
+    CHECK(lemon::QueryPlan("not not all").str() == "all\n");
+
+    CHECK_THROWS_AS(lemon::QueryPlan(""), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("small_molecules &"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("ligands"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("resn hem"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("resn HEMS"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("(peptides"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("peptides peptides"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("within(x, peptides)"),
+                    std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("within(0, peptides)"),
+                    std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("within(-2.5, peptides)"),
+                    std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("peptides -> print"), std::runtime_error&);
+    CHECK_THROWS_AS(lemon::QueryPlan("peptides # all"), std::runtime_error&);
+}
+
+TEST_CASE("Run queries on an entry") {
+    auto frame = random_frame(300, 23);
+    frame.set_cell(chemfiles::UnitCell(41.0, 38.0, 45.0));
+    lemon::FrameIndex index(frame);
+    auto all = lemon::Selection::all(frame.topology().residues().size());
+
+    auto smallm = lemon::select::small_molecules<lemon::Selection>(frame);
+    auto peptides = lemon::select::peptides<lemon::Selection>(frame);
+    auto nucleic_acids = lemon::select::nucleic_acids<lemon::Selection>(frame);
+    auto hemes = lemon::select::specific_residues<lemon::Selection>(
+        frame, lemon::ResidueNameSet{"HEM", "HEC"});
+
+    CHECK(run("all", index) == all);
+    CHECK(run("small_molecules", index) == smallm);
+    CHECK(run("!peptides", index) == all - peptides);
+    CHECK(run("peptides | nucleic_acids", index) == (peptides | nucleic_acids));
+    CHECK(run("resn HEM, HEC", index) == hemes);
+    CHECK(run("resn HEM or resn HEC", index) == hemes);
+    CHECK(run("small_molecules & !(resn HEM | resn HEC)", index) ==
+          smallm - hemes);
+    CHECK(run("!resn HEM & !resn HEC", index) == all - hemes);
+    CHECK(run("!(!resn HEM | !resn HEC)", index).empty());
+
+    // The selected residues are counted by name for `-> count resn`
+    lemon::ResidueNameCount counts;
+    lemon::count::residues(frame, run("resn HEM, HEC", index), counts);
+    CHECK(counts.size() == 2);
+    CHECK(counts.at("HEM") + counts.at("HEC") == hemes.size());
+
+    auto expected = smallm;
+    lemon::prune::cofactors(frame, expected, lemon::common_cofactors);
+    CHECK(!expected.empty());
+    CHECK(run("small_molecules & !cofactors", index) == expected);
+
+    for (auto distance : {1.0, 3.0, 6.0}) {
+        auto near = expected;
+        lemon::prune::keep_interactions(frame, near, hemes, distance);
+        auto text = "small_molecules & !cofactors & within(" +
+                    std::to_string(distance) + ", resn HEM HEC)";
+        CHECK(run(text, index) == near);
+        CHECK(run("within(" + std::to_string(distance) +
+                      ", resn HEM | resn HEC) and not cofactors and "
+                      "small_molecules",
+                  index) == near);
+
+        auto far = expected;
+        lemon::prune::remove_interactions(frame, far, peptides, distance);
+        CHECK(run("small_molecules & !cofactors & !within(" +
+                      std::to_string(distance) + ", peptides)",
+                  index) == far);
+
+        auto around = all;
+        lemon::prune::keep_interactions(frame, around, peptides, distance);
+        CHECK(run("within(" + std::to_string(distance) + ", peptides)",
+                  index) == around);
+        CHECK(run("!within(" + std::to_string(distance) + ", peptides)",
+                  index) == all - around);
+    }
+}
+
+TEST_CASE("Run queries on the entries of the tests") {
+    for (auto path : {"files/1AAQ.mmtf", "files/4XUF.mmtf.gz"}) {
+        auto frame = chemfiles::Trajectory(path, 'r').read();
+        lemon::FrameIndex index(frame);
+
+        auto smallm = lemon::select::small_molecules<lemon::Selection>(frame);
+        CHECK(run("small_molecules", index) == smallm);
+
+        auto peptides = lemon::select::peptides<lemon::Selection>(frame);
+        auto expected = smallm;
+        lemon::prune::cofactors(frame, expected, lemon::common_cofactors);
+        lemon::prune::remove_interactions(frame, expected, peptides, 4.0);
+        CHECK(run("small_molecules & !cofactors & !within(4, peptides)",
+                  index) == expected);
+    }
+}
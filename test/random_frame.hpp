@@ -0,0 +1,54 @@
+#ifndef LEMON_TEST_RANDOM_FRAME_HPP
+#define LEMON_TEST_RANDOM_FRAME_HPP
+
+#include <chemfiles.hpp>
+
+#include <random>
+
+// Residues of one to fourteen bonded atoms placed at random in a 40 A box,
+// used to compare the optimized functions with the ones taking a Frame on
+// more residues than the files of the tests contain.
+//
+// Residue `i` is named after `i % 7` (LIG, HEM, GOL, ALA, PEG, HEC, NAG), has
+// the composition type `i % 6` (NON-POLYMER, L-PEPTIDE LINKING, RNA LINKING,
+// PEPTIDE-LIKE, DNA LINKING, OTHER), the chain ID A or B after `i % 2` and
+// the assembly 2 if `i % 5 == 2`, 1 otherwise. Some atoms are hydrogens and
+// some have an altloc.
+inline chemfiles::Frame random_frame(size_t count, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> coordinate(0.0, 40.0);
+    std::uniform_real_distribution<double> offset(-2.0, 2.0);
+    std::uniform_int_distribution<size_t> atoms(1, 14);
+
+    const char* names[] = {"LIG", "HEM", "GOL", "ALA", "PEG", "HEC", "NAG"};
+    const char* types[] = {"NON-POLYMER", "L-PEPTIDE LINKING", "RNA LINKING",
+                           "PEPTIDE-LIKE", "DNA LINKING", "OTHER"};
+    const char* elements[] = {"C", "N", "O", "H", "S"};
+
+    chemfiles::Frame frame;
+    for (size_t i = 0; i < count; ++i) {
+        chemfiles::Residue residue(names[i % 7], i);
+        double x = coordinate(generator), y = coordinate(generator),
+               z = coordinate(generator);
+        for (size_t j = atoms(generator); j > 0; --j) {
+            chemfiles::Atom atom("X", elements[j % 5]);
+            if (j % 4 == 0) {
+                atom.set("altloc", j % 8 == 0 ? "A" : "B");
+            }
+            frame.add_atom(std::move(atom),
+                           {x + offset(generator), y + offset(generator),
+                            z + offset(generator)});
+            residue.add_atom(frame.size() - 1);
+            if (j != 1) {
+                frame.add_bond(frame.size() - 1, frame.size());
+            }
+        }
+        residue.set("composition_type", types[i % 6]);
+        residue.set("chainid", i % 2 == 0 ? "A" : "B");
+        residue.set("assembly", i % 5 == 2 ? "2" : "1");
+        frame.add_residue(std::move(residue));
+    }
+    return frame;
+}
+
+#endif
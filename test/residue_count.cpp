@@ -1,4 +1,6 @@
+#include "lemon/constants.hpp"
 #include "lemon/residue_name.hpp"
+#include <array>
 #include <chemfiles.hpp>
 #include <sstream>
 
@@ -91,6 +93,160 @@ TEST_CASE("Residue set") {
     CHECK(rns.size() == 3);
 }
 
+TEST_CASE("Residue name hashes") {
+    CHECK(lemon::ResidueName::literal_hash("ALA") ==
+          lemon::ResidueName("ALA").hash());
+    CHECK(lemon::ResidueName::literal_hash("ZZZ") ==
+          lemon::ResidueName("ZZZ").hash());
+    CHECK(lemon::ResidueName::literal_hash("K") ==
+          lemon::ResidueName("K").hash());
+    CHECK(lemon::ResidueName::literal_hash("CA") ==
+          lemon::ResidueName("CA").hash());
+
+    for (size_t hash = 0; hash < lemon::RESIDUE_NAME_HASHES; ++hash) {
+        auto name = lemon::ResidueName::from_hash(static_cast<unsigned short>(hash));
+        if (name.hash() != hash) {
+            FAIL("Wrong name for hash " << hash);
+        }
+    }
+
+    CHECK(lemon::ResidueName::from_hash(lemon::ResidueName("CA").hash()) ==
+          lemon::ResidueName("CA"));
+}
+
+TEST_CASE("Residue set operations") {
+    lemon::ResidueNameSet rns {"GLY", "ALA", "CA", "ZZZ", "000"};
+    CHECK(rns.contains("ALA"));
+    CHECK(!rns.contains("VAL"));
+    CHECK(rns.count("CA") == 1);
+
+    std::vector<lemon::ResidueName> names(rns.begin(), rns.end());
+    REQUIRE(names.size() == 5);
+    CHECK(names.front() == lemon::ResidueName("000"));
+    for (size_t i = 1; i < names.size(); ++i) {
+        CHECK(names[i - 1].hash() < names[i].hash());
+    }
+
+    CHECK(!rns.insert("ALA"));
+    CHECK(rns.erase("ALA") == 1);
+    CHECK(rns.erase("ALA") == 0);
+    CHECK(rns.size() == 4);
+
+    lemon::ResidueNameSet other {"GLY", "VAL"};
+    auto both = rns;
+    both |= other;
+    CHECK(both.size() == 5);
+    CHECK(both.contains("VAL"));
+
+    auto common = rns;
+    common &= other;
+    CHECK(common == lemon::ResidueNameSet({"GLY"}));
+
+    auto difference = rns;
+    difference -= other;
+    CHECK(difference == lemon::ResidueNameSet({"CA", "ZZZ", "000"}));
+    CHECK(difference != rns);
+
+    difference.clear();
+    CHECK(difference.empty());
+    CHECK(difference.begin() == difference.end());
+}
+
+TEST_CASE("Residue sets built at compile time") {
+    constexpr lemon::ResidueNameSet hemes("HEM", "HEA", "HEB", "HEC", "HEM");
+    CHECK(hemes == lemon::ResidueNameSet({"HEM", "HEA", "HEB", "HEC"}));
+    CHECK(hemes.size() == 4);
+
+    CHECK(lemon::common_peptides.size() == 34);
+    CHECK(lemon::common_cofactors.size() == 29);
+    CHECK(lemon::common_fatty_acids.size() == 32);
+    CHECK(lemon::proline_res.size() == 3);
+    CHECK(lemon::common_peptides.contains("MSE"));
+    CHECK(lemon::common_cofactors.contains("B3P"));
+    CHECK(lemon::common_fatty_acids.contains("2PE"));
+    CHECK(!lemon::common_cofactors.contains("ALA"));
+}
+
+TEST_CASE("Invalid residue names") {
+    CHECK(lemon::ResidueName("A").valid());
+    CHECK(lemon::ResidueName("5BA").valid());
+    CHECK(!lemon::ResidueName().valid());
+
+    // The characters are not checked when building a name in release mode,
+    // and "aAA" has the same hash as "5BA"
+    lemon::ResidueName lower("AAA");
+    static_cast<std::array<char, 3>&>(lower)[0] = 'a';
+    CHECK(!lower.valid());
+    REQUIRE(lower.hash() == lemon::ResidueName("5BA").hash());
+
+    lemon::ResidueName gap("A");
+    static_cast<std::array<char, 3>&>(gap)[2] = 'B';
+    CHECK(!gap.valid());
+
+    lemon::ResidueNameSet rns {"5BA"};
+    CHECK(!rns.contains(lower));
+    CHECK(rns.count(lower) == 0);
+    CHECK(rns.erase(lower) == 0);
+    CHECK_THROWS_AS(rns.insert(lower), std::range_error&);
+    CHECK_THROWS_AS(rns.insert(gap), std::range_error&);
+    CHECK(rns == lemon::ResidueNameSet({"5BA"}));
+
+    lemon::ResidueNameCount rnc;
+    rnc["5BA"] = 2;
+    CHECK(rnc.at(lower) == 0);
+    CHECK_THROWS_AS(rnc[lower], std::range_error&);
+    CHECK_THROWS_AS(rnc.emplace(gap, 1), std::range_error&);
+    CHECK(rnc.size() == 1);
+}
+
+TEST_CASE("Residue count operations") {
+    lemon::ResidueNameCount rnc;
+    CHECK(rnc.empty());
+    CHECK(rnc.begin() == rnc.end());
+    CHECK(rnc.at("ALA") == 0);
+
+    rnc["ZZZ"] += 3;
+    rnc["ALA"] += 1;
+    rnc["TRP"];
+    CHECK(rnc.size() == 2);
+    CHECK(rnc.at("ZZZ") == 3);
+    CHECK(rnc.at("TRP") == 0);
+
+    rnc.emplace("ALA", 10);
+    rnc.emplace("GLY", 4);
+    CHECK(rnc.at("ALA") == 1);
+    CHECK(rnc.at("GLY") == 4);
+
+    std::vector<std::pair<lemon::ResidueName, size_t>> counts(rnc.begin(),
+                                                              rnc.end());
+    REQUIRE(counts.size() == 3);
+    for (size_t i = 1; i < counts.size(); ++i) {
+        CHECK(counts[i - 1].first.hash() < counts[i].first.hash());
+    }
+
+    lemon::ResidueNameCount other;
+    other["GLY"] = 1;
+    other["0"] = 7;
+    rnc += other;
+    CHECK(rnc.size() == 4);
+    CHECK(rnc.at("GLY") == 5);
+    CHECK(rnc.at("0") == 7);
+
+    lemon::ResidueNameCount expected;
+    expected["0"] = 7;
+    expected["ALA"] = 1;
+    expected["GLY"] = 5;
+    expected["ZZZ"] = 3;
+    CHECK(rnc == expected);
+
+    expected["ALA"] = 2;
+    CHECK(rnc != expected);
+
+    rnc.clear();
+    CHECK(rnc.empty());
+    CHECK(rnc == lemon::ResidueNameCount());
+}
+
 TEST_CASE("Residue to text") {
     auto res_name = lemon::ResidueName("ALA");
     std::stringstream ss;
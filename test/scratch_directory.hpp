@@ -0,0 +1,96 @@
+#ifndef LEMON_TEST_SCRATCH_DIRECTORY_HPP
+#define LEMON_TEST_SCRATCH_DIRECTORY_HPP
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "lemon/archive.hpp"
+
+// A temporary directory, removed with the files named through it when the
+// test ends. Tests write their files and indexes here instead of in
+// test/files, which the test programs read at the same time.
+class ScratchDirectory {
+  public:
+    ScratchDirectory() {
+#ifdef _WIN32
+        const char* temp = std::getenv("TEMP");
+        auto base = std::string(temp != nullptr ? temp : ".") + "/lemon_" +
+                    std::to_string(_getpid()) + "_";
+        for (unsigned i = 0; path_.empty(); ++i) {
+            auto candidate = base + std::to_string(i);
+            if (_mkdir(candidate.c_str()) == 0) {
+                path_ = candidate;
+            } else if (errno != EEXIST) {
+                throw std::runtime_error("Cannot create " + candidate);
+            }
+        }
+#else
+        char directory[] = "/tmp/lemon_XXXXXX";
+        if (mkdtemp(directory) == nullptr) {
+            throw std::runtime_error("Cannot create a temporary directory");
+        }
+        path_ = directory;
+#endif
+        // Written by the runners reading sequence files from here
+        file(lemon::Archive::INDEX_NAME);
+    }
+
+    ~ScratchDirectory() {
+        for (const auto& name : files_) {
+            std::remove((path_ + "/" + name).c_str());
+        }
+#ifdef _WIN32
+        _rmdir(path_.c_str());
+#else
+        rmdir(path_.c_str());
+#endif
+    }
+
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    // The path of the directory
+    const std::string& path() const { return path_; }
+
+    // The path of the file `name` in the directory, removed at the end
+    std::string file(const std::string& name) {
+        files_.insert(name);
+        return path_ + "/" + name;
+    }
+
+    // Copy the file at `source` to `name` in the directory
+    std::string copy(const std::string& source, const std::string& name) {
+        auto destination = file(name);
+        std::ifstream input(source, std::istream::binary);
+        std::ofstream output(destination, std::ostream::binary);
+        if (!input || !(output << input.rdbuf())) {
+            throw std::runtime_error("Cannot copy " + source);
+        }
+        return destination;
+    }
+
+    // Copy the sequence files of test/files/rcsb_hadoop
+    const std::string& copy_sequence_files() {
+        copy("files/rcsb_hadoop/hadoop", "hadoop");
+        copy("files/rcsb_hadoop/hadoop_multiple", "hadoop_multiple");
+        return path_;
+    }
+
+  private:
+    std::string path_;
+    std::set<std::string> files_;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include <chemfiles.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/prune.hpp"
+#include "lemon/select.hpp"
+#include "lemon/selection.hpp"
+#include "lemon/separate.hpp"
+
+#include "random_frame.hpp"
+
+#include <limits>
+
+template <typename Container>
+static std::vector<size_t> as_vector(const Container& container) {
+    return std::vector<size_t>(container.begin(), container.end());
+}
+
+TEST_CASE("Add and remove indexes of a selection") {
+    lemon::Selection selection;
+    CHECK(selection.empty());
+    CHECK(selection.begin() == selection.end());
+
+    selection.insert(130);
+    selection.insert(3);
+    selection.insert(64);
+    selection.insert(3);
+    selection.insert(selection.end(), 63);
+    CHECK(selection.size() == 4);
+    CHECK(selection.bound() == 192);
+    CHECK(as_vector(selection) == std::vector<size_t>({3, 63, 64, 130}));
+
+    CHECK(selection.contains(64));
+    CHECK(selection.count(63) == 1);
+    CHECK(!selection.contains(65));
+    CHECK(!selection.contains(1000));
+
+    selection.erase(63);
+    selection.erase(1000);
+    selection.erase(5);
+    CHECK(as_vector(selection) == std::vector<size_t>({3, 64, 130}));
+
+    selection.remove_if([](size_t index) { return index % 2 == 0; });
+    CHECK(as_vector(selection) == std::vector<size_t>({3}));
+
+    selection.clear();
+    CHECK(selection.empty());
+    CHECK(selection.begin() == selection.end());
+
+    auto all = lemon::Selection::all(70);
+    CHECK(all.size() == 70);
+    CHECK(all.contains(69));
+    CHECK(!all.contains(70));
+    CHECK(*all.begin() == 0);
+
+    CHECK(lemon::Selection::all(128).size() == 128);
+    CHECK(lemon::Selection::from(std::vector<uint64_t>{5, 2, 5}) ==
+          lemon::Selection({2, 5}));
+}
+
+TEST_CASE("Combine selections") {
+    lemon::Selection a = {1, 5, 70, 200};
+    lemon::Selection b = {5, 64, 70};
+
+    CHECK(as_vector(a | b) == std::vector<size_t>({1, 5, 64, 70, 200}));
+    CHECK(as_vector(a & b) == std::vector<size_t>({5, 70}));
+    CHECK(as_vector(a - b) == std::vector<size_t>({1, 200}));
+    CHECK(as_vector(b - a) == std::vector<size_t>({64}));
+    CHECK((a & b).size() == 2);
+    CHECK((a | b).size() == 5);
+
+    // Equality does not depend on the storage of the selections
+    lemon::Selection c(1000);
+    c.insert(5);
+    c.insert(70);
+    CHECK(c == (a & b));
+    CHECK((a & b) == c);
+    CHECK(c != a);
+
+    auto d = a;
+    d -= a;
+    CHECK(d.empty());
+    CHECK(d == lemon::Selection());
+}
+
+TEST_CASE("Use selections to select and prune residues") {
+    auto frame = random_frame(400, 7);
+    frame.set_cell(chemfiles::UnitCell(41.0, 38.0, 45.0));
+    std::vector<char> buffer;
+    lemon::write_frame_view(frame, buffer);
+    lemon::FrameView view(buffer.data(), buffer.size());
+
+    auto smallm = lemon::select::small_molecules(frame, {"NON-POLYMER"}, 3);
+    auto smallm_selection = lemon::select::small_molecules<lemon::Selection>(
+        frame, {"NON-POLYMER"}, 3);
+    CHECK(as_vector(smallm_selection) == as_vector(smallm));
+    CHECK(as_vector(lemon::select::peptides<lemon::Selection>(view)) ==
+          as_vector(lemon::select::peptides(view)));
+
+    auto peptides = lemon::select::peptides(frame);
+    auto peptides_selection = lemon::select::peptides<lemon::Selection>(frame);
+    for (auto cutoff : {0.0, 2.0, 6.0}) {
+        auto expected = smallm;
+        auto res = smallm_selection;
+        lemon::prune::keep_interactions(frame, expected, peptides, cutoff);
+        lemon::prune::keep_interactions(frame, res, peptides_selection, cutoff);
+        CHECK(as_vector(res) == as_vector(expected));
+
+        expected = smallm;
+        res = smallm_selection;
+        lemon::prune::remove_interactions(view, expected, peptides, cutoff);
+        lemon::prune::remove_interactions(view, res, peptides_selection,
+                                          cutoff);
+        CHECK(as_vector(res) == as_vector(expected));
+    }
+
+    auto expected = smallm;
+    auto res = smallm_selection;
+    lemon::prune::identical_residues(frame, expected);
+    lemon::prune::identical_residues(frame, res);
+    CHECK(as_vector(res) == as_vector(expected));
+
+    auto all = lemon::select::residue_ids(frame, {1, 2, 6, 12, 18, 24, 30, 36});
+    auto all_selection = lemon::select::residue_ids<lemon::Selection>(
+        frame, {1, 2, 6, 12, 18, 24, 30, 36});
+    expected = smallm;
+    res = smallm_selection;
+    lemon::prune::intersection(expected, all);
+    lemon::prune::intersection(res, all_selection);
+    CHECK(!res.empty());
+    CHECK(as_vector(res) == as_vector(expected));
+
+    // A selection can be intersected with any other container too
+    res = smallm_selection;
+    lemon::prune::intersection(res, all);
+    CHECK(as_vector(res) == as_vector(expected));
+
+    // Large IDs are looked up without allocating a bit for each index below
+    const auto large = std::numeric_limits<size_t>::max();
+    std::vector<size_t> ids = {3, 8, large};
+    lemon::prune::intersection(ids, std::vector<size_t>{large, 8, 5});
+    CHECK(ids == std::vector<size_t>({8, large}));
+    ids = {3, 8, 12};
+    lemon::prune::intersection(ids, std::vector<size_t>{large, 12, 3});
+    CHECK(ids == std::vector<size_t>({3, 12}));
+}
+
+TEST_CASE("Find the atoms of selected residues") {
+    auto frame = random_frame(100, 11);
+    const auto& residues = frame.topology().residues();
+    lemon::Selection selection = {0, 10, 99};
+
+    std::vector<size_t> expected;
+    for (auto residue : selection) {
+        for (auto atom : residues[residue]) {
+            expected.push_back(atom);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    CHECK(as_vector(selection.atoms(frame)) == expected);
+    std::vector<char> buffer;
+    lemon::write_frame_view(frame, buffer);
+    lemon::FrameView view(buffer.data(), buffer.size());
+    CHECK(as_vector(selection.atoms(view)) == expected);
+
+    // The atoms of the second alternate location are not copied
+    auto copied = [&frame, &expected](size_t atom) {
+        auto altloc = frame[atom].get("altloc");
+        return std::binary_search(expected.begin(), expected.end(), atom) &&
+               !(altloc && altloc->as_string() == "B");
+    };
+    size_t atoms = 0, bonds = 0;
+    for (size_t atom = 0; atom < frame.size(); ++atom) {
+        atoms += copied(atom);
+    }
+    for (const auto& bond : frame.topology().bonds()) {
+        bonds += copied(bond[0]) && copied(bond[1]);
+    }
+
+    chemfiles::Frame new_frame;
+    lemon::separate::residues(frame, selection, new_frame);
+    CHECK(new_frame.size() == atoms);
+    CHECK(new_frame.topology().residues().size() == 3);
+    CHECK(new_frame.topology().bonds().size() == bonds);
+}
+
+TEST_CASE("Use selections on an entry") {
+    auto frame = chemfiles::Trajectory("files/4XUF.mmtf.gz", 'r').read();
+
+    auto smallm = lemon::select::small_molecules(frame);
+    auto smallm_selection =
+        lemon::select::small_molecules<lemon::Selection>(frame);
+    CHECK(as_vector(smallm_selection) == as_vector(smallm));
+
+    auto peptides = lemon::select::peptides(frame);
+    auto peptides_selection = lemon::select::peptides<lemon::Selection>(frame);
+    CHECK(as_vector(peptides_selection) == as_vector(peptides));
+
+    auto expected = smallm;
+    auto res = smallm_selection;
+    lemon::prune::keep_interactions(frame, expected, peptides, 6.0);
+    lemon::prune::keep_interactions(frame, res, peptides_selection, 6.0);
+    CHECK(as_vector(res) == as_vector(expected));
+}
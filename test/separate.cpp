@@ -1,8 +1,11 @@
 #include "lemon/separate.hpp"
 #include "lemon/select.hpp"
+#include "random_frame.hpp"
 #include "chemfiles/Topology.hpp"
 #include "chemfiles/Trajectory.hpp"
 
+#include <set>
+
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
@@ -41,3 +44,74 @@ TEST_CASE("Separate ligands") {
 
     CHECK(protein.topology().residues()[0].get("is_standard_pdb")->as_bool());
 }
+
+// The IDs of the residues with an atom closer than `cutoff` to a ligand
+static std::set<uint64_t> pocket(const chemfiles::Frame& frame,
+                                const std::set<size_t>& ligands,
+                                double cutoff) {
+    const auto& residues = frame.topology().residues();
+    std::set<uint64_t> ids;
+    for (size_t i = 0; i < residues.size(); ++i) {
+        if (ligands.count(i) != 0) {
+            continue;
+        }
+        for (auto ligand : ligands) {
+            for (auto a : residues[i]) {
+                for (auto b : residues[ligand]) {
+                    if (frame.distance(a, b) < cutoff) {
+                        ids.insert(*residues[i].id());
+                    }
+                }
+            }
+        }
+    }
+    return ids;
+}
+
+static std::set<uint64_t> residue_ids(const chemfiles::Frame& frame) {
+    std::set<uint64_t> ids;
+    for (const auto& residue : frame.topology().residues()) {
+        ids.insert(*residue.id());
+    }
+    return ids;
+}
+
+TEST_CASE("Separate pockets of random frames") {
+    auto frame = random_frame(400, 7);
+
+    for (auto cutoff : {1.0, 4.0, 6.0, 15.0}) {
+        for (auto periodic : {false, true}) {
+            frame.set_cell(periodic ? chemfiles::UnitCell(41.0, 38.0, 45.0)
+                                    : chemfiles::UnitCell());
+
+            chemfiles::Frame protein, ligand;
+            lemon::separate::protein_and_ligand(frame, 10, cutoff, protein,
+                                                ligand);
+            CHECK(residue_ids(protein) == pocket(frame, {10}, cutoff));
+            CHECK(ligand.size() == frame.topology().residues()[10].size());
+
+            std::set<size_t> ligands = {3, 150, 299};
+            chemfiles::Frame proteins, ligands_frame;
+            lemon::separate::protein_and_ligands(frame, ligands, cutoff,
+                                                 proteins, ligands_frame);
+            CHECK(residue_ids(proteins) == pocket(frame, ligands, cutoff));
+        }
+    }
+
+    // Every residue is in the pocket without a cutoff
+    chemfiles::Frame protein, ligand;
+    lemon::separate::protein_and_ligand(frame, 10, 0.0, protein, ligand);
+    CHECK(protein.topology().residues().size() == 399);
+}
+
+TEST_CASE("Separate the pocket of a ligand") {
+    auto frame = chemfiles::Trajectory("files/1AAQ.mmtf", 'r').read();
+    auto psi = *lemon::select::specific_residues(frame, {"PSI"}).begin();
+
+    for (auto cutoff : {4.0, 6.0}) {
+        chemfiles::Frame protein, ligand;
+        lemon::separate::protein_and_ligand(frame, psi, cutoff, protein,
+                                            ligand);
+        CHECK(residue_ids(protein) == pocket(frame, {psi}, cutoff));
+    }
+}
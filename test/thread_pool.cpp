@@ -0,0 +1,155 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "lemon/thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Push, pop and steal from a deque") {
+    lemon::chase_lev_deque<int> deque(2);
+    std::vector<int> items(10);
+    std::iota(items.begin(), items.end(), 0);
+
+    CHECK(deque.pop() == nullptr);
+    CHECK(deque.steal() == nullptr);
+
+    // Grows past its initial capacity
+    for (auto& item : items) {
+        deque.push(&item);
+    }
+
+    CHECK(*deque.pop() == 9);
+    CHECK(*deque.steal() == 0);
+    CHECK(*deque.steal() == 1);
+    CHECK(*deque.pop() == 8);
+
+    size_t left = 0;
+    while (deque.pop() != nullptr) {
+        ++left;
+    }
+    CHECK(left == 6);
+    CHECK(deque.steal() == nullptr);
+}
+
+TEST_CASE("Run tasks in the order they were queued") {
+    std::vector<size_t> order;
+    {
+        lemon::thread_pool pool(1);
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < 100; ++i) {
+            futures.push_back(pool.queue_task([&order, i] { order.push_back(i); }));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+
+    REQUIRE(order.size() == 100);
+    for (size_t i = 0; i < order.size(); ++i) {
+        CHECK(order[i] == i);
+    }
+}
+
+TEST_CASE("Return values and errors of tasks") {
+    lemon::thread_pool pool(4);
+    CHECK(pool.total_threads() == 4);
+
+    std::vector<std::future<size_t>> futures;
+    for (size_t i = 0; i < 1000; ++i) {
+        futures.push_back(pool.queue_task([i] { return i * 2; }));
+    }
+
+    size_t total = 0;
+    for (auto& future : futures) {
+        total += future.get();
+    }
+    CHECK(total == 999 * 1000);
+
+    auto error = pool.queue_task([]() -> int {
+        throw std::runtime_error("Task error");
+    });
+    CHECK_THROWS_AS(error.get(), std::runtime_error&);
+
+    CHECK(lemon::thread_pool::current() == nullptr);
+    auto current = pool.queue_task([] { return lemon::thread_pool::current(); });
+    CHECK(current.get() == &pool);
+}
+
+TEST_CASE("Nested parallelism in a pool") {
+    std::atomic<size_t> total(0);
+
+    // Without a pool, the indices are processed on the calling thread
+    lemon::parallel_for(0, 10, [&total](size_t i) { total += i; });
+    CHECK(total == 45);
+
+    total = 0;
+    {
+        lemon::thread_pool pool(3);
+        std::vector<std::future<void>> futures;
+        for (size_t task = 0; task < 8; ++task) {
+            futures.push_back(pool.queue_task([&total] {
+                lemon::parallel_for(0, 100, [&total](size_t i) { total += i; });
+            }));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+    CHECK(total == 8 * 4950);
+
+    lemon::thread_pool pool(2);
+    auto error = pool.queue_task([] {
+        lemon::parallel_for(0, 10, [](size_t i) {
+            if (i == 7) {
+                throw std::runtime_error("Subtask error");
+            }
+        });
+    });
+    CHECK_THROWS_AS(error.get(), std::runtime_error&);
+}
+
+TEST_CASE("Wait for subtasks beside tasks queued from outside") {
+    // Like the workers of run_ordered, the second task waits for the first
+    // one. The first task must not run it while it waits for its subtask.
+    std::atomic<bool> stolen(false), queued(false), done(false);
+
+    lemon::thread_pool pool(2);
+    auto first = pool.queue_task([&] {
+        lemon::parallel_for(0, 2, [&](size_t i) {
+            if (i == 0) {
+                while (!stolen) {
+                    std::this_thread::yield();
+                }
+                return;
+            }
+
+            stolen = true;
+            while (!queued) {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        });
+        done = true;
+    });
+
+    while (!stolen) {
+        std::this_thread::yield();
+    }
+    auto second = pool.queue_task([&done] {
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!done && std::chrono::steady_clock::now() < end) {
+            std::this_thread::yield();
+        }
+        return done.load();
+    });
+    queued = true;
+
+    first.get();
+    CHECK(second.get());
+}
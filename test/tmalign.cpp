@@ -8,6 +8,52 @@
 
 using Catch::Detail::Approx;
 
+// Residues with IDs `ids` in chain `chain`, with a CA atom unless the ID is 0
+static void add_chain(chemfiles::Frame& frame, const std::string& chain,
+                      const std::vector<uint64_t>& ids) {
+    for (auto id : ids) {
+        chemfiles::Residue residue("ALA", id);
+        frame.add_atom(chemfiles::Atom("N"), {0, 0, 0});
+        residue.add_atom(frame.size() - 1);
+        if (id != 0) {
+            frame.add_atom(chemfiles::Atom("CA", "C"), {0, 0, 0});
+            residue.add_atom(frame.size() - 1);
+        }
+        residue.set("chainname", chain);
+        frame.add_residue(std::move(residue));
+    }
+}
+
+TEST_CASE("Match the residues of two frames") {
+    chemfiles::Frame search, native;
+    add_chain(search, "A", {1, 2, 3, 4});
+    add_chain(search, "B", {1, 2});
+    add_chain(native, "B", {2, 1});
+    add_chain(native, "A", {0, 3, 2, 7});
+
+    auto aligned = lemon::tmalign::aligned_residues(native);
+    REQUIRE(aligned.size() == 5);
+    CHECK(aligned[0].alpha_carbon == 1);
+    CHECK(aligned[0].chain_name == "B");
+    CHECK(aligned[2].id == 3);
+
+    std::vector<size_t> a_search, a_native;
+
+    // Same ID and chain name
+    auto n_ali = lemon::tmalign::find_operlapping_residues(
+        search, native, a_search, a_native, "", "");
+    CHECK(n_ali == 4);
+    CHECK(a_search == std::vector<size_t>({3, 5, 9, 11}));
+    CHECK(a_native == std::vector<size_t>({8, 6, 3, 1}));
+
+    // Chain A of search against chain B of native
+    n_ali = lemon::tmalign::find_operlapping_residues(
+        search, native, a_search, a_native, "A", "B");
+    CHECK(n_ali == 2);
+    CHECK(a_search == std::vector<size_t>({1, 3}));
+    CHECK(a_native == std::vector<size_t>({3, 1}));
+}
+
 TEST_CASE("Kabsch") {
     auto traj = chemfiles::Trajectory("files/1AAQ.mmtf", 'r');
     auto frame1 = traj.read();